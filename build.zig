@@ -6,16 +6,30 @@ const vkgen = @import("libs/vulkan-zig/generator/index.zig");
 const Step = std.build.Step;
 const Builder = std.build.Builder;
 
-/// compiles all shaders with glslc and generates a resources.zig file to access them at runtime.
+/// compiles all shaders with glslc and generates a resources.zig file to access them at runtime. A shader is only
+/// recompiled when its source, defines or the glslc arguments changed, tracked by a content hash stored next to its
+/// SPIR-V. Shaders that hash alike, like a variant without defines and its plain source, are compiled once.
 pub const ResourceGenStep = struct {
+    const glslc_args = [_][]const u8{ "glslc", "--target-env=vulkan1.1" };
+    const max_source_size = 1024 * 1024;
+
+    const Shader = struct {
+        name: []const u8,
+        source: []const u8,
+        /// passed to glslc as -D<define>
+        defines: []const []const u8,
+        spirv: []const u8 = undefined,
+    };
+
     step: Step,
-    shader_step: *vkgen.ShaderCompileStep,
     builder: *Builder,
     package: std.build.Pkg,
     output_file: std.build.GeneratedFile,
-    resources: std.ArrayList(u8),
+    shaders: std.ArrayList(Shader),
+    /// lets the engine recompile and reload shaders from their sources while running, see ShaderLibrary
+    hot_reload: bool,
 
-    pub fn init(builder: *Builder, out: []const u8) *ResourceGenStep {
+    pub fn init(builder: *Builder, out: []const u8, hot_reload: bool) *ResourceGenStep {
         const self = builder.allocator.create(ResourceGenStep) catch unreachable;
         const full_out_path = std.fs.path.join(builder.allocator, &[_][]const u8{
             builder.build_root,
@@ -25,7 +39,6 @@ pub const ResourceGenStep = struct {
 
         self.* = .{
             .step = Step.init(.custom, "resources", builder.allocator, make),
-            .shader_step = vkgen.ShaderCompileStep.init(builder, &[_][]const u8{ "glslc", "--target-env=vulkan1.1" }, "shaders"),
             .builder = builder,
             .package = .{
                 .name = "resources",
@@ -36,10 +49,10 @@ pub const ResourceGenStep = struct {
                 .step = &self.step,
                 .path = full_out_path,
             },
-            .resources = std.ArrayList(u8).init(builder.allocator),
+            .shaders = std.ArrayList(Shader).init(builder.allocator),
+            .hot_reload = hot_reload,
         };
 
-        self.step.dependOn(&self.shader_step.step);
         return self;
     }
 
@@ -60,21 +73,108 @@ pub const ResourceGenStep = struct {
     }
 
     pub fn addShader(self: *ResourceGenStep, name: []const u8, source: []const u8) void {
-        const shader_out_path = self.shader_step.add(source);
-        var writer = self.resources.writer();
+        self.addShaderVariant(name, source, &.{});
+    }
 
-        writer.print("pub const {s} = @embedFile(\"", .{name}) catch unreachable;
-        renderPath(shader_out_path, writer);
-        writer.writeAll("\");\n") catch unreachable;
+    /// compiles `source` with the preprocessor `defines` set, for features that change the shader interface. Features
+    /// that do not are better served by specialization constants, see PipelineBuilder.Specialization.
+    pub fn addShaderVariant(self: *ResourceGenStep, name: []const u8, source: []const u8, defines: []const []const u8) void {
+        self.shaders.append(.{
+            .name = name,
+            .source = self.builder.pathFromRoot(source),
+            .defines = defines,
+        }) catch unreachable;
     }
 
     fn make(step: *Step) !void {
         const self = @fieldParentPtr(ResourceGenStep, "step", step);
         const cwd = std.fs.cwd();
 
+        var resources = std.ArrayList(u8).init(self.builder.allocator);
+        var writer = resources.writer();
+
+        // output path of every distinct hash
+        var compiled = std.AutoHashMap(u64, []const u8).init(self.builder.allocator);
+        for (self.shaders.items) |*shader| {
+            const hash = try self.hashShader(shader.*);
+            const result = try compiled.getOrPut(hash);
+            if (!result.found_existing) {
+                result.value_ptr.* = std.fs.path.join(self.builder.allocator, &[_][]const u8{
+                    self.builder.build_root,
+                    self.builder.cache_root,
+                    "shaders",
+                    self.builder.fmt("{s}.spv", .{shader.name}),
+                }) catch unreachable;
+                try self.compileShader(shader.*, result.value_ptr.*, hash);
+            }
+            shader.spirv = result.value_ptr.*;
+
+            try writer.print("pub const {s} = @embedFile(\"", .{shader.name});
+            renderPath(shader.spirv, writer);
+            try writer.writeAll("\");\n");
+        }
+
+        // what a running engine needs to recompile the shaders itself
+        try writer.print("\npub const hot_reload = {};\n", .{self.hot_reload});
+        try writer.writeAll("pub const glslc_args = [_][]const u8{");
+        for (glslc_args) |arg| try writer.print(" \"{s}\",", .{arg});
+        try writer.writeAll(" };\n");
+
+        try writer.writeAll("pub const shaders = [_]struct { name: []const u8, code: []const u8, source: []const u8, defines: []const []const u8, spirv: []const u8 }{\n");
+        for (self.shaders.items) |shader| {
+            try writer.print("    .{{ .name = \"{s}\", .code = {s}, .source = \"", .{ shader.name, shader.name });
+            renderPath(shader.source, writer);
+            try writer.writeAll("\", .defines = &.{");
+            for (shader.defines) |define| try writer.print(" \"{s}\",", .{define});
+            try writer.writeAll(" }, .spirv = \"");
+            renderPath(shader.spirv, writer);
+            try writer.writeAll("\" },\n");
+        }
+        try writer.writeAll("};\n");
+
         const dir = std.fs.path.dirname(self.output_file.path.?).?;
         try cwd.makePath(dir);
-        try cwd.writeFile(self.output_file.path.?, self.resources.items);
+        try cwd.writeFile(self.output_file.path.?, resources.items);
+    }
+
+    /// covers everything that ends up in the SPIR-V, so equal hashes mean equal output
+    fn hashShader(self: *ResourceGenStep, shader: Shader) !u64 {
+        const source = try std.fs.cwd().readFileAlloc(self.builder.allocator, shader.source, max_source_size);
+
+        var hasher = std.hash.Wyhash.init(0);
+        for (glslc_args) |arg| hasher.update(arg);
+        for (shader.defines) |define| {
+            hasher.update(define);
+            hasher.update("\x00");
+        }
+        hasher.update(source);
+        return hasher.final();
+    }
+
+    /// runs glslc unless the SPIR-V at `spirv` was compiled from the same `hash`
+    fn compileShader(self: *ResourceGenStep, shader: Shader, spirv: []const u8, hash: u64) !void {
+        const cwd = std.fs.cwd();
+
+        var hash_buf: [16]u8 = undefined;
+        const hash_str = try std.fmt.bufPrint(&hash_buf, "{x:0>16}", .{hash});
+
+        const stamp_path = self.builder.fmt("{s}.hash", .{spirv});
+        if (cwd.access(spirv, .{})) |_| {
+            var stamp_buf: [16]u8 = undefined;
+            const stamp: []const u8 = cwd.readFile(stamp_path, &stamp_buf) catch "";
+            if (std.mem.eql(u8, stamp, hash_str)) return;
+        } else |_| {}
+
+        try cwd.makePath(std.fs.path.dirname(spirv).?);
+
+        var argv = std.ArrayList([]const u8).init(self.builder.allocator);
+        try argv.appendSlice(&glslc_args);
+        for (shader.defines) |define| try argv.append(self.builder.fmt("-D{s}", .{define}));
+        try argv.appendSlice(&.{ shader.source, "-o", spirv });
+        try self.builder.spawnChild(argv.items);
+
+        // only written once glslc succeeded so a failed compile is retried on the next build
+        try cwd.writeFile(stamp_path, hash_str);
     }
 };
 
@@ -114,7 +214,13 @@ pub fn build(b: *Builder) void {
     const mode = b.standardReleaseOptions();
 
     // shader compilation and resources.zig generation
-    const resources_pkg = addShaderCompilationStep(b, true);
+    const shader_hot_reload = b.option(bool, "shader_hot_reload", "recompile and reload changed shaders while running") orelse false;
+    const resources_pkg = addShaderCompilationStep(b, true, shader_hot_reload);
+
+    // compile time switches read by the engine through the build_options package
+    const build_options = b.addOptions();
+    build_options.addOption(bool, "cpu_profiler", b.option(bool, "cpu_profiler", "record CPU profiler zones, compiled out otherwise") orelse false);
+    const build_options_pkg = build_options.getPackage("build_options");
 
     const examples = getAllExamples(b, "examples");
     for (examples) |example| {
@@ -143,7 +249,7 @@ pub fn build(b: *Builder) void {
         exe.addPackage(.{
             .name = "vengine",
             .path = .{ .path = "src/v.zig" },
-            .dependencies = &[_]std.build.Pkg{ glfw_pkg, vulkan_pkg, resources_pkg, tinyobjloader_pkg, vma_pkg, stb_pkg, imgui_pkg, imgui_vk_pkg },
+            .dependencies = &[_]std.build.Pkg{ glfw_pkg, vulkan_pkg, resources_pkg, build_options_pkg, tinyobjloader_pkg, vma_pkg, stb_pkg, imgui_pkg, imgui_vk_pkg },
         });
 
         // vulken-mem
@@ -161,6 +267,15 @@ pub fn build(b: *Builder) void {
         run_step.dependOn(&run_cmd.step);
     }
 
+    // transform update benchmark, only depends on std so it builds without any of the native libs
+    const bench_transforms = b.addExecutable("bench_transforms", "src/bench_transforms.zig");
+    bench_transforms.setOutputDir("zig-cache/bin");
+    bench_transforms.setTarget(target);
+    bench_transforms.setBuildMode(.ReleaseFast);
+
+    const bench_step = b.step("bench_transforms", "run the object transform update benchmark");
+    bench_step.dependOn(&bench_transforms.run().step);
+
     // generate vk.zig bindings
     var generate_exe = b.addSystemCommand(&[_][]const u8{ "echo", "done generating vk.zig" });
     const exe_step = b.step("generate_vulkan_bindings", b.fmt("Generates the vk.zig file", .{}));
@@ -178,10 +293,12 @@ pub fn build(b: *Builder) void {
 
     exe_tests.addPackage(vulkan_pkg);
     exe_tests.addPackage(glfw_pkg);
+    exe_tests.addPackage(vma_pkg);
+    exe_tests.addPackage(build_options_pkg);
     exe_tests.addPackage(.{
         .name = "vengine",
         .path = .{ .path = "src/v.zig" },
-        .dependencies = &[_]std.build.Pkg{ glfw_pkg, vulkan_pkg, resources_pkg, tinyobjloader_pkg, vma_pkg },
+        .dependencies = &[_]std.build.Pkg{ glfw_pkg, vulkan_pkg, resources_pkg, build_options_pkg, tinyobjloader_pkg, vma_pkg },
     });
 
     exe_tests.setTarget(target);
@@ -193,12 +310,11 @@ pub fn build(b: *Builder) void {
 
 /// if always_compile_shaders is true, every build will compile shaders. If it is false, shader compilation will only occur
 /// when specifically running compile_shaders
-fn addShaderCompilationStep(b: *Builder, always_compile_shaders: bool) std.build.Pkg {
+fn addShaderCompilationStep(b: *Builder, always_compile_shaders: bool, hot_reload: bool) std.build.Pkg {
     // compile shaders
     const compile_shaders_exe_step = b.step("compile_shaders", b.fmt("Compiles shaders", .{}));
 
-    const res = ResourceGenStep.init(b, "resources.zig");
-    res.step.dependOn(&res.shader_step.step);
+    const res = ResourceGenStep.init(b, "resources.zig", hot_reload);
     compile_shaders_exe_step.dependOn(&res.step);
 
     // add all shader for compilation
@@ -207,6 +323,10 @@ fn addShaderCompilationStep(b: *Builder, always_compile_shaders: bool) std.build
         res.addShader(shader[0], shader[1]);
     }
 
+    // permutations of a shared source. default_lit is identical to the plain lit shader and only compiled once.
+    res.addShaderVariant("default_lit_frag", "shaders/lit.frag", &.{});
+    res.addShaderVariant("textured_lit_frag", "shaders/lit.frag", &.{"TEXTURED"});
+
     if (always_compile_shaders) {
         return res.package;
     } else {
@@ -273,7 +393,7 @@ fn getAllShaders(b: *Builder, root_directory: []const u8) [][2][]const u8 {
             var iter = dir.iterate();
             while (iter.next() catch unreachable) |entry| {
                 if (entry.kind == .File) {
-                    if (std.mem.endsWith(u8, entry.name, ".vert") or std.mem.endsWith(u8, entry.name, ".frag")) {
+                    if (std.mem.endsWith(u8, entry.name, ".vert") or std.mem.endsWith(u8, entry.name, ".frag") or std.mem.endsWith(u8, entry.name, ".comp")) {
                         const abs_path = std.fs.path.join(alloc, &[_][]const u8{ directory, entry.name }) catch unreachable;
                         const name = alloc.dupe(u8, std.fs.path.basename(abs_path)) catch unreachable;
                         if (std.mem.indexOf(u8, name, ".")) |index| name[index] = '_';
@@ -5,7 +5,10 @@ const vk = @import("vk");
 const Engine = @import("vengine").EngineChap5;
 
 pub fn main() !void {
-    var engine = try Engine.init("chapter 5");
+    const args = try std.process.argsAlloc(std.heap.page_allocator);
+    defer std.process.argsFree(std.heap.page_allocator, args);
+
+    var engine = try Engine.init("chapter 5", Engine.Options.parse(args));
     defer engine.deinit();
 
     try engine.loadContent();
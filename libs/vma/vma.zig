@@ -1,3 +1,4 @@
+const std = @import("std");
 const vk = @import("vulkan");
 
 // https://github.com/SpexGuy/Zig-VMA/blob/main/vma.zig
@@ -129,6 +130,276 @@ pub const Allocator = struct {
             else => return error.Unknown,
         }
     }
+
+    pub fn invalidateAllocation(self: Allocator, allocation: VmaAllocation, offset: vk.DeviceSize, size: vk.DeviceSize) !void {
+        const res = vmaInvalidateAllocation(self.allocator, allocation, offset, size);
+        switch (res) {
+            .success => {},
+            .error_out_of_host_memory => return error.OutOfHostMemory,
+            .error_out_of_device_memory => return error.OutOfDeviceMemory,
+            else => return error.Unknown,
+        }
+    }
+
+    pub fn getMemoryProperties(self: Allocator) *const vk.PhysicalDeviceMemoryProperties {
+        var props: [*c]const vk.PhysicalDeviceMemoryProperties = undefined;
+        vmaGetMemoryProperties(self.allocator, &props);
+        return @ptrCast(*const vk.PhysicalDeviceMemoryProperties, props);
+    }
+
+    /// walks every block and allocation so it is not cheap. Fine for a debug panel, dont call it per draw.
+    pub fn calculateStatistics(self: Allocator) VmaTotalStatistics {
+        var stats: VmaTotalStatistics = undefined;
+        vmaCalculateStatistics(self.allocator, &stats);
+        return stats;
+    }
+
+    /// fills `budgets` with one entry per memory heap. Returns the slice of `budgets` that was written to.
+    pub fn getHeapBudgets(self: Allocator, budgets: *[vk.MAX_MEMORY_HEAPS]VmaBudget) []VmaBudget {
+        vmaGetHeapBudgets(self.allocator, budgets);
+        return budgets[0..self.getMemoryProperties().memory_heap_count];
+    }
+
+    /// returns the JSON dump of the allocator state. The string must be released with `freeStatsString`.
+    pub fn buildStatsString(self: Allocator, detailed_map: bool) [:0]u8 {
+        var str: [*c]u8 = null;
+        vmaBuildStatsString(self.allocator, &str, if (detailed_map) vk.TRUE else vk.FALSE);
+        return std.mem.span(@ptrCast([*:0]u8, str));
+    }
+
+    pub fn freeStatsString(self: Allocator, str: [:0]u8) void {
+        vmaFreeStatsString(self.allocator, str.ptr);
+    }
+
+    pub fn writeStatsToFile(self: Allocator, path: []const u8, detailed_map: bool) !void {
+        const str = self.buildStatsString(detailed_map);
+        defer self.freeStatsString(str);
+        try std.fs.cwd().writeFile(path, str);
+    }
+
+    /// `name` must outlive the Pool since VMA only keeps a copy for its JSON dump
+    pub fn createPool(self: Allocator, name: [:0]const u8, create_info: *const VmaPoolCreateInfo) !Pool {
+        var pool: VmaPool = undefined;
+        const res = vmaCreatePool(self.allocator, create_info, &pool);
+        if (res == vk.Result.success) {
+            vmaSetPoolName(self.allocator, pool, name.ptr);
+            return Pool{ .pool = pool, .name = name, .block_size = create_info.blockSize };
+        }
+        return switch (res) {
+            .error_out_of_host_memory => error.out_of_host_memory,
+            .error_out_of_device_memory => error.out_of_device_memory,
+            .error_feature_not_present => error.feature_not_present,
+            else => error.undocumented_error,
+        };
+    }
+
+    pub fn findMemoryTypeIndexForBufferInfo(self: Allocator, buffer_create_info: *const vk.BufferCreateInfo, alloc_info: *const VmaAllocationCreateInfo) !u32 {
+        var index: u32 = undefined;
+        const res = vmaFindMemoryTypeIndexForBufferInfo(self.allocator, buffer_create_info, alloc_info, &index);
+        if (res == vk.Result.success) return index;
+        return switch (res) {
+            .error_feature_not_present => error.feature_not_present,
+            else => error.undocumented_error,
+        };
+    }
+
+    pub fn findMemoryTypeIndexForImageInfo(self: Allocator, img_create_info: *const vk.ImageCreateInfo, alloc_info: *const VmaAllocationCreateInfo) !u32 {
+        var index: u32 = undefined;
+        const res = vmaFindMemoryTypeIndexForImageInfo(self.allocator, img_create_info, alloc_info, &index);
+        if (res == vk.Result.success) return index;
+        return switch (res) {
+            .error_feature_not_present => error.feature_not_present,
+            else => error.undocumented_error,
+        };
+    }
+
+    pub fn getAllocationInfo(self: Allocator, allocation: VmaAllocation) VmaAllocationInfo {
+        var info: VmaAllocationInfo = undefined;
+        vmaGetAllocationInfo(self.allocator, allocation, &info);
+        return info;
+    }
+
+    pub fn setAllocationUserData(self: Allocator, allocation: VmaAllocation, user_data: ?*anyopaque) void {
+        vmaSetAllocationUserData(self.allocator, allocation, user_data);
+    }
+
+    pub fn bindBufferMemory(self: Allocator, allocation: VmaAllocation, buffer: vk.Buffer) !void {
+        const res = vmaBindBufferMemory(self.allocator, allocation, buffer);
+        switch (res) {
+            .success => {},
+            .error_out_of_host_memory => return error.OutOfHostMemory,
+            .error_out_of_device_memory => return error.OutOfDeviceMemory,
+            else => return error.Unknown,
+        }
+    }
+
+    pub fn bindImageMemory(self: Allocator, allocation: VmaAllocation, image: vk.Image) !void {
+        const res = vmaBindImageMemory(self.allocator, allocation, image);
+        switch (res) {
+            .success => {},
+            .error_out_of_host_memory => return error.OutOfHostMemory,
+            .error_out_of_device_memory => return error.OutOfDeviceMemory,
+            else => return error.Unknown,
+        }
+    }
+
+    /// binds `image` at `offset` inside the allocation, for several resources sharing one allocation
+    pub fn bindImageMemoryAtOffset(self: Allocator, allocation: VmaAllocation, offset: vk.DeviceSize, image: vk.Image) !void {
+        const res = vmaBindImageMemory2(self.allocator, allocation, offset, image, null);
+        switch (res) {
+            .success => {},
+            .error_out_of_host_memory => return error.OutOfHostMemory,
+            .error_out_of_device_memory => return error.OutOfDeviceMemory,
+            else => return error.Unknown,
+        }
+    }
+
+    /// memory not tied to any resource, resources are bound to it afterwards
+    pub fn allocateMemory(self: Allocator, requirements: *const vk.MemoryRequirements, alloc_info: *const VmaAllocationCreateInfo) !VmaAllocation {
+        var allocation: VmaAllocation = undefined;
+        const res = vmaAllocateMemory(self.allocator, requirements, alloc_info, &allocation, null);
+        if (res == vk.Result.success) return allocation;
+        return switch (res) {
+            .error_out_of_device_memory => error.out_of_device_memory,
+            .error_out_of_host_memory => error.out_of_host_memory,
+            else => error.undocumented_error,
+        };
+    }
+
+    pub fn freeMemory(self: Allocator, allocation: VmaAllocation) void {
+        vmaFreeMemory(self.allocator, allocation);
+    }
+
+    pub fn beginDefragmentation(self: Allocator, info: *const VmaDefragmentationInfo) !DefragmentationContext {
+        var context: VmaDefragmentationContext = undefined;
+        const res = vmaBeginDefragmentation(self.allocator, info, &context);
+        if (res == vk.Result.success) return DefragmentationContext{ .allocator = self.allocator, .context = context };
+        return switch (res) {
+            .error_feature_not_present => error.feature_not_present,
+            .error_out_of_host_memory => error.out_of_host_memory,
+            else => error.undocumented_error,
+        };
+    }
+};
+
+pub const Pool = struct {
+    pool: VmaPool,
+    name: [:0]const u8,
+    /// 0 means VMA manages block sizes and the pool also supports dedicated allocations
+    block_size: vk.DeviceSize,
+
+    pub fn deinit(self: Pool, allocator: Allocator) void {
+        vmaDestroyPool(allocator.allocator, self.pool);
+    }
+
+    /// returns true if an allocation of `size` fits into one of the pools blocks
+    pub fn fits(self: Pool, size: vk.DeviceSize) bool {
+        return self.block_size == 0 or size <= self.block_size;
+    }
+
+    /// like `fits` for a resource whose memory requirements, including tiling padding and alignment, are known
+    pub fn fitsRequirements(self: Pool, requirements: vk.MemoryRequirements) bool {
+        return self.fits(std.mem.alignForwardGeneric(vk.DeviceSize, requirements.size, requirements.alignment));
+    }
+
+    /// fast, only reads the counters VMA maintains
+    pub fn getStatistics(self: Pool, allocator: Allocator) VmaStatistics {
+        var stats: VmaStatistics = undefined;
+        vmaGetPoolStatistics(allocator.allocator, self.pool, &stats);
+        return stats;
+    }
+
+    /// slow, walks every allocation in the pool
+    pub fn calculateStatistics(self: Pool, allocator: Allocator) VmaDetailedStatistics {
+        var stats: VmaDetailedStatistics = undefined;
+        vmaCalculatePoolStatistics(allocator.allocator, self.pool, &stats);
+        return stats;
+    }
+};
+
+/// CPU-side suballocator using the same TLSF algorithm as real VMA blocks. Offsets and sizes are in whatever unit the
+/// caller chooses, e.g. elements of a larger buffer.
+pub const VirtualBlock = struct {
+    pub const Allocation = struct {
+        allocation: VmaVirtualAllocation,
+        offset: vk.DeviceSize,
+    };
+
+    block: VmaVirtualBlock,
+
+    pub fn init(size: vk.DeviceSize) !VirtualBlock {
+        const create_info = std.mem.zeroInit(VmaVirtualBlockCreateInfo, .{ .size = size });
+        var block: VmaVirtualBlock = undefined;
+        const res = vmaCreateVirtualBlock(&create_info, &block);
+        if (res == vk.Result.success) return VirtualBlock{ .block = block };
+        return switch (res) {
+            .error_out_of_host_memory => error.out_of_host_memory,
+            else => error.undocumented_error,
+        };
+    }
+
+    /// all allocations must be freed first
+    pub fn deinit(self: VirtualBlock) void {
+        vmaDestroyVirtualBlock(self.block);
+    }
+
+    pub fn allocate(self: VirtualBlock, size: vk.DeviceSize, alignment: vk.DeviceSize) !Allocation {
+        const create_info = std.mem.zeroInit(VmaVirtualAllocationCreateInfo, .{
+            .size = size,
+            .alignment = alignment,
+        });
+
+        var allocation: VmaVirtualAllocation = undefined;
+        var offset: vk.DeviceSize = undefined;
+        const res = vmaVirtualAllocate(self.block, &create_info, &allocation, &offset);
+        if (res == vk.Result.success) return Allocation{ .allocation = allocation, .offset = offset };
+        return switch (res) {
+            .error_out_of_device_memory => error.out_of_device_memory,
+            else => error.undocumented_error,
+        };
+    }
+
+    pub fn free(self: VirtualBlock, allocation: VmaVirtualAllocation) void {
+        vmaVirtualFree(self.block, allocation);
+    }
+
+    pub fn getStatistics(self: VirtualBlock) VmaStatistics {
+        var stats: VmaStatistics = undefined;
+        vmaGetVirtualBlockStatistics(self.block, &stats);
+        return stats;
+    }
+};
+
+pub const DefragmentationContext = struct {
+    allocator: VmaAllocator,
+    context: VmaDefragmentationContext,
+
+    /// returns true if `pass` was filled with moves that need to be performed. False means defragmentation is complete
+    /// and `end` should be called.
+    pub fn beginPass(self: DefragmentationContext, pass: *VmaDefragmentationPassMoveInfo) !bool {
+        return switch (vmaBeginDefragmentationPass(self.allocator, self.context, pass)) {
+            .success => false,
+            .incomplete => true,
+            .error_out_of_host_memory => error.out_of_host_memory,
+            .error_out_of_device_memory => error.out_of_device_memory,
+            else => error.undocumented_error,
+        };
+    }
+
+    /// all copies for the moves in `pass` must have completed on the GPU before calling this. Returns true if more passes are required.
+    pub fn endPass(self: DefragmentationContext, pass: *VmaDefragmentationPassMoveInfo) !bool {
+        return switch (vmaEndDefragmentationPass(self.allocator, self.context, pass)) {
+            .success => false,
+            .incomplete => true,
+            else => error.undocumented_error,
+        };
+    }
+
+    pub fn end(self: DefragmentationContext) VmaDefragmentationStats {
+        var stats: VmaDefragmentationStats = undefined;
+        vmaEndDefragmentation(self.allocator, self.context, &stats);
+        return stats;
+    }
 };
 
 // manually created types
@@ -241,6 +512,46 @@ pub const AllocatorCreateFlags = packed struct {
 // pub const VmaAllocatorCreateFlags = VkFlags;
 pub const VmaAllocatorCreateFlags = AllocatorCreateFlags;
 
+pub const PoolCreateFlags = packed struct {
+    __reserved_bits_1: u1 = 0,
+    ignore_buffer_image_granularity: bool = false,
+    linear_algorithm: bool = false,
+    __reserved_bits_4: u1 = 0,
+    __reserved_bits_5: u1 = 0,
+    __reserved_bits_6: u1 = 0,
+    __reserved_bits_7: u1 = 0,
+    __reserved_bits_8: u1 = 0,
+    __reserved_bits_9: u1 = 0,
+    __reserved_bits_10: u1 = 0,
+    __reserved_bits_11: u1 = 0,
+    __reserved_bits_12: u1 = 0,
+    __reserved_bits_13: u1 = 0,
+    __reserved_bits_14: u1 = 0,
+    __reserved_bits_15: u1 = 0,
+    __reserved_bits_16: u1 = 0,
+    __reserved_bits_17: u1 = 0,
+    __reserved_bits_18: u1 = 0,
+    __reserved_bits_19: u1 = 0,
+    __reserved_bits_20: u1 = 0,
+    __reserved_bits_21: u1 = 0,
+    __reserved_bits_22: u1 = 0,
+    __reserved_bits_23: u1 = 0,
+    __reserved_bits_24: u1 = 0,
+    __reserved_bits_25: u1 = 0,
+    __reserved_bits_26: u1 = 0,
+    __reserved_bits_27: u1 = 0,
+    __reserved_bits_28: u1 = 0,
+    __reserved_bits_29: u1 = 0,
+    __reserved_bits_30: u1 = 0,
+    __reserved_bits_31: u1 = 0,
+    __reserved_bits_32: u1 = 0,
+
+    pub usingnamespace vk.FlagsMixin(@This(), vk.Flags);
+};
+// comment line from translate-c generated source below
+// pub const VmaPoolCreateFlags = VkFlags;
+pub const VmaPoolCreateFlags = PoolCreateFlags;
+
 // end manually created types
 
 
@@ -341,7 +652,7 @@ pub const VMA_POOL_CREATE_ALGORITHM_MASK: c_int = 4;
 pub const VMA_POOL_CREATE_FLAG_BITS_MAX_ENUM: c_int = 2147483647;
 pub const enum_VmaPoolCreateFlagBits = c_uint;
 pub const VmaPoolCreateFlagBits = enum_VmaPoolCreateFlagBits;
-pub const VmaPoolCreateFlags = VkFlags;
+// pub const VmaPoolCreateFlags = VkFlags;
 pub const VMA_DEFRAGMENTATION_FLAG_ALGORITHM_FAST_BIT: c_int = 1;
 pub const VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT: c_int = 2;
 pub const VMA_DEFRAGMENTATION_FLAG_ALGORITHM_FULL_BIT: c_int = 4;
@@ -1,5 +1,10 @@
 #version 450
 
+// permutations: TEXTURED is a build time define since it changes the descriptor interface, fog is a specialization
+// constant set per pipeline
+
+layout (constant_id = 0) const bool use_fog = false;
+
 layout (location = 0) out vec4 outFragColor;
 
 layout (location = 0) in vec3 inColor;
@@ -13,9 +18,22 @@ layout (set = 0, binding = 1) uniform SceneData {
 	vec4 sunlightColor;
 } sceneData;
 
+#ifdef TEXTURED
 layout (set = 2, binding = 0) uniform sampler2D tex1;
+#endif
 
 void main() {
+#ifdef TEXTURED
 	vec3 color = texture(tex1, texCoord).xyz * sceneData.ambientColor.xyz;
+#else
+	vec3 color = inColor * sceneData.ambientColor.xyz;
+#endif
+
+	if (use_fog) {
+		float dist = gl_FragCoord.z / gl_FragCoord.w;
+		float fog = smoothstep(sceneData.fogDistances.x, sceneData.fogDistances.y, dist);
+		color = mix(color, sceneData.fogColor.xyz, fog);
+	}
+
 	outFragColor = vec4(color, 1.0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,25 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) out vec4 outFragColor;
+
+layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 texCoord;
+layout (location = 2) flat in uint textureIndex;
+
+layout (set = 0, binding = 1) uniform SceneData {
+    vec4 fogColor; // w is for exponent
+	vec4 fogDistances; // x for min, y for max, zw unused.
+	vec4 ambientColor;
+	vec4 sunlightDirection; // w for sun power
+	vec4 sunlightColor;
+} sceneData;
+
+// every texture, indexed by the objects texture_index. Slot 0 is empty and means the vertex color is used instead.
+layout (set = 2, binding = 0) uniform sampler2D textures[];
+
+void main() {
+	// instances of one draw can use different textures so the index is not dynamically uniform
+	vec3 base = textureIndex == 0 ? inColor : texture(textures[nonuniformEXT(textureIndex)], texCoord).xyz;
+	outFragColor = vec4(base * sceneData.ambientColor.xyz, 1.0);
+}
\ No newline at end of file
@@ -7,6 +7,7 @@ layout (location = 3) in vec2 vTexCoord;
 
 layout (location = 0) out vec3 outColor;
 layout (location = 1) out vec2 texCoord;
+layout (location = 2) flat out uint textureIndex;
 
 // descriptor set bound at slot 0, and it’s binding 0 within that descriptor set
 layout (set = 0, binding = 0) uniform CameraBuffer {
@@ -17,6 +18,8 @@ layout (set = 0, binding = 0) uniform CameraBuffer {
 
 struct ObjectData {
 	mat4 model;
+	// slot in the bindless texture array, 0 for none
+	uint texture_index;
 };
 
 // all object matrices
@@ -24,15 +27,17 @@ layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
 	ObjectData objects[];
 } objectBuffer;
 
+// per draw material values, matches DrawPushConstants in gpu_driven.zig
 layout (push_constant) uniform constants {
-	vec4 data;
-	mat4 render_matrix;
+	vec4 tint;
 } PushConstants;
 
 void main() {
-	mat4 model_matrix = objectBuffer.objects[gl_BaseInstance].model;
+	// gl_InstanceIndex already includes the draw's firstInstance so instanced batches index consecutive objects
+	mat4 model_matrix = objectBuffer.objects[gl_InstanceIndex].model;
 	mat4 transform_matrix = camera_data.view_proj * model_matrix;
 	gl_Position = transform_matrix * vec4(vPosition, 1.0);
-	outColor = vColor;
+	outColor = vColor * PushConstants.tint.rgb;
 	texCoord = vTexCoord;
+	textureIndex = objectBuffer.objects[gl_InstanceIndex].texture_index;
 }
\ No newline at end of file
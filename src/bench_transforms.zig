@@ -0,0 +1,78 @@
+const std = @import("std");
+const transforms = @import("transforms.zig");
+const JobPool = @import("job_pool.zig").JobPool;
+const Mat4 = @import("chapters/mat4.zig").Mat4;
+const Vec3 = @import("chapters/vec3.zig").Vec3;
+
+// zig build bench_transforms
+// times the per-object Mat4 path the engine used to run against the SoA update, single threaded and on every core
+
+const counts = [_]usize{ 10_000, 100_000, 1_000_000 };
+const iterations = 20;
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const serial = try JobPool.init(allocator, 0);
+    defer serial.deinit();
+    const parallel = try JobPool.initForCpu(allocator, 64);
+    defer parallel.deinit();
+
+    std.debug.print("{s:>10} {s:>12} {s:>12} {s:>12}\n", .{ "objects", "mat4 ms", "soa ms", "soa mt ms" });
+
+    var rng = std.rand.DefaultPrng.init(31);
+    const random = rng.random();
+
+    for (counts) |count| {
+        var list = transforms.TransformList{};
+        defer list.deinit(allocator);
+        try list.ensureTotalCapacity(allocator, count);
+
+        var bases = try allocator.alloc(Mat4, count);
+        defer allocator.free(bases);
+
+        for (bases) |*base, i| {
+            const pos = Vec3.new(random.float(f32) * 100, random.float(f32) * 100, random.float(f32) * 100);
+            const scale = 0.2 + random.float(f32);
+            base.* = Mat4.mul(Mat4.createTranslation(pos), Mat4.createScale(.{ .x = scale, .y = scale, .z = scale }));
+            list.appendAssumeCapacity(.{ .x = pos.x, .y = pos.y, .z = pos.z, .sx = scale, .sy = scale, .sz = scale, .spin = @intToFloat(f32, i) });
+        }
+
+        var out = try allocator.alloc(transforms.Matrix, count);
+        defer allocator.free(out);
+
+        var timer = try std.time.Timer.start();
+        var iter: usize = 0;
+        while (iter < iterations) : (iter += 1) {
+            const angle = @intToFloat(f32, iter) * 0.01;
+            for (bases) |base, i| {
+                const rot = Mat4.createAngleAxis(.{ .y = 1 }, angle + @intToFloat(f32, i));
+                out[i] = base.mul(rot).fields;
+            }
+        }
+        const mat4_ns = timer.lap();
+        std.mem.doNotOptimizeAway(&out[count - 1]);
+
+        iter = 0;
+        while (iter < iterations) : (iter += 1) {
+            transforms.computeWorldMatricesParallel(serial, list.slice(), null, @intToFloat(f32, iter) * 0.01, out);
+        }
+        const soa_ns = timer.lap();
+        std.mem.doNotOptimizeAway(&out[count - 1]);
+
+        iter = 0;
+        while (iter < iterations) : (iter += 1) {
+            transforms.computeWorldMatricesParallel(parallel, list.slice(), null, @intToFloat(f32, iter) * 0.01, out);
+        }
+        const soa_mt_ns = timer.lap();
+        std.mem.doNotOptimizeAway(&out[count - 1]);
+
+        std.debug.print("{d:>10} {d:>12.3} {d:>12.3} {d:>12.3}\n", .{ count, toMs(mat4_ns), toMs(soa_ns), toMs(soa_mt_ns) });
+    }
+}
+
+fn toMs(ns: u64) f64 {
+    return @intToFloat(f64, ns) / iterations / std.time.ns_per_ms;
+}
@@ -0,0 +1,138 @@
+const std = @import("std");
+const vk = @import("vulkan");
+const vkinit = @import("vkinit.zig");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+
+/// One descriptor set holding every texture as an element of a `sampler2D textures[]` array, so materials reference
+/// textures by index instead of binding a set each. Built on descriptor indexing: the binding is partially bound so unused
+/// slots may stay empty and update-after-bind so textures can be added while frames using the set are in flight.
+///
+/// Slot 0 is never written, shaders treat index 0 as "no texture". Slots that are no longer referenced are retired and
+/// only reused once every frame that was in flight when they were retired finished.
+pub const BindlessTextures = struct {
+    pub const max_textures = 1024;
+
+    const Retired = struct {
+        index: u32,
+        /// frame index the slot was retired in
+        frame: usize,
+    };
+
+    gc: *const GraphicsContext,
+    allocator: std.mem.Allocator,
+    layout: vk.DescriptorSetLayout,
+    pool: vk.DescriptorPool,
+    set: vk.DescriptorSet,
+    /// next never used slot
+    count: u32 = 1,
+    /// slots `add` hands out before new ones. Reserved for every slot up front so `recycle` cannot fail.
+    free_slots: std.ArrayListUnmanaged(u32) = .{},
+    /// in the order they were retired
+    retired: std.ArrayListUnmanaged(Retired) = .{},
+
+    pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator) !BindlessTextures {
+        if (!gc.descriptor_indexing) return error.DescriptorIndexingUnsupported;
+
+        const binding = vk.DescriptorSetLayoutBinding{
+            .binding = 0,
+            .descriptor_type = .combined_image_sampler,
+            .descriptor_count = max_textures,
+            .stage_flags = .{ .fragment_bit = true },
+            .p_immutable_samplers = null,
+        };
+        const binding_flags = vk.DescriptorBindingFlags{ .partially_bound_bit = true, .update_after_bind_bit = true };
+        const flags_info = vk.DescriptorSetLayoutBindingFlagsCreateInfo{
+            .binding_count = 1,
+            .p_binding_flags = @ptrCast([*]const vk.DescriptorBindingFlags, &binding_flags),
+        };
+
+        // not from the DescriptorLayoutCache, which does not key on flags and extensions
+        const layout = try gc.vkd.createDescriptorSetLayout(gc.dev, &.{
+            .p_next = &flags_info,
+            .flags = .{ .update_after_bind_pool_bit = true },
+            .binding_count = 1,
+            .p_bindings = @ptrCast([*]const vk.DescriptorSetLayoutBinding, &binding),
+        }, null);
+        errdefer gc.destroy(layout);
+
+        const pool_size = vk.DescriptorPoolSize{ .@"type" = .combined_image_sampler, .descriptor_count = max_textures };
+        const pool = try gc.vkd.createDescriptorPool(gc.dev, &.{
+            .flags = .{ .update_after_bind_bit = true },
+            .max_sets = 1,
+            .pool_size_count = 1,
+            .p_pool_sizes = @ptrCast([*]const vk.DescriptorPoolSize, &pool_size),
+        }, null);
+        errdefer gc.destroy(pool);
+
+        var set: vk.DescriptorSet = undefined;
+        try gc.vkd.allocateDescriptorSets(gc.dev, &.{
+            .descriptor_pool = pool,
+            .descriptor_set_count = 1,
+            .p_set_layouts = @ptrCast([*]const vk.DescriptorSetLayout, &layout),
+        }, @ptrCast([*]vk.DescriptorSet, &set));
+
+        var free_slots = std.ArrayListUnmanaged(u32){};
+        try free_slots.ensureTotalCapacity(allocator, max_textures);
+
+        return BindlessTextures{
+            .gc = gc,
+            .allocator = allocator,
+            .layout = layout,
+            .pool = pool,
+            .set = set,
+            .free_slots = free_slots,
+        };
+    }
+
+    pub fn deinit(self: *BindlessTextures) void {
+        // destroying the pool frees the set
+        self.gc.destroy(self.pool);
+        self.gc.destroy(self.layout);
+        self.free_slots.deinit(self.allocator);
+        self.retired.deinit(self.allocator);
+    }
+
+    /// writes the texture into a free slot and returns its index. Slots are only written while no frame in flight can
+    /// read them, either never used or recycled.
+    pub fn add(self: *BindlessTextures, view: vk.ImageView, sampler: vk.Sampler) !u32 {
+        const index = self.free_slots.popOrNull() orelse blk: {
+            if (self.count == max_textures) return error.TooManyTextures;
+            self.count += 1;
+            break :blk self.count - 1;
+        };
+
+        const image_info = vk.DescriptorImageInfo{
+            .sampler = sampler,
+            .image_view = view,
+            .image_layout = .shader_read_only_optimal,
+        };
+        var write = vkinit.writeDescriptorImage(.combined_image_sampler, self.set, &image_info, 0);
+        write.dst_array_element = index;
+        self.gc.vkd.updateDescriptorSets(self.gc.dev, 1, @ptrCast([*]const vk.WriteDescriptorSet, &write), 0, undefined);
+
+        return index;
+    }
+
+    /// queues a slot nothing recorded from now on references. Frames in flight may still read it so it is only reused
+    /// by `recycle`.
+    pub fn retire(self: *BindlessTextures, index: u32, frame_index: usize) !void {
+        std.debug.assert(index != 0 and index < self.count);
+        try self.retired.append(self.allocator, .{ .index = index, .frame = frame_index });
+    }
+
+    /// hands the retired slots whose frames finished back to `add`. Call once per frame after the frame's fence was
+    /// waited on. `frames_in_flight` is how many frames can be queued on the GPU at once.
+    pub fn recycle(self: *BindlessTextures, frame_index: usize, frames_in_flight: usize) void {
+        var done: usize = 0;
+        for (self.retired.items) |retired| {
+            if (frame_index < retired.frame + frames_in_flight) break;
+            self.free_slots.appendAssumeCapacity(retired.index);
+            done += 1;
+        }
+        if (done == 0) return;
+
+        std.mem.copy(Retired, self.retired.items, self.retired.items[done..]);
+        self.retired.shrinkRetainingCapacity(self.retired.items.len - done);
+    }
+};
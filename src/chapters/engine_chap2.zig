@@ -238,7 +238,7 @@ fn createPipeline(
     var builder = PipelineBuilder.init(allocator, pipeline_layout);
     try builder.addShaderStage(createShaderStageCreateInfo(vert, .{ .vertex_bit = true }));
     try builder.addShaderStage(createShaderStageCreateInfo(frag, .{ .fragment_bit = true }));
-    return try builder.build(gc, render_pass);
+    return try builder.build(gc, render_pass, .null_handle);
 }
 
 fn createPipeline2(
@@ -256,7 +256,7 @@ fn createPipeline2(
     var builder = PipelineBuilder.init(allocator, pipeline_layout);
     try builder.addShaderStage(createShaderStageCreateInfo(vert, .{ .vertex_bit = true }));
     try builder.addShaderStage(createShaderStageCreateInfo(frag, .{ .fragment_bit = true }));
-    return try builder.build(gc, render_pass);
+    return try builder.build(gc, render_pass, .null_handle);
 }
 
 fn recordCommandBuffer(
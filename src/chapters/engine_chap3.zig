@@ -8,7 +8,7 @@ const vkinit = @import("../vkinit.zig");
 const GraphicsContext = @import("../graphics_context.zig").GraphicsContext;
 const Swapchain = @import("../swapchain.zig").Swapchain;
 const PipelineBuilder = @import("../pipeline_builder.zig").PipelineBuilder;
-const Mesh = @import("../mesh.zig").Mesh;
+const Mesh = @import("../mesh.zig").StandaloneMesh;
 const Vertex = @import("../mesh.zig").Vertex;
 const Allocator = std.mem.Allocator;
 const Mat4 = @import("mat4.zig").Mat4;
@@ -154,7 +154,7 @@ pub const EngineChap3 = struct {
 
         self.depth_image.deinit(self.vk_allocator);
         self.gc.vkd.destroyImageView(self.gc.dev, self.depth_image_view, null);
-        self.triangle_mesh.deinit(self.vk_allocator);
+        self.triangle_mesh.deinit(.{ .allocator = self.vk_allocator });
         vma.vmaDestroyAllocator(self.vk_allocator);
 
         self.gc.vkd.freeCommandBuffers(self.gc.dev, self.pool, 1, @ptrCast([*]vk.CommandBuffer, &self.main_cmd_buffer));
@@ -362,7 +362,7 @@ fn createPipeline(
 
     try builder.addShaderStage(createShaderStageCreateInfo(vert, .{ .vertex_bit = true }));
     try builder.addShaderStage(createShaderStageCreateInfo(frag, .{ .fragment_bit = true }));
-    return try builder.build(gc, render_pass);
+    return try builder.build(gc, render_pass, .null_handle);
 }
 
 fn loadMeshes() !Mesh {
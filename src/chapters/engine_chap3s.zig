@@ -8,7 +8,7 @@ const vkinit = @import("../vkinit.zig");
 const GraphicsContext = @import("../graphics_context.zig").GraphicsContext;
 const Swapchain = @import("../swapchain.zig").Swapchain;
 const PipelineBuilder = @import("../pipeline_builder.zig").PipelineBuilder;
-const Mesh = @import("../mesh.zig").Mesh;
+const Mesh = @import("../mesh.zig").StandaloneMesh;
 const Vertex = @import("../mesh.zig").Vertex;
 const Allocator = std.mem.Allocator;
 const Mat4 = @import("mat4.zig").Mat4;
@@ -233,7 +233,7 @@ pub const EngineChap3s = struct {
         self.gc.vkd.destroyImageView(self.gc.dev, self.depth_image_view, null);
 
         var iter = self.meshes.valueIterator();
-        while (iter.next()) |mesh| mesh.*.deinit(self.vk_allocator);
+        while (iter.next()) |mesh| mesh.*.deinit(.{ .allocator = self.vk_allocator });
         vma.vmaDestroyAllocator(self.vk_allocator);
 
         self.gc.vkd.freeCommandBuffers(self.gc.dev, self.pool, 1, @ptrCast([*]vk.CommandBuffer, &self.main_cmd_buffer));
@@ -325,8 +325,8 @@ pub const EngineChap3s = struct {
         try tri_mesh.vertices.append(.{ .position = .{ -1, 1, 0 }, .normal = .{ 0, 0, 0 }, .color = .{ 0, 1, 0 } });
         try tri_mesh.vertices.append(.{ .position = .{ 0, -1, 0 }, .normal = .{ 0, 0, 0 }, .color = .{ 0, 1, 0 } });
 
-        var monkey_mesh = Mesh.initFromObj(gpa, "src/chapters/monkey_smooth.obj");
-        var cube_thing_mesh = Mesh.initFromObj(gpa, "src/chapters/cube_thing.obj");
+        var monkey_mesh = try Mesh.initFromObj(gpa, "src/chapters/monkey_smooth.obj");
+        var cube_thing_mesh = try Mesh.initFromObj(gpa, "src/chapters/cube_thing.obj");
 
         uploadMesh(&tri_mesh, self.vk_allocator);
         uploadMesh(&monkey_mesh, self.vk_allocator);
@@ -648,7 +648,7 @@ fn createPipeline(
 
     try builder.addShaderStage(createShaderStageCreateInfo(vert, .{ .vertex_bit = true }));
     try builder.addShaderStage(createShaderStageCreateInfo(frag, .{ .fragment_bit = true }));
-    return try builder.build(gc, render_pass);
+    return try builder.build(gc, render_pass, .null_handle);
 }
 
 fn uploadMesh(mesh: *Mesh, allocator: vma.VmaAllocator) void {
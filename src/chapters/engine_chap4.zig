@@ -8,7 +8,7 @@ const vkinit = @import("../vkinit.zig");
 const GraphicsContext = @import("../graphics_context.zig").GraphicsContext;
 const Swapchain = @import("../swapchain.zig").Swapchain;
 const PipelineBuilder = @import("../pipeline_builder.zig").PipelineBuilder;
-const Mesh = @import("../mesh.zig").Mesh;
+const Mesh = @import("../mesh.zig").StandaloneMesh;
 const Vertex = @import("../mesh.zig").Vertex;
 const Allocator = std.mem.Allocator;
 const Mat4 = @import("mat4.zig").Mat4;
@@ -102,13 +102,18 @@ const GpuSceneData = struct {
     sun_color: Vec4 = Vec4.new(1, 0, 0, 1),
 };
 
-const GpuObjectData = struct {
+/// matches ObjectData in tri_mesh_descriptors.vert, including the padding std140 adds to the array stride
+const GpuObjectData = extern struct {
     model: Mat4,
+    /// chapter 4 has no bindless textures, 0 means none
+    texture_index: u32 = 0,
+    pad: [3]u32 = .{ 0, 0, 0 },
 };
 
 const FrameData = struct {
     cmd_pool: vk.CommandPool,
     cmd_buffer: vk.CommandBuffer,
+    render_fence: vk.Fence,
     camera_buffer: vma.AllocatedBuffer,
     global_descriptor: vk.DescriptorSet,
     object_buffer: vma.AllocatedBuffer,
@@ -127,6 +132,9 @@ const FrameData = struct {
             .command_buffer_count = 1,
         }, @ptrCast([*]vk.CommandBuffer, &cmd_buffer));
 
+        // signalled so the first wait on a fresh slot returns immediately
+        const render_fence = try gc.vkd.createFence(gc.dev, &.{ .flags = .{ .signaled_bit = true } }, null);
+
         // descriptor set setup
         var camera_buffer = try createBuffer(gc, @sizeOf(GpuCameraData), .{ .uniform_buffer_bit = true }, .cpu_to_gpu);
 
@@ -177,6 +185,7 @@ const FrameData = struct {
         return FrameData{
             .cmd_pool = cmd_pool,
             .cmd_buffer = cmd_buffer,
+            .render_fence = render_fence,
             .camera_buffer = camera_buffer,
             .global_descriptor = global_descriptor,
             .object_buffer = object_buffer,
@@ -187,9 +196,15 @@ const FrameData = struct {
     pub fn deinit(self: *FrameData, gc: *GraphicsContext) void {
         gc.vkd.freeCommandBuffers(gc.dev, self.cmd_pool, 1, @ptrCast([*]vk.CommandBuffer, &self.cmd_buffer));
         gc.vkd.destroyCommandPool(gc.dev, self.cmd_pool, null);
+        gc.vkd.destroyFence(gc.dev, self.render_fence, null);
         self.camera_buffer.deinit(gc.allocator);
         self.object_buffer.deinit(gc.allocator);
     }
+
+    /// blocks until the GPU finished the last submission that used this frame
+    pub fn waitForFence(self: FrameData, gc: *const GraphicsContext) !void {
+        _ = try gc.vkd.waitForFences(gc.dev, 1, @ptrCast([*]const vk.Fence, &self.render_fence), vk.TRUE, std.math.maxInt(u64));
+    }
 };
 
 const Material = struct {
@@ -216,7 +231,8 @@ const gpa = general_purpose_allocator.allocator();
 const depth_format = vk.Format.d32_sfloat;
 
 const MeshPushConstants = struct {
-    data: Vec4 = .{},
+    /// read as the tint by tri_mesh_descriptors.vert
+    data: Vec4 = Vec4.new(1, 1, 1, 1),
     render_matrix: Mat4,
 };
 
@@ -257,7 +273,7 @@ pub const EngineChap4 = struct {
         gc.* = try GraphicsContext.init(gpa, app_name, window);
 
         // swapchain
-        var swapchain = try Swapchain.init(gc, gpa, extent, FRAME_OVERLAP);
+        var swapchain = try Swapchain.init(gc, gpa, extent, FRAME_OVERLAP, FRAME_OVERLAP, .fifo_khr);
         const render_pass = try createRenderPass(gc, swapchain);
 
         // depth image
@@ -268,8 +284,8 @@ pub const EngineChap4 = struct {
         const gpu_props = gc.vki.getPhysicalDeviceProperties(gc.pdev);
         const descriptors = createDescriptors(gc, gpu_props);
 
-        // create our FrameDatas
-        const frames = try gpa.alloc(FrameData, swapchain.swap_images.len);
+        // create our FrameDatas, one per frame in flight
+        const frames = try gpa.alloc(FrameData, FRAME_OVERLAP);
         errdefer gpa.free(frames);
         for (frames) |*f| f.* = try FrameData.init(gc, descriptors.layout, descriptors.pool, descriptors.scene_param_buffer, descriptors.object_set_layout);
 
@@ -351,20 +367,24 @@ pub const EngineChap4 = struct {
 
             self.camera.update(self.dt);
 
-            // wait for the last frame to complete before filling our CommandBuffer
-            const state = self.swapchain.waitForFrame() catch |err| switch (err) {
+            // wait for the last use of this frame slot to complete before filling its CommandBuffer
+            const frame = self.frames[self.swapchain.frameSlot()];
+            try frame.waitForFence(self.gc);
+
+            const state = self.swapchain.acquireNextImage() catch |err| switch (err) {
                 error.OutOfDateKHR => Swapchain.PresentState.suboptimal,
                 else => |narrow| return narrow,
             };
 
-            const frame = self.frames[self.swapchain.frame_index % self.swapchain.swap_images.len];
+            // only reset once a submit that signals the fence is guaranteed to follow
+            try self.gc.vkd.resetFences(self.gc.dev, 1, @ptrCast([*]const vk.Fence, &frame.render_fence));
             try self.draw(self.framebuffers[self.swapchain.image_index], frame);
 
-            try self.swapchain.present(frame.cmd_buffer);
+            try self.swapchain.present(frame.cmd_buffer, frame.render_fence);
 
             // TODO: why does this have to be after present?
             if (state == .suboptimal) {
-                try self.swapchain.waitForAllFences();
+                for (self.frames) |f| try f.waitForFence(self.gc);
 
                 const size = try self.window.getSize();
                 var extent = vk.Extent2D{ .width = size.width, .height = size.height };
@@ -390,8 +410,8 @@ pub const EngineChap4 = struct {
         try tri_mesh.vertices.append(.{ .position = .{ -1, 1, 0 }, .normal = .{ 0, 0, 0 }, .color = .{ 0.6, 0.6, 0.6 } });
         try tri_mesh.vertices.append(.{ .position = .{ 0, -1, 0 }, .normal = .{ 0, 0, 0 }, .color = .{ 0.6, 0.6, 0.6 } });
 
-        var monkey_mesh = Mesh.initFromObj(gpa, "src/chapters/monkey_flat.obj");
-        var cube_thing_mesh = Mesh.initFromObj(gpa, "src/chapters/cube_thing.obj");
+        var monkey_mesh = try Mesh.initFromObj(gpa, "src/chapters/monkey_flat.obj");
+        var cube_thing_mesh = try Mesh.initFromObj(gpa, "src/chapters/cube_thing.obj");
 
         try uploadMesh(self.gc, &tri_mesh);
         try uploadMesh(self.gc, &monkey_mesh);
@@ -555,7 +575,8 @@ pub const EngineChap4 = struct {
         const framed = self.frame_num / 12;
         self.scene_params.ambient_color = Vec4.new((std.math.sin(framed) + 1) * 0.5, 1, (std.math.cos(framed) + 1) * 0.5, 1);
 
-        const frame_index = @floatToInt(usize, self.frame_num) % FRAME_OVERLAP;
+        // the slot whose fence was waited on, frame_num keeps counting when the swapchain is recreated
+        const frame_index = self.swapchain.frameSlot();
         const data_offset = padUniformBufferSize(self.gpu_props, @sizeOf(GpuSceneData)) * frame_index;
         const scene_data_ptr = (try self.gc.allocator.mapMemoryAtOffset(GpuSceneData, self.scene_param_buffer.allocation, data_offset));
         scene_data_ptr.* = self.scene_params;
@@ -565,7 +586,7 @@ pub const EngineChap4 = struct {
         const object_data_ptr = try self.gc.allocator.mapMemory(GpuObjectData, frame.object_buffer.allocation);
         for (self.renderables.items) |*object, i| {
             var rot = Mat4.createAngleAxis(.{ .y = 1 }, toRadians(25.0) * self.frame_num * 0.04 + @intToFloat(f32, i));
-            object_data_ptr[i].model = object.transform_matrix.mul(rot);
+            object_data_ptr[i] = .{ .model = object.transform_matrix.mul(rot) };
         }
         self.gc.allocator.unmapMemory(frame.object_buffer.allocation);
 
@@ -788,7 +809,7 @@ fn createPipeline(
 
     try builder.addShaderStage(createShaderStageCreateInfo(vert, .{ .vertex_bit = true }));
     try builder.addShaderStage(createShaderStageCreateInfo(frag, .{ .fragment_bit = true }));
-    return try builder.build(gc, render_pass);
+    return try builder.build(gc, render_pass, .null_handle);
 }
 
 fn padUniformBufferSize(gpu_props: vk.PhysicalDeviceProperties, size: usize) usize {
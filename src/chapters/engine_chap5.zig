@@ -10,7 +10,37 @@ const vkinit = @import("../vkinit.zig");
 
 const GraphicsContext = @import("../graphics_context.zig").GraphicsContext;
 const Swapchain = @import("../swapchain.zig").Swapchain;
+const HeadlessTarget = @import("../headless.zig").HeadlessTarget;
 const PipelineBuilder = @import("../pipeline_builder.zig").PipelineBuilder;
+const Specialization = @import("../pipeline_builder.zig").Specialization;
+const PipelineCache = @import("../pipeline_cache.zig").PipelineCache;
+const PipelineCompiler = @import("../pipeline_compiler.zig").PipelineCompiler;
+const DescriptorAllocator = @import("../descriptors.zig").DescriptorAllocator;
+const PipelineLayoutCache = @import("../descriptors.zig").PipelineLayoutCache;
+const BindlessTextures = @import("../bindless.zig").BindlessTextures;
+const spirv_reflect = @import("../spirv_reflect.zig");
+const ShaderLibrary = @import("../shader_library.zig").ShaderLibrary;
+const Defragmenter = @import("../defragmenter.zig").Defragmenter;
+const Movable = @import("../defragmenter.zig").Movable;
+const GeometryArena = @import("../geometry_arena.zig").GeometryArena;
+const RenderQueue = @import("../render_queue.zig").RenderQueue;
+const GpuDriven = @import("../gpu_driven.zig").GpuDriven;
+const CullObject = @import("../gpu_driven.zig").CullObject;
+const DrawGroup = @import("../gpu_driven.zig").DrawGroup;
+const DrawPushConstants = @import("../gpu_driven.zig").DrawPushConstants;
+const CommandBuffer = @import("../vk_objs/command_buffer.zig").CommandBuffer;
+const RenderGraph = @import("../render_graph.zig").RenderGraph;
+const JobPool = @import("../job_pool.zig").JobPool;
+const SecondaryCommands = @import("../secondary_commands.zig").SecondaryCommands;
+const FramePacing = @import("../frame_pacing.zig").FramePacing;
+const GpuProfiler = @import("../gpu_profiler.zig").GpuProfiler;
+const cpu_profiler = @import("../cpu_profiler.zig");
+const Frustum = @import("../frustum.zig").Frustum;
+const Sphere = @import("../frustum.zig").Sphere;
+const SphereList = @import("../frustum.zig").SphereList;
+const TransformList = @import("../transforms.zig").TransformList;
+const TransformMatrix = @import("../transforms.zig").Matrix;
+const computeWorldMatricesParallel = @import("../transforms.zig").computeWorldMatricesParallel;
 const Mesh = @import("../mesh.zig").Mesh;
 const Vertex = @import("../mesh.zig").Vertex;
 const Allocator = std.mem.Allocator;
@@ -18,7 +48,13 @@ const Mat4 = @import("mat4.zig").Mat4;
 const Vec3 = @import("vec3.zig").Vec3;
 const Vec4 = @import("vec4.zig").Vec4;
 
-const FRAME_OVERLAP: usize = 2;
+const max_frames_in_flight = 4;
+/// threads building pipelines in the background
+const max_compile_threads = 4;
+/// every material draws with this vertex shader
+const mesh_vert_shader = "tri_mesh_descriptors_vert";
+/// specialization constant ids of lit.frag
+const lit_fog_constant = 0;
 
 fn toRadians(deg: anytype) @TypeOf(deg) {
     return std.math.pi * deg / 180.0;
@@ -43,7 +79,8 @@ pub const Texture = struct {
 };
 
 const FlyCamera = struct {
-    window: glfw.Window,
+    /// null when running headless, the camera then stays where it is
+    window: ?glfw.Window,
     speed: f32 = 3.5,
     pos: Vec3 = Vec3.new(2, 0.5, 20),
     front: Vec3 = Vec3.new(0, 0, -1),
@@ -53,14 +90,15 @@ const FlyCamera = struct {
     last_mouse_x: f32 = 400,
     last_mouse_y: f32 = 300,
 
-    pub fn init(window: glfw.Window) FlyCamera {
+    pub fn init(window: ?glfw.Window) FlyCamera {
         return .{
             .window = window,
         };
     }
 
     pub fn update(self: *FlyCamera, dt: f64) void {
-        var cursor_pos = self.window.getCursorPos() catch unreachable;
+        const window = self.window orelse return;
+        var cursor_pos = window.getCursorPos() catch unreachable;
         var x_offset = @floatCast(f32, cursor_pos.xpos) - self.last_mouse_x;
         var y_offset = self.last_mouse_y - @floatCast(f32, cursor_pos.ypos); // reversed since y-coordinates range from bottom to top
         self.last_mouse_x = @floatCast(f32, cursor_pos.xpos);
@@ -83,19 +121,19 @@ const FlyCamera = struct {
         // wasd
         var spd = self.speed * @floatCast(f32, dt);
 
-        if (self.window.getKey(.w) == .press) {
+        if (window.getKey(.w) == .press) {
             self.pos = self.pos.add(self.front.scale(spd));
-        } else if (self.window.getKey(.s) == .press) {
+        } else if (window.getKey(.s) == .press) {
             self.pos = self.pos.sub(self.front.scale(spd));
         }
-        if (self.window.getKey(.a) == .press) {
+        if (window.getKey(.a) == .press) {
             self.pos = self.pos.sub(Vec3.normalize(self.front.cross(self.up)).scale(spd));
-        } else if (self.window.getKey(.d) == .press) {
+        } else if (window.getKey(.d) == .press) {
             self.pos = self.pos.add(Vec3.normalize(self.front.cross(self.up)).scale(spd));
         }
-        if (self.window.getKey(.e) == .press) {
+        if (window.getKey(.e) == .press) {
             self.pos.y += spd;
-        } else if (self.window.getKey(.q) == .press) {
+        } else if (window.getKey(.q) == .press) {
             self.pos.y -= spd;
         }
     }
@@ -112,26 +150,42 @@ const GpuCameraData = struct {
 };
 
 const GpuSceneData = struct {
-    fog_color: Vec4 = Vec4.new(1, 0, 0, 1),
-    fog_distance: Vec4 = Vec4.new(1, 0, 0, 1),
+    fog_color: Vec4 = Vec4.new(0.5, 0.6, 0.7, 1),
+    /// view depth where fog starts and where it is opaque, only read by pipelines specialized with fog
+    fog_distance: Vec4 = Vec4.new(20, 90, 0, 0),
     ambient_color: Vec4 = Vec4.new(1, 0, 0, 1),
     sun_dir: Vec4 = Vec4.new(1, 0, 0, 1),
     sun_color: Vec4 = Vec4.new(1, 0, 0, 1),
 };
 
-const GpuObjectData = struct {
-    model: Mat4,
+/// matches ObjectData in tri_mesh_descriptors.vert and cull.comp, including the padding std140 adds to the array stride
+const GpuObjectData = extern struct {
+    model: TransformMatrix,
+    /// slot in the bindless texture array, 0 for none
+    texture_index: u32 = 0,
+    pad: [3]u32 = .{ 0, 0, 0 },
 };
 
+/// everything one frame in flight owns. Frames form a ring indexed by `Swapchain.frameSlot`, a slot is only reused after
+/// its fence signalled that the GPU finished with it.
 const FrameData = struct {
     cmd_pool: vk.CommandPool,
     cmd_buffer: vk.CommandBuffer,
+    render_fence: vk.Fence,
+    /// dynamic offset of this frames GpuSceneData in the shared scene buffer
+    scene_offset: u32,
     camera_buffer: vma.AllocatedBuffer,
     global_descriptor: vk.DescriptorSet,
     object_buffer: vma.AllocatedBuffer,
+    /// GpuObjectData entries `object_buffer` has room for, see `ensureObjectCapacity`
+    object_capacity: usize,
     object_descriptor: vk.DescriptorSet,
+    secondary: SecondaryCommands,
 
-    pub fn init(gc: *GraphicsContext, descriptor_set_layout: vk.DescriptorSetLayout, descriptor_pool: vk.DescriptorPool, scene_param_buffer: vma.AllocatedBuffer, object_set_layout: vk.DescriptorSetLayout) !FrameData {
+    /// enough for small scenes, larger ones grow the buffer once the scene is known
+    const initial_object_capacity: usize = 10_000;
+
+    pub fn init(gc: *GraphicsContext, slot: usize, descriptor_set_layout: vk.DescriptorSetLayout, descriptors: *DescriptorAllocator, scene_param_buffer: vma.AllocatedBuffer, object_set_layout: vk.DescriptorSetLayout, frame_pool: vma.Pool, worker_count: usize) !FrameData {
         const cmd_pool = try gc.vkd.createCommandPool(gc.dev, &.{
             .flags = .{ .reset_command_buffer_bit = true },
             .queue_family_index = gc.graphics_queue.family,
@@ -144,26 +198,18 @@ const FrameData = struct {
             .command_buffer_count = 1,
         }, @ptrCast([*]vk.CommandBuffer, &cmd_buffer));
 
+        // signalled so the first wait on a fresh slot returns immediately
+        const render_fence = try gc.vkd.createFence(gc.dev, &.{ .flags = .{ .signaled_bit = true } }, null);
+
         // descriptor set setup
-        var camera_buffer = try createBuffer(gc, @sizeOf(GpuCameraData), .{ .uniform_buffer_bit = true }, .cpu_to_gpu);
+        var camera_buffer = try createPoolBuffer(gc, @sizeOf(GpuCameraData), .{ .uniform_buffer_bit = true }, frame_pool);
 
-        const max_objects: usize = 10_000;
-        var object_buffer = try createBuffer(gc, @sizeOf(GpuObjectData) * max_objects, .{ .storage_buffer_bit = true }, .cpu_to_gpu);
+        var object_buffer = try createPoolBuffer(gc, @sizeOf(GpuObjectData) * initial_object_capacity, .{ .storage_buffer_bit = true }, frame_pool);
 
-        var global_descriptor: vk.DescriptorSet = undefined;
-        try gc.vkd.allocateDescriptorSets(gc.dev, &.{
-            .descriptor_pool = descriptor_pool,
-            .descriptor_set_count = 1,
-            .p_set_layouts = @ptrCast([*]const vk.DescriptorSetLayout, &descriptor_set_layout),
-        }, @ptrCast([*]vk.DescriptorSet, &global_descriptor));
+        const global_descriptor = try descriptors.allocate(descriptor_set_layout);
 
         // allocate the descriptor set that will point to object buffer
-        var object_descriptor: vk.DescriptorSet = undefined;
-        try gc.vkd.allocateDescriptorSets(gc.dev, &.{
-            .descriptor_pool = descriptor_pool,
-            .descriptor_set_count = 1,
-            .p_set_layouts = @ptrCast([*]const vk.DescriptorSetLayout, &object_set_layout),
-        }, @ptrCast([*]vk.DescriptorSet, &object_descriptor));
+        const object_descriptor = try descriptors.allocate(object_set_layout);
 
         // information about the buffer we want to point at in the descriptor
         const cam_info = vk.DescriptorBufferInfo{
@@ -181,7 +227,7 @@ const FrameData = struct {
         const object_buffer_info = vk.DescriptorBufferInfo{
             .buffer = object_buffer.buffer,
             .offset = 0,
-            .range = @sizeOf(GpuObjectData) * max_objects,
+            .range = @sizeOf(GpuObjectData) * initial_object_capacity,
         };
 
         const camera_write = vkinit.writeDescriptorBuffer(.uniform_buffer, global_descriptor, &cam_info, 0);
@@ -194,39 +240,100 @@ const FrameData = struct {
         return FrameData{
             .cmd_pool = cmd_pool,
             .cmd_buffer = cmd_buffer,
+            .render_fence = render_fence,
+            .scene_offset = @intCast(u32, padUniformBufferSize(gc, @sizeOf(GpuSceneData)) * slot),
             .camera_buffer = camera_buffer,
             .global_descriptor = global_descriptor,
             .object_buffer = object_buffer,
+            .object_capacity = initial_object_capacity,
             .object_descriptor = object_descriptor,
+            // one chunk per worker plus the imgui overlay, which worker 0 records
+            .secondary = try SecondaryCommands.init(gc, gpa, worker_count, worker_count + 1),
         };
     }
 
     pub fn deinit(self: *FrameData, gc: *GraphicsContext) void {
         gc.vkd.freeCommandBuffers(gc.dev, self.cmd_pool, 1, @ptrCast([*]vk.CommandBuffer, &self.cmd_buffer));
         gc.destroy(self.cmd_pool);
+        gc.destroy(self.render_fence);
         self.camera_buffer.deinit(gc.allocator);
         self.object_buffer.deinit(gc.allocator);
+        self.secondary.deinit(gc);
     }
-};
 
-const Material = struct {
-    texture_set: ?vk.DescriptorSet = null,
-    pipeline: vk.Pipeline,
-    pipeline_layout: vk.PipelineLayout,
+    /// replaces the object buffer with one that holds `count` objects if it is too small. The GPU must be done with this
+    /// frame. Grown buffers come from the default pools since the linear frame pool has no room for large scenes.
+    pub fn ensureObjectCapacity(self: *FrameData, gc: *GraphicsContext, count: usize) !void {
+        if (count <= self.object_capacity) return;
 
-    pub fn init(pipeline: vk.Pipeline, pipeline_layout: vk.PipelineLayout) Material {
-        return .{
-            .pipeline = pipeline,
-            .pipeline_layout = pipeline_layout,
+        const object_buffer = try createBuffer(gc, @sizeOf(GpuObjectData) * count, .{ .storage_buffer_bit = true }, .auto_prefer_device);
+        const object_buffer_info = vk.DescriptorBufferInfo{
+            .buffer = object_buffer.buffer,
+            .offset = 0,
+            .range = @sizeOf(GpuObjectData) * count,
         };
+        const object_write = vkinit.writeDescriptorBuffer(.storage_buffer, self.object_descriptor, &object_buffer_info, 0);
+        gc.vkd.updateDescriptorSets(gc.dev, 1, @ptrCast([*]const vk.WriteDescriptorSet, &object_write), 0, undefined);
+
+        self.object_buffer.deinit(gc.allocator);
+        self.object_buffer = object_buffer;
+        self.object_capacity = count;
     }
 
-    pub fn deinit(self: Material, gc: *const GraphicsContext) void {
-        gc.destroy(self.pipeline);
-        gc.destroy(self.pipeline_layout);
+    /// blocks until the GPU finished the last submission that used this frame
+    pub fn waitForFence(self: FrameData, gc: *const GraphicsContext) !void {
+        _ = try gc.vkd.waitForFences(gc.dev, 1, @ptrCast([*]const vk.Fence, &self.render_fence), vk.TRUE, std.math.maxInt(u64));
     }
 };
 
+/// everything `createPipeline` needs to build a mesh pipeline, the SPIR-V has to stay alive until the build finished
+const MeshPipelineDesc = struct {
+    render_pass: vk.RenderPass,
+    layout: vk.PipelineLayout,
+    vert: []const u8,
+    frag: []const u8,
+    frag_specialization: Specialization = .{},
+
+    /// equal for descs that build the same pipeline, shaders are hashed by content so reloaded code hashes differently
+    fn hash(self: MeshPipelineDesc) u64 {
+        var hasher = std.hash.Wyhash.init(0);
+        std.hash.autoHash(&hasher, self.render_pass);
+        std.hash.autoHash(&hasher, self.layout);
+        hasher.update(self.vert);
+        hasher.update(self.frag);
+        self.frag_specialization.hash(&hasher);
+        return hasher.final();
+    }
+};
+
+const MeshPipelines = PipelineCompiler(MeshPipelineDesc, createPipeline);
+
+const RetiredPipeline = struct {
+    handle: MeshPipelines.Handle,
+    /// frame index it was retired in
+    frame: usize,
+};
+
+const Material = struct {
+    texture_set: ?vk.DescriptorSet = null,
+    texture: ?*Texture = null,
+    /// owned by the MeshPipelines that built it. The fallback pipeline until `pending` finished building.
+    pipeline: vk.Pipeline,
+    pipeline_layout: vk.PipelineLayout,
+    /// name of the fragment shader in the ShaderLibrary, the pipeline is rebuilt when it is reloaded
+    shader: []const u8,
+    /// constants the fragment shader is specialized with
+    specialization: Specialization = .{},
+    /// the build of this materials own pipeline, if it is still in flight
+    pending: ?MeshPipelines.Handle = null,
+    /// the build `pipeline` came from, null while drawing with the fallback
+    built: ?MeshPipelines.Handle = null,
+    /// slot of `texture` in the BindlessTextures, written into the object data of everything using the material
+    texture_index: u32 = 0,
+    /// pushed before the materials draws
+    push_constants: DrawPushConstants = .{},
+};
+
 const RenderObject = struct {
     mesh: *Mesh,
     material: *Material,
@@ -273,6 +380,9 @@ const UploadContext = struct {
     }
 
     pub fn immediateSubmitEnd(self: UploadContext, gc: *const GraphicsContext) !void {
+        const zone = cpu_profiler.begin("immediate submit");
+        defer zone.end();
+
         try gc.vkd.endCommandBuffer(self.cmd_buf);
 
         // submit command buffer to the queue and execute it
@@ -286,26 +396,272 @@ const UploadContext = struct {
     }
 };
 
+/// dedicated VMA pools per resource class. Keeps long lived meshes and textures out of each others blocks and makes the
+/// memory cost of each class show up separately in the stats.
+const MemoryPools = struct {
+    /// the GeometryArena vertex and index buffers, sized so both share one block
+    mesh: vma.Pool,
+    /// per-frame uniform and storage buffers. Allocated once at startup and never freed individually so a linear pool fits.
+    /// Lives in device local + host visible memory when available, see `findFrameMemoryType`.
+    frame: vma.Pool,
+    /// sampled textures
+    texture: vma.Pool,
+
+    pub fn init(gc: *const GraphicsContext) !MemoryPools {
+        const mesh_type = try gc.allocator.findMemoryTypeIndexForBufferInfo(&std.mem.zeroInit(vk.BufferCreateInfo, .{
+            .size = 0x10000,
+            .usage = GeometryArena.vertex_usage,
+        }), &std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{ .usage = .gpu_only }));
+
+        const mesh = try gc.allocator.createPool("mesh", &std.mem.zeroInit(vma.VmaPoolCreateInfo, .{
+            .memoryTypeIndex = mesh_type,
+            .blockSize = 64 * 1024 * 1024,
+        }));
+        errdefer mesh.deinit(gc.allocator);
+
+        const frame_block_size: vk.DeviceSize = 8 * 1024 * 1024;
+        const frame = try gc.allocator.createPool("frame", &std.mem.zeroInit(vma.VmaPoolCreateInfo, .{
+            .memoryTypeIndex = try findFrameMemoryType(gc, frame_block_size),
+            .flags = .{ .linear_algorithm = true },
+            .blockSize = frame_block_size,
+            .maxBlockCount = 1,
+        }));
+        errdefer frame.deinit(gc.allocator);
+
+        const texture_info = vkinit.imageCreateInfo(.r8g8b8a8_srgb, .{ .width = 64, .height = 64, .depth = 1 }, texture_image_usage);
+        const texture_type = try gc.allocator.findMemoryTypeIndexForImageInfo(&texture_info, &std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{ .usage = .gpu_only }));
+
+        // VMA 3 dropped the buddy algorithm, its default TLSF allocator handles power-of-two texture sizes just as well
+        const texture = try gc.allocator.createPool("texture", &std.mem.zeroInit(vma.VmaPoolCreateInfo, .{
+            .memoryTypeIndex = texture_type,
+            .blockSize = 64 * 1024 * 1024,
+        }));
+
+        return MemoryPools{ .mesh = mesh, .frame = frame, .texture = texture };
+    }
+
+    /// The object SSBO is read by every vertex so the per-frame buffers should live in VRAM. Device local + host visible
+    /// memory (resizable BAR or the 256MB BAR window) lets the CPU write there directly. It is only used when the heap
+    /// has room to spare, a nearly full BAR heap is left to the driver and the frame data goes to host memory instead.
+    fn findFrameMemoryType(gc: *const GraphicsContext, block_size: vk.DeviceSize) !u32 {
+        const buffer_info = std.mem.zeroInit(vk.BufferCreateInfo, .{
+            .size = 0x10000,
+            .usage = vk.BufferUsageFlags{ .uniform_buffer_bit = true, .storage_buffer_bit = true },
+        });
+
+        const device_type = gc.allocator.findMemoryTypeIndexForBufferInfo(&buffer_info, &std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{
+            .flags = .{ .host_access_sequential_write = true },
+            .usage = .auto_prefer_device,
+            .requiredFlags = .{ .device_local_bit = true, .host_visible_bit = true, .host_coherent_bit = true },
+        })) catch null;
+
+        if (device_type) |type_index| {
+            const heap_index = gc.allocator.getMemoryProperties().memory_types[type_index].heap_index;
+            var budget_storage: [vk.MAX_MEMORY_HEAPS]vma.VmaBudget = undefined;
+            const budget = gc.allocator.getHeapBudgets(&budget_storage)[heap_index];
+
+            if (budget.budget > budget.usage and budget.budget - budget.usage >= block_size * 4) {
+                std.debug.print("per-frame buffers: device local + host visible memory type {d}, heap {d} ({d} MB budget)\n", .{ type_index, heap_index, budget.budget / (1024 * 1024) });
+                return type_index;
+            }
+            std.debug.print("per-frame buffers: device local + host visible heap {d} is too small, falling back to host memory\n", .{heap_index});
+        } else {
+            std.debug.print("per-frame buffers: no device local + host visible memory, falling back to host memory\n", .{});
+        }
+
+        return try gc.allocator.findMemoryTypeIndexForBufferInfo(&buffer_info, &std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{
+            .flags = .{ .host_access_sequential_write = true },
+            .usage = .auto_prefer_host,
+            .requiredFlags = .{ .host_visible_bit = true, .host_coherent_bit = true },
+        }));
+    }
+
+    /// every resource allocated from the pools must be freed first
+    pub fn deinit(self: MemoryPools, gc: *const GraphicsContext) void {
+        self.mesh.deinit(gc.allocator);
+        self.frame.deinit(gc.allocator);
+        self.texture.deinit(gc.allocator);
+    }
+
+    pub fn all(self: MemoryPools) [3]vma.Pool {
+        return .{ self.mesh, self.frame, self.texture };
+    }
+};
+
 var general_purpose_allocator = std.heap.GeneralPurposeAllocator(.{ .thread_safe = false }){};
 const gpa = general_purpose_allocator.allocator();
 
 const depth_format = vk.Format.d32_sfloat;
 
+// 44MB of vertices and 12MB of indices, both fit into a single block of the mesh pool
+const max_geometry_vertices: u32 = 1_000_000;
+const max_geometry_indices: u32 = 3_000_000;
+// draw recording is split into at most this many chunks, one per core
+const max_record_threads = 8;
+
+// far plane, also the distance the render queue normalizes depth against
+const draw_distance: f32 = 200;
+
+// transfer_src so the Defragmenter can copy textures to their new location
+const texture_image_usage = vk.ImageUsageFlags{ .sampled_bit = true, .transfer_dst_bit = true, .transfer_src_bit = true };
+
 pub const EngineChap5 = struct {
     const Self = @This();
 
+    pub const Options = struct {
+        /// when set the VMA JSON stats dump is written to this path on shutdown
+        vma_stats_path: ?[]const u8 = null,
+        /// CPU profiler zones are written here as a Chrome trace on shutdown and by the profiler window's save button.
+        /// Only recorded when built with -Dcpu_profiler=true.
+        trace_path: []const u8 = "cpu_trace.json",
+        save_trace_on_exit: bool = false,
+        /// driver pipeline cache loaded at startup and saved on shutdown, null disables persisting it
+        pipeline_cache_path: ?[]const u8 = "pipeline_cache.bin",
+        /// cull on the GPU and draw with indirect commands instead of building draws on the CPU every frame
+        gpu_driven: bool = false,
+        /// record draws into secondary command buffers from all cores
+        parallel_recording: bool = false,
+        /// how many frames the CPU may record ahead of the GPU, 1 to `max_frames_in_flight`. More trades latency for throughput.
+        frames_in_flight: usize = 2,
+        /// waits for the GPU to drain before sampling input so a frame shows the freshest input, see `run`
+        low_latency: bool = false,
+        /// falls back to fifo when the surface does not support it
+        present_mode: vk.PresentModeKHR = .fifo_khr,
+        /// one texture array indexed per object instead of a descriptor set per material, needs descriptor indexing
+        bindless: bool = false,
+        /// renders this many frames offscreen without a window or surface and exits, see `runHeadless`
+        headless_frames: ?u32 = null,
+        headless_extent: vk.Extent2D = .{ .width = 800, .height = 600 },
+        /// when headless the last frame is read back and written here as a PPM
+        capture_path: ?[]const u8 = null,
+
+        pub fn parse(args: []const [:0]const u8) Options {
+            var options = Options{};
+
+            var i: usize = 1;
+            while (i < args.len) : (i += 1) {
+                const arg = args[i];
+                if (std.mem.eql(u8, arg, "--vma-stats") and i + 1 < args.len) {
+                    i += 1;
+                    options.vma_stats_path = args[i];
+                } else if (std.mem.eql(u8, arg, "--trace") and i + 1 < args.len) {
+                    i += 1;
+                    options.trace_path = args[i];
+                    options.save_trace_on_exit = true;
+                } else if (std.mem.eql(u8, arg, "--pipeline-cache") and i + 1 < args.len) {
+                    i += 1;
+                    options.pipeline_cache_path = args[i];
+                } else if (std.mem.eql(u8, arg, "--no-pipeline-cache")) {
+                    options.pipeline_cache_path = null;
+                } else if (std.mem.eql(u8, arg, "--gpu-driven")) {
+                    options.gpu_driven = true;
+                } else if (std.mem.eql(u8, arg, "--parallel-recording")) {
+                    options.parallel_recording = true;
+                } else if (std.mem.eql(u8, arg, "--frames-in-flight") and i + 1 < args.len) {
+                    i += 1;
+                    const count = std.fmt.parseInt(usize, args[i], 10) catch 0;
+                    if (count < 1 or count > max_frames_in_flight) {
+                        std.debug.print("--frames-in-flight must be between 1 and {d}, got {s}\n", .{ max_frames_in_flight, args[i] });
+                    } else {
+                        options.frames_in_flight = count;
+                    }
+                } else if (std.mem.eql(u8, arg, "--bindless")) {
+                    options.bindless = true;
+                } else if (std.mem.eql(u8, arg, "--headless") and i + 1 < args.len) {
+                    i += 1;
+                    options.headless_frames = std.fmt.parseInt(u32, args[i], 10) catch blk: {
+                        std.debug.print("--headless expects a frame count, got {s}\n", .{args[i]});
+                        break :blk null;
+                    };
+                } else if (std.mem.eql(u8, arg, "--headless-size") and i + 1 < args.len) {
+                    i += 1;
+                    options.headless_extent = parseExtent(args[i]) orelse blk: {
+                        std.debug.print("--headless-size expects WIDTHxHEIGHT, got {s}\n", .{args[i]});
+                        break :blk options.headless_extent;
+                    };
+                } else if (std.mem.eql(u8, arg, "--capture") and i + 1 < args.len) {
+                    i += 1;
+                    options.capture_path = args[i];
+                } else if (std.mem.eql(u8, arg, "--low-latency")) {
+                    options.low_latency = true;
+                } else if (std.mem.eql(u8, arg, "--present-mode") and i + 1 < args.len) {
+                    i += 1;
+                    if (std.mem.eql(u8, args[i], "fifo")) {
+                        options.present_mode = .fifo_khr;
+                    } else if (std.mem.eql(u8, args[i], "mailbox")) {
+                        options.present_mode = .mailbox_khr;
+                    } else if (std.mem.eql(u8, args[i], "immediate")) {
+                        options.present_mode = .immediate_khr;
+                    } else {
+                        std.debug.print("--present-mode must be fifo, mailbox or immediate, got {s}\n", .{args[i]});
+                    }
+                } else {
+                    std.debug.print("unknown argument: {s}\n", .{arg});
+                }
+            }
+
+            if (options.capture_path != null and options.headless_frames == null) {
+                std.debug.print("--capture only applies with --headless\n", .{});
+            }
+
+            return options;
+        }
+
+        fn parseExtent(arg: []const u8) ?vk.Extent2D {
+            var it = std.mem.split(u8, arg, "x");
+            const width = std.fmt.parseInt(u32, it.next() orelse return null, 10) catch return null;
+            const height = std.fmt.parseInt(u32, it.next() orelse return null, 10) catch return null;
+            if (width == 0 or height == 0) return null;
+            return vk.Extent2D{ .width = width, .height = height };
+        }
+    };
+
     allocator: Allocator,
-    window: glfw.Window,
+    options: Options,
+    /// null when running headless, as is `swapchain`
+    window: ?glfw.Window,
     gc: *GraphicsContext,
-    swapchain: Swapchain,
+    swapchain: ?Swapchain,
+    /// frames are rendered into this instead of the swapchain when running headless
+    headless: ?HeadlessTarget,
     render_pass: vk.RenderPass,
-    framebuffers: []vk.Framebuffer,
+    pipeline_cache: PipelineCache,
+    pipelines: *MeshPipelines,
+    /// every pipeline submitted to `pipelines` by MeshPipelineDesc.hash, materials asking for the same permutation share
+    /// its build
+    permutations: std.AutoHashMap(u64, MeshPipelines.Handle),
+    /// SPIR-V for every pipeline, reloaded from disk when built with shader hot reloading
+    shaders: ShaderLibrary,
+    /// drawn with until a materials own pipeline is ready. Only uses sets 0 and 1 so it fits every material layout.
+    fallback_pipeline: vk.Pipeline = undefined,
+    fallback_handle: MeshPipelines.Handle = undefined,
+    /// pipelines replaced by a reload, released once no frame in flight can still use them
+    retired_pipelines: std.ArrayListUnmanaged(RetiredPipeline) = .{},
+    /// set when running with `Options.bindless`
+    bindless: ?BindlessTextures,
+    /// rebuilt every frame, owns the depth buffer and the framebuffers
+    graph: RenderGraph,
     frames: []FrameData,
+    jobs: *JobPool,
+    pacing: FramePacing,
+    /// times the render graph passes
+    gpu_profiler: GpuProfiler,
+    /// scratch for the CPU profiler window
+    cpu_events: std.ArrayList(cpu_profiler.Event),
     frame_num: f32 = 0,
     dt: f64 = 0.0,
     last_frame_time: f64 = 0.0,
-    depth_image: Texture,
     renderables: std.ArrayList(RenderObject),
+    /// placement of each renderable, same order as `renderables`
+    transforms: TransformList = .{},
+    /// world bounds of each renderable, same order as `renderables`
+    cull_spheres: SphereList = .{},
+    /// object index of every instance slot in the object buffer this frame
+    draw_order: std.ArrayList(u32),
+    /// indices of the renderables that survived culling this frame
+    visible: std.ArrayList(u32),
+    render_queue: RenderQueue,
+    gpu_driven: GpuDriven,
     materials: std.StringHashMap(Material),
     meshes: std.StringHashMap(Mesh),
     textures: std.StringHashMap(Texture),
@@ -313,51 +669,93 @@ pub const EngineChap5 = struct {
     global_set_layout: vk.DescriptorSetLayout,
     object_set_layout: vk.DescriptorSetLayout,
     single_tex_layout: vk.DescriptorSetLayout,
-    descriptor_pool: vk.DescriptorPool,
+    /// owns the set layouts above and every pipeline layout, materials with the same shader interface share one
+    layout_cache: PipelineLayoutCache,
+    /// sets that live as long as the engine. Sets replaced after a defragmentation move are left in their pool.
+    descriptors: DescriptorAllocator,
     imgui_pool: vk.DescriptorPool = undefined,
     scene_params: GpuSceneData,
     scene_param_buffer: vma.AllocatedBuffer,
     upload_context: UploadContext,
+    pools: MemoryPools,
+    geometry: GeometryArena,
     blocky_sampler: vk.Sampler = undefined,
-
-    pub fn init(app_name: [*:0]const u8) !Self {
-        try glfw.init(.{});
-
-        var extent = vk.Extent2D{ .width = 800, .height = 600 };
-        const window = try glfw.Window.create(extent.width, extent.height, app_name, null, null, .{
-            .client_api = .no_api,
-        });
-        glfw.c.glfwWindowHint(glfw.c.GLFW_CLIENT_API, glfw.c.GLFW_NO_API);
+    defragmenter: Defragmenter,
+
+    pub fn init(app_name: [*:0]const u8, options: Options) !Self {
+        cpu_profiler.init();
+        const headless = options.headless_frames != null;
+
+        // glfw is left alone entirely when headless, it fails to initialize on machines without a display
+        var extent = if (headless) options.headless_extent else vk.Extent2D{ .width = 800, .height = 600 };
+        var window: ?glfw.Window = null;
+        if (!headless) {
+            try glfw.init(.{});
+            window = try glfw.Window.create(extent.width, extent.height, app_name, null, null, .{
+                .client_api = .no_api,
+            });
+            glfw.c.glfwWindowHint(glfw.c.GLFW_CLIENT_API, glfw.c.GLFW_NO_API);
+        }
 
         var gc = try gpa.create(GraphicsContext);
         gc.* = try GraphicsContext.init(gpa, app_name, window);
 
+        const pools = try MemoryPools.init(gc);
+        const pipeline_cache = try PipelineCache.init(gc, gpa, options.pipeline_cache_path);
+        const pipelines = try MeshPipelines.initForCpu(gc, gpa, pipeline_cache.handle, max_compile_threads);
+
         // swapchain
-        var swapchain = try Swapchain.init(gc, gpa, extent, FRAME_OVERLAP);
-        const render_pass = try createRenderPass(gc, swapchain);
+        // one image on screen plus one per frame in flight so acquiring never waits on the frame being recorded
+        const frames_in_flight = options.frames_in_flight;
+        var swapchain: ?Swapchain = null;
+        var headless_target: ?HeadlessTarget = null;
+        if (headless) {
+            headless_target = try HeadlessTarget.init(gc, gpa, extent, frames_in_flight);
+        } else {
+            swapchain = try Swapchain.init(gc, gpa, extent, @intCast(u32, frames_in_flight + 1), frames_in_flight, options.present_mode);
+        }
+        const color_format = if (swapchain) |sc| sc.surface_format.format else HeadlessTarget.format;
 
-        // depth image
-        const depth_image = try createDepthImage(gc, swapchain);
-        const framebuffers = try createFramebuffers(gc, gpa, render_pass, swapchain, depth_image.view);
+        // pipelines, imgui and secondary command buffers are built against this pass, the graphs render passes are
+        // compatible with it
+        const render_pass = try createRenderPass(gc, color_format);
 
         // descriptors
-        const descriptors = createDescriptors(gc);
+        var layout_cache = PipelineLayoutCache.init(gc, gpa);
+        var descriptor_allocator = DescriptorAllocator.init(gc, gpa);
+        const descriptors = try createDescriptors(gc, &layout_cache, pools.frame, frames_in_flight);
+
+        const jobs = try JobPool.initForCpu(gpa, max_record_threads - 1);
 
         // create our FrameDatas
-        const frames = try gpa.alloc(FrameData, swapchain.swap_images.len);
+        const frames = try gpa.alloc(FrameData, frames_in_flight);
         errdefer gpa.free(frames);
-        for (frames) |*f| f.* = try FrameData.init(gc, descriptors.layout, descriptors.pool, descriptors.scene_param_buffer, descriptors.object_set_layout);
+        for (frames) |*f, slot| f.* = try FrameData.init(gc, slot, descriptors.layout, &descriptor_allocator, descriptors.scene_param_buffer, descriptors.object_set_layout, pools.frame, jobs.workerCount());
 
         return Self{
             .allocator = gpa,
+            .options = options,
             .window = window,
             .gc = gc,
             .swapchain = swapchain,
+            .headless = headless_target,
             .render_pass = render_pass,
-            .framebuffers = framebuffers,
+            .pipeline_cache = pipeline_cache,
+            .pipelines = pipelines,
+            .permutations = std.AutoHashMap(u64, MeshPipelines.Handle).init(gpa),
+            .shaders = ShaderLibrary.init(gpa),
+            .bindless = if (options.bindless) initBindless(gc, gpa) else null,
+            .graph = RenderGraph.init(gc, gpa),
             .frames = frames,
-            .depth_image = depth_image,
+            .jobs = jobs,
+            .pacing = .{},
+            .gpu_profiler = try GpuProfiler.init(gc, gpa, frames_in_flight),
+            .cpu_events = std.ArrayList(cpu_profiler.Event).init(gpa),
             .renderables = std.ArrayList(RenderObject).init(gpa),
+            .visible = std.ArrayList(u32).init(gpa),
+            .draw_order = std.ArrayList(u32).init(gpa),
+            .render_queue = RenderQueue.init(gpa),
+            .gpu_driven = try GpuDriven.init(gc, gpa, frames.len, pipeline_cache.handle),
             .materials = std.StringHashMap(Material).init(gpa),
             .meshes = std.StringHashMap(Mesh).init(gpa),
             .textures = std.StringHashMap(Texture).init(gpa),
@@ -365,116 +763,250 @@ pub const EngineChap5 = struct {
             .global_set_layout = descriptors.layout,
             .object_set_layout = descriptors.object_set_layout,
             .single_tex_layout = descriptors.single_tex_layout,
-            .descriptor_pool = descriptors.pool,
+            .layout_cache = layout_cache,
+            .descriptors = descriptor_allocator,
             .scene_params = .{},
             .scene_param_buffer = descriptors.scene_param_buffer,
             .upload_context = try UploadContext.init(gc),
+            .pools = pools,
+            .geometry = try GeometryArena.init(gc, max_geometry_vertices, max_geometry_indices, pools.mesh),
+            .defragmenter = Defragmenter.init(gc, gpa),
         };
     }
 
     pub fn deinit(self: *Self) void {
         self.gc.vkd.deviceWaitIdle(self.gc.dev) catch unreachable;
 
-        igvk.shutdown();
-        ig.igDestroyContext(null);
-        self.gc.destroy(self.imgui_pool);
+        // dump before anything is freed so the JSON reflects the live scene
+        if (self.options.vma_stats_path) |path| {
+            self.gc.allocator.writeStatsToFile(path, true) catch |err| std.debug.print("failed writing VMA stats to {s}: {}\n", .{ path, err });
+        }
+        if (cpu_profiler.enabled and self.options.save_trace_on_exit) {
+            cpu_profiler.writeChromeTrace(self.allocator, self.options.trace_path) catch |err| std.debug.print("failed writing trace to {s}: {}\n", .{ self.options.trace_path, err });
+        }
+
+        self.defragmenter.deinit();
+
+        if (self.window != null) {
+            igvk.shutdown();
+            ig.igDestroyContext(null);
+            self.gc.destroy(self.imgui_pool);
+        }
 
         self.upload_context.deinit(self.gc);
 
         self.gc.destroy(self.blocky_sampler);
 
         self.scene_param_buffer.deinit(self.gc.allocator);
-        self.gc.destroy(self.object_set_layout);
-        self.gc.destroy(self.global_set_layout);
-        self.gc.destroy(self.single_tex_layout);
-        self.gc.destroy(self.descriptor_pool);
-
-        self.depth_image.deinit(self.gc);
+        self.descriptors.deinit();
 
         var iter = self.meshes.valueIterator();
-        while (iter.next()) |mesh| mesh.deinit(self.gc.allocator);
+        while (iter.next()) |mesh| mesh.deinit(&self.geometry);
         self.meshes.deinit();
+        self.geometry.deinit();
 
         var tex_iter = self.textures.valueIterator();
         while (tex_iter.next()) |tex| tex.deinit(self.gc);
         self.textures.deinit();
 
+        self.gpu_driven.deinit();
+
         for (self.frames) |*frame| frame.deinit(self.gc);
         self.allocator.free(self.frames);
+        self.jobs.deinit();
+        self.gpu_profiler.deinit();
+        self.cpu_events.deinit();
 
-        for (self.framebuffers) |fb| self.gc.destroy(fb);
-        self.allocator.free(self.framebuffers);
+        self.graph.deinit();
 
-        var mat_iter = self.materials.valueIterator();
-        while (mat_iter.next()) |mat| mat.deinit(self.gc);
         self.materials.deinit();
+        // before the cache is saved so it includes every pipeline that finished building
+        self.pipelines.deinit();
+        self.permutations.deinit();
+        self.retired_pipelines.deinit(self.allocator);
+        // after the compiler, builds still running use the layouts and shader code
+        self.layout_cache.deinit();
+        self.shaders.deinit();
+        if (self.bindless) |*bindless| bindless.deinit();
+
+        self.pools.deinit(self.gc);
 
         self.gc.destroy(self.render_pass);
+        self.pipeline_cache.deinit();
 
-        self.swapchain.deinit();
+        if (self.swapchain) |swapchain| swapchain.deinit();
+        if (self.headless) |target| target.deinit();
         self.gc.deinit();
         self.allocator.destroy(self.gc);
 
-        self.window.destroy();
-        glfw.terminate();
+        if (self.window) |window| {
+            window.destroy();
+            glfw.terminate();
+        }
 
         self.renderables.deinit();
+        self.transforms.deinit(self.allocator);
+        self.cull_spheres.deinit(self.allocator);
+        self.visible.deinit();
+        self.draw_order.deinit();
+        self.render_queue.deinit();
+        // the job pool is gone, no thread records zones anymore
+        cpu_profiler.deinit();
         _ = general_purpose_allocator.deinit();
         // _ = general_purpose_allocator.detectLeaks();
     }
 
     pub fn loadContent(self: *Self) !void {
-        try self.initImgui();
+        const zone = cpu_profiler.begin("load content");
+        defer zone.end();
+
+        self.defragmenter.listener = .{ .ctx = self, .func = onResourceMoved };
+        try self.defragmenter.addPool(self.pools.texture);
+
+        if (self.window != null) try self.initImgui();
         try self.loadImages();
         try self.loadMeshes();
         try self.initPipelines();
         try self.initScene();
     }
 
+    /// Normally input is sampled first and the CPU then blocks on the frame slot and the swapchain, so by the time the
+    /// frame reaches the GPU its input is up to `frames_in_flight` frames old. With `low_latency` the CPU first waits for
+    /// every submitted frame to finish and only then polls input, trading CPU/GPU overlap for a shorter input to photon time.
     pub fn run(self: *Self) !void {
-        while (!self.window.shouldClose()) {
-            var curr_frame_time = glfw.getTime();
-            self.dt = curr_frame_time - self.last_frame_time;
-            self.last_frame_time = curr_frame_time;
-
-            self.camera.update(self.dt);
-
-            igvk.newFrame();
-            ig.igNewFrame();
-            @import("autogui.zig").inspect(FlyCamera, &self.camera);
+        if (self.options.headless_frames) |frame_count| return self.runHeadless(frame_count);
+
+        const window = self.window.?;
+        const swapchain = &self.swapchain.?;
+        var wait_timer = try std.time.Timer.start();
+
+        while (!window.shouldClose()) {
+            const low_latency = self.options.low_latency;
+            if (!low_latency) try self.beginFrame();
+
+            wait_timer.reset();
+            const wait_zone = cpu_profiler.begin("wait");
+
+            // wait for the GPU to finish the last frame that used this slot before filling its CommandBuffer
+            const frame_slot = swapchain.frameSlot();
+            const frame = self.frames[frame_slot];
+            if (low_latency) {
+                for (self.frames) |f| try f.waitForFence(self.gc);
+            } else {
+                try frame.waitForFence(self.gc);
+            }
 
-            // wait for the last frame to complete before filling our CommandBuffer
-            const state = self.swapchain.waitForFrame() catch |err| switch (err) {
+            const state = swapchain.acquireNextImage() catch |err| switch (err) {
                 error.OutOfDateKHR => Swapchain.PresentState.suboptimal,
                 else => |narrow| return narrow,
             };
+            wait_zone.end();
+
+            self.pacing.addCpuWait(@intToFloat(f64, wait_timer.read()) / std.time.ns_per_s);
+            if (self.gpu_profiler.collect(frame_slot)) |gpu_ms| self.pacing.addGpuTime(gpu_ms);
 
-            const frame = self.frames[self.swapchain.frame_index % self.swapchain.swap_images.len];
-            try self.draw(self.framebuffers[self.swapchain.image_index], frame);
+            if (low_latency) try self.beginFrame();
 
-            try self.swapchain.present(frame.cmd_buffer);
+            // only reset once a submit that signals the fence is guaranteed to follow
+            try self.gc.vkd.resetFences(self.gc.dev, 1, @ptrCast([*]const vk.Fence, &frame.render_fence));
+            try self.draw(frame);
+
+            const present_zone = cpu_profiler.begin("present");
+            try swapchain.present(frame.cmd_buffer, frame.render_fence);
+            present_zone.end();
 
             // TODO: why does this have to be after present?
             if (state == .suboptimal) {
-                try self.swapchain.waitForAllFences();
+                for (self.frames) |f| try f.waitForFence(self.gc);
 
-                const size = try self.window.getSize();
+                const size = try window.getSize();
                 var extent = vk.Extent2D{ .width = size.width, .height = size.height };
-                try self.swapchain.recreate(extent);
-
-                for (self.framebuffers) |fb| self.gc.destroy(fb);
-                self.allocator.free(self.framebuffers);
+                try swapchain.recreate(extent);
 
-                self.depth_image.deinit(self.gc);
-                self.depth_image = try createDepthImage(self.gc, self.swapchain);
-                self.framebuffers = try createFramebuffers(self.gc, self.allocator, self.render_pass, self.swapchain, self.depth_image.view);
+                // the depth buffer follows the new extent on its own, the graph recreates transients when they change
+                self.graph.invalidateFramebuffers();
             }
 
             self.frame_num += 1;
-            try glfw.pollEvents();
+            cpu_profiler.frameMark();
         }
     }
 
+    /// Renders `frame_count` frames into the offscreen target as fast as the GPU allows and prints the average frame
+    /// time. Time advances by a fixed step and the camera stays put so every run renders the same frames, e.g. for
+    /// performance regression runs on a build machine with lavapipe (point VK_ICD_FILENAMES at its ICD json).
+    fn runHeadless(self: *Self, frame_count: u32) !void {
+        const target = &self.headless.?;
+        const fixed_dt = 1.0 / 60.0;
+        var timer = try std.time.Timer.start();
+
+        var i: u32 = 0;
+        while (i < frame_count) : (i += 1) {
+            const frame_slot = target.frameSlot();
+            const frame = self.frames[frame_slot];
+            const wait_zone = cpu_profiler.begin("wait");
+            try frame.waitForFence(self.gc);
+            wait_zone.end();
+            if (self.gpu_profiler.collect(frame_slot)) |gpu_ms| self.pacing.addGpuTime(gpu_ms);
+
+            self.dt = fixed_dt;
+            self.pacing.addFrame(self.dt);
+
+            try self.gc.vkd.resetFences(self.gc.dev, 1, @ptrCast([*]const vk.Fence, &frame.render_fence));
+            try self.draw(frame);
+            try target.submit(frame.cmd_buffer, frame.render_fence);
+
+            self.frame_num += 1;
+            cpu_profiler.frameMark();
+        }
+        for (self.frames) |f| try f.waitForFence(self.gc);
+
+        const elapsed_ms = @intToFloat(f64, timer.read()) / std.time.ns_per_ms;
+        std.debug.print("headless: {d} frames at {d}x{d} on {s}, {d:.3} ms per frame, gpu {d:.3} ms\n", .{
+            frame_count,
+            target.extent.width,
+            target.extent.height,
+            self.gc.deviceName(),
+            elapsed_ms / @intToFloat(f64, std.math.max(frame_count, 1)),
+            self.pacing.gpu_ms,
+        });
+        for (self.gpu_profiler.timings.items) |timing| {
+            std.debug.print("  {s}: {d:.3} ms avg, {d:.3} ms max\n", .{ timing.name, timing.average(), timing.max() });
+        }
+
+        if (self.options.capture_path) |path| {
+            if (frame_count == 0) return;
+            const last_slot = (target.frame_index - 1) % target.slots.len;
+            try target.writePpm(try target.readPixels(last_slot), path);
+        }
+    }
+
+    /// samples input and builds the UI for the frame about to be recorded
+    fn beginFrame(self: *Self) !void {
+        const input_zone = cpu_profiler.begin("input");
+        try glfw.pollEvents();
+
+        var curr_frame_time = glfw.getTime();
+        self.dt = curr_frame_time - self.last_frame_time;
+        self.last_frame_time = curr_frame_time;
+        self.pacing.addFrame(self.dt);
+
+        self.camera.update(self.dt);
+        input_zone.end();
+
+        const zone = cpu_profiler.begin("imgui");
+        defer zone.end();
+        igvk.newFrame();
+        ig.igNewFrame();
+        @import("autogui.zig").inspect(FlyCamera, &self.camera);
+        const pools = self.pools.all();
+        @import("memory_gui.zig").drawMemoryPanel(self.gc.allocator, &pools, &self.defragmenter);
+        self.drawRenderStats();
+        self.drawFramePacing();
+        @import("profiler_gui.zig").drawGpuProfiler(&self.gpu_profiler);
+        @import("profiler_gui.zig").drawCpuProfiler(&self.cpu_events, self.options.trace_path);
+    }
+
     fn initImgui(self: *Self) !void {
         // 1: create descriptor pool for IMGUI
         const sizes = [_]vk.DescriptorPoolSize{
@@ -545,7 +1077,7 @@ pub const EngineChap5 = struct {
             }
         }.load;
         _ = igvk.ImGui_ImplVulkan_LoadFunctions(closure, self.gc.instance);
-        _ = igvk.ImGui_ImplGlfw_InitForVulkan(self.window.handle, true);
+        _ = igvk.ImGui_ImplGlfw_InitForVulkan(self.window.?.handle, true);
 
         var info = std.mem.zeroInit(igvk.ImGui_ImplVulkan_InitInfo, .{
             .instance = self.gc.instance,
@@ -553,6 +1085,7 @@ pub const EngineChap5 = struct {
             .device = self.gc.dev,
             .queue_family = self.gc.graphics_queue.family,
             .queue = self.gc.graphics_queue.handle,
+            .pipeline_cache = self.pipeline_cache.handle,
             .descriptor_pool = self.imgui_pool,
             .subpass = 0,
             .min_image_count = 2,
@@ -573,31 +1106,42 @@ pub const EngineChap5 = struct {
     }
 
     fn loadImages(self: *Self) !void {
-        const lost_empire_img = try loadTextureFromFile(self.gc, self.allocator, "src/chapters/lost_empire-RGBA.png", self.upload_context);
-        const image_info = vkinit.imageViewCreateInfo(.r8g8b8a8_srgb, lost_empire_img.image, .{ .color_bit = true });
+        const zone = cpu_profiler.begin("load images");
+        defer zone.end();
+
+        const lost_empire_img = try loadTextureFromFile(self.gc, self.allocator, "src/chapters/lost_empire-RGBA.png", self.upload_context, self.pools.texture);
+        const image_info = vkinit.imageViewCreateInfo(.r8g8b8a8_srgb, lost_empire_img.image.image, .{ .color_bit = true });
         const lost_empire_tex = Texture{
-            .image = lost_empire_img,
+            .image = lost_empire_img.image,
             .view = try self.gc.vkd.createImageView(self.gc.dev, &image_info, null),
         };
         try self.textures.put("empire_diffuse", lost_empire_tex);
+
+        const tex = self.textures.getPtr("empire_diffuse").?;
+        try self.defragmenter.trackImage(&tex.image, &tex.view, lost_empire_img.info, .shader_read_only_optimal, .{ .color_bit = true });
     }
 
     fn loadMeshes(self: *Self) !void {
+        const zone = cpu_profiler.begin("load meshes");
+        defer zone.end();
+
         var tri_mesh = Mesh.init(gpa);
         try tri_mesh.vertices.append(.{ .position = .{ 1, 1, 0 }, .normal = .{ 0, 0, 0 }, .color = .{ 0.6, 0.6, 0.6 }, .uv = .{ 1, 0 } });
         try tri_mesh.vertices.append(.{ .position = .{ -1, 1, 0 }, .normal = .{ 0, 0, 0 }, .color = .{ 0.6, 0.6, 0.6 }, .uv = .{ 0, 0 } });
         try tri_mesh.vertices.append(.{ .position = .{ 0, -1, 0 }, .normal = .{ 0, 0, 0 }, .color = .{ 0.6, 0.6, 0.6 }, .uv = .{ 0.5, 1 } });
+        try tri_mesh.generateIndices();
+        tri_mesh.updateBounds();
 
         var monkey_mesh = try Mesh.initFromObj(gpa, "src/chapters/monkey_flat.obj");
         var cube_thing_mesh = try Mesh.initFromObj(gpa, "src/chapters/cube_thing.obj");
         var cube = try Mesh.initFromObj(gpa, "src/chapters/cube.obj");
         var lost_empire = try Mesh.initFromObj(gpa, "src/chapters/lost_empire.obj");
 
-        try uploadMesh(self.gc, &tri_mesh, self.upload_context);
-        try uploadMesh(self.gc, &monkey_mesh, self.upload_context);
-        try uploadMesh(self.gc, &cube_thing_mesh, self.upload_context);
-        try uploadMesh(self.gc, &cube, self.upload_context);
-        try uploadMesh(self.gc, &lost_empire, self.upload_context);
+        try uploadMesh(self.gc, &tri_mesh, self.upload_context, &self.geometry);
+        try uploadMesh(self.gc, &monkey_mesh, self.upload_context, &self.geometry);
+        try uploadMesh(self.gc, &cube_thing_mesh, self.upload_context, &self.geometry);
+        try uploadMesh(self.gc, &cube, self.upload_context, &self.geometry);
+        try uploadMesh(self.gc, &lost_empire, self.upload_context, &self.geometry);
 
         try self.meshes.put("triangle", tri_mesh);
         try self.meshes.put("monkey", monkey_mesh);
@@ -606,154 +1150,427 @@ pub const EngineChap5 = struct {
         try self.meshes.put("lost_empire", lost_empire);
     }
 
+    /// queues every material pipeline on the compiler and only waits for the fallback, materials draw with it until
+    /// `updatePipelines` swaps in their own
     fn initPipelines(self: *Self) !void {
-        // push-constant setup
-        var pip_layout_info = vkinit.pipelineLayoutCreateInfo();
-
-        // hook the global set layout and object set layout
-        const set_layouts = [_]vk.DescriptorSetLayout{ self.global_set_layout, self.object_set_layout };
-        pip_layout_info.set_layout_count = 2;
-        pip_layout_info.p_set_layouts = &set_layouts;
-
-        const pipeline_layout = try self.gc.vkd.createPipelineLayout(self.gc.dev, &pip_layout_info, null);
-        const pipeline = try createPipeline(self.gc, self.allocator, self.render_pass, pipeline_layout, resources.default_lit_frag);
-        const material = Material{
-            .pipeline = pipeline,
-            .pipeline_layout = pipeline_layout,
-        };
-        try self.materials.put("defaultmesh", material);
+        const zone = cpu_profiler.begin("init pipelines");
+        defer zone.end();
+
+        const fallback = try self.submitPipeline(try self.createPipelineLayout("colored_tri_frag", null), "colored_tri_frag", .{});
+
+        if (self.bindless) |bindless| {
+            // every material shares one pipeline and the texture array, they only differ by the texture index in the
+            // object data so the whole scene needs a single pipeline bind
+            const layout = try self.createPipelineLayout("textured_lit_bindless_frag", bindless.layout);
+            const pending = try self.submitPipeline(layout, "textured_lit_bindless_frag", .{});
+
+            for ([_][]const u8{ "defaultmesh", "redmesh", "texturedmesh" }) |name| {
+                try self.materials.put(name, .{
+                    .pipeline = undefined,
+                    .pipeline_layout = layout,
+                    .shader = "textured_lit_bindless_frag",
+                    .pending = pending,
+                    .texture_set = bindless.set,
+                });
+            }
+        } else {
+            // the distant scenery fades into fog, lit.frag only pays for it in the permutation that enables it
+            var fog = Specialization{};
+            fog.setBool(lit_fog_constant, true);
+
+            try self.addMaterial("defaultmesh", "default_lit_frag", .{});
+            try self.addMaterial("redmesh", "default_lit_frag", .{});
+            try self.addMaterial("texturedmesh", "textured_lit_frag", fog);
+        }
+
+        // materials are set to the fallback once it is built
+        self.fallback_handle = fallback;
+        self.fallback_pipeline = try self.pipelines.wait(fallback);
+        var iter = self.materials.valueIterator();
+        while (iter.next()) |mat| mat.pipeline = self.fallback_pipeline;
+    }
 
-        const pipeline_layout2 = try self.gc.vkd.createPipelineLayout(self.gc.dev, &pip_layout_info, null);
-        const pipeline2 = try createPipeline(self.gc, self.allocator, self.render_pass, pipeline_layout2, resources.default_lit_frag);
-        const material2 = Material{
-            .pipeline = pipeline2,
-            .pipeline_layout = pipeline_layout2,
+    /// the layout reflected from the mesh vertex shader and the fragment shader `frag`. Sets 0 and 1 are bound once per
+    /// pass for every material and so are always the engine's own, set 2 is reflected unless `material_set` is given.
+    fn createPipelineLayout(self: *Self, frag: []const u8, material_set: ?vk.DescriptorSetLayout) !vk.PipelineLayout {
+        return try self.layout_cache.create(&.{ self.shaders.get(mesh_vert_shader), self.shaders.get(frag) }, .{
+            .sets = .{ self.global_set_layout, self.object_set_layout, material_set, null },
+        });
+    }
+
+    /// queues the permutation of `frag` specialized with `specialization` unless it was already submitted, pipelines are
+    /// only ever built for permutations a material uses
+    fn submitPipeline(self: *Self, pipeline_layout: vk.PipelineLayout, frag: []const u8, specialization: Specialization) !MeshPipelines.Handle {
+        const desc = MeshPipelineDesc{
+            .render_pass = self.render_pass,
+            .layout = pipeline_layout,
+            .vert = self.shaders.get(mesh_vert_shader),
+            .frag = self.shaders.get(frag),
+            .frag_specialization = specialization,
         };
-        try self.materials.put("redmesh", material2);
 
-        // create pipeline layout for the textured mesh, which has 3 descriptor sets
-        const textured_set_layouts = [_]vk.DescriptorSetLayout{ self.global_set_layout, self.object_set_layout, self.single_tex_layout };
+        const result = try self.permutations.getOrPut(desc.hash());
+        if (!result.found_existing) {
+            errdefer _ = self.permutations.remove(desc.hash());
+            result.value_ptr.* = try self.pipelines.submit(desc);
+        }
+        return result.value_ptr.*;
+    }
 
-        var textured_pip_layout_info = vkinit.pipelineLayoutCreateInfo();
-        textured_pip_layout_info.set_layout_count = 4;
-        textured_pip_layout_info.p_set_layouts = &textured_set_layouts;
+    /// adds a material whose pipeline is built in the background
+    fn addMaterial(self: *Self, name: []const u8, frag: []const u8, specialization: Specialization) !void {
+        const pipeline_layout = try self.createPipelineLayout(frag, null);
+        try self.materials.put(name, .{
+            .pipeline = undefined,
+            .pipeline_layout = pipeline_layout,
+            .shader = frag,
+            .specialization = specialization,
+            .pending = try self.submitPipeline(pipeline_layout, frag, specialization),
+        });
+    }
 
-        const textured_pipeline_layout = try self.gc.vkd.createPipelineLayout(self.gc.dev, &textured_pip_layout_info, null);
-        const textured_pipeline = try createPipeline(self.gc, self.allocator, self.render_pass, textured_pipeline_layout, resources.textured_lit_frag);
-        const textured_material = Material{
-            .pipeline = textured_pipeline,
-            .pipeline_layout = textured_pipeline_layout,
-        };
-        try self.materials.put("texturedmesh", textured_material);
+    /// queues new pipelines for the materials whose shaders changed on disk, `updatePipelines` swaps them in like any
+    /// other build. Materials keep their pipeline layout: an edit that changes the shader interface needs a restart.
+    fn reloadShaders(self: *Self) !void {
+        var changed = std.ArrayList([]const u8).init(self.allocator);
+        defer changed.deinit();
+        try self.shaders.poll(&changed);
+        if (changed.items.len == 0) return;
+
+        const material_set = if (self.bindless) |bindless| bindless.layout else null;
+
+        var iter = self.materials.iterator();
+        while (iter.next()) |kv| {
+            const mat = kv.value_ptr;
+            if (!containsName(changed.items, mesh_vert_shader) and !containsName(changed.items, mat.shader)) continue;
+
+            const layout = try self.createPipelineLayout(mat.shader, material_set);
+            if (layout != mat.pipeline_layout) {
+                std.debug.print("not reloading material {s}, its shader interface changed. Restart to pick it up.\n", .{kv.key_ptr.*});
+                continue;
+            }
+
+            mat.pending = try self.submitPipeline(layout, mat.shader, mat.specialization);
+        }
+    }
+
+    /// swaps in the pipelines that finished building since the last frame
+    fn updatePipelines(self: *Self) !void {
+        // a material that already had its own pipeline is getting a reloaded one
+        var reloaded = false;
+
+        var iter = self.materials.valueIterator();
+        while (iter.next()) |mat| {
+            const pending = mat.pending orelse continue;
+            const pipeline = (self.pipelines.poll(pending) catch {
+                // keep drawing with the fallback rather than not at all
+                mat.pending = null;
+                continue;
+            }) orelse continue;
+
+            if (mat.pipeline != self.fallback_pipeline) reloaded = true;
+            mat.pipeline = pipeline;
+            mat.built = pending;
+            mat.pending = null;
+
+            // groups only span several materials once their pipelines are final, see buildGpuScene
+            for (self.gpu_driven.groups.items) |*group| {
+                if (group.tag == @ptrToInt(mat)) group.pipeline = pipeline;
+            }
+        }
+
+        // groups merged across materials with final pipelines can not be patched, the scene is regrouped instead
+        if (reloaded) {
+            try self.gc.vkd.deviceWaitIdle(self.gc.dev);
+            try self.buildGpuScene();
+            try self.retireUnusedPipelines();
+        }
+    }
+
+    /// drops every permutation no material draws with or waits on anymore. Their pipelines are released by
+    /// `releaseRetiredPipelines` once the frames that may have recorded them finished.
+    fn retireUnusedPipelines(self: *Self) !void {
+        var unused = std.ArrayList(u64).init(self.allocator);
+        defer unused.deinit();
+
+        var iter = self.permutations.iterator();
+        while (iter.next()) |kv| {
+            if (!self.pipelineInUse(kv.value_ptr.*)) try unused.append(kv.key_ptr.*);
+        }
+
+        try self.retired_pipelines.ensureUnusedCapacity(self.allocator, unused.items.len);
+        for (unused.items) |key| {
+            const handle = self.permutations.fetchRemove(key).?.value;
+            self.retired_pipelines.appendAssumeCapacity(.{ .handle = handle, .frame = self.frameIndex() });
+        }
+    }
+
+    fn pipelineInUse(self: *Self, handle: MeshPipelines.Handle) bool {
+        if (handle == self.fallback_handle) return true;
+
+        var iter = self.materials.valueIterator();
+        while (iter.next()) |mat| {
+            for ([_]?MeshPipelines.Handle{ mat.built, mat.pending }) |used| {
+                if (used != null and used.? == handle) return true;
+            }
+        }
+        return false;
+    }
+
+    /// call after waiting on the frames fence, like the Defragmenter a frame's resources are only safe to destroy after
+    /// `frames.len` more frames
+    fn releaseRetiredPipelines(self: *Self) void {
+        var i: usize = 0;
+        while (i < self.retired_pipelines.items.len) {
+            const retired = self.retired_pipelines.items[i];
+            if (self.frameIndex() < retired.frame + self.frames.len) {
+                i += 1;
+                continue;
+            }
+            self.pipelines.release(retired.handle);
+            _ = self.retired_pipelines.swapRemove(i);
+        }
+
+        // replaced SPIR-V is only read by builds, once none are running it can go
+        if (self.shaders.hasStale() and self.pipelines.pendingCount() == 0) self.shaders.freeStale();
     }
 
     fn initScene(self: *Self) !void {
+        const zone = cpu_profiler.begin("init scene");
+        defer zone.end();
+
         // create a sampler for the texture
         const sampler_info = vkinit.samplerCreateInfo(.nearest, vk.SamplerAddressMode.repeat);
         self.blocky_sampler = try self.gc.vkd.createSampler(self.gc.dev, &sampler_info, null);
 
         const textured_mat = self.materials.getPtr("texturedmesh").?;
+        textured_mat.texture = self.textures.getPtr("empire_diffuse").?;
+        if (self.bindless) |*bindless| {
+            textured_mat.texture_index = try bindless.add(textured_mat.texture.?.view, self.blocky_sampler);
+        } else {
+            textured_mat.texture_set = try self.createTextureSet(textured_mat.texture.?);
+        }
 
-        // allocate the descriptor set for single-texture to use on the material
-        const alloc_info = std.mem.zeroInit(vk.DescriptorSetAllocateInfo, .{
-            .descriptor_pool = self.descriptor_pool,
-            .descriptor_set_count = 1,
-            .p_set_layouts = @ptrCast([*]const vk.DescriptorSetLayout, &self.single_tex_layout),
-        });
-        var texture_set: vk.DescriptorSet = undefined;
-        try self.gc.vkd.allocateDescriptorSets(self.gc.dev, &alloc_info, @ptrCast([*]vk.DescriptorSet, &texture_set));
-        textured_mat.texture_set = texture_set;
-
-        // write to the descriptor set so that it points to our empire_diffuse texture
-        const image_buffer_info = vk.DescriptorImageInfo{
-            .sampler = self.blocky_sampler,
-            .image_view = self.textures.getPtr("empire_diffuse").?.view,
-            .image_layout = .shader_read_only_optimal,
-        };
-        const texture1 = vkinit.writeDescriptorImage(.combined_image_sampler, textured_mat.texture_set.?, &image_buffer_info, 0);
-        self.gc.vkd.updateDescriptorSets(self.gc.dev, 1, @ptrCast([*]const vk.WriteDescriptorSet, &texture1), 0, undefined);
+        self.materials.getPtr("redmesh").?.push_constants.tint = .{ 1, 0.3, 0.3, 1 };
 
         // create some objects
-        var monkey = RenderObject{
-            .mesh = self.meshes.getPtr("monkey").?,
-            .material = self.materials.getPtr("defaultmesh").?,
-            .transform_matrix = Mat4.createTranslation(Vec3.new(0, 2, 0)),
-        };
-        try self.renderables.append(monkey);
-
-        var empire = RenderObject{
-            .mesh = self.meshes.getPtr("lost_empire").?,
-            .material = self.materials.getPtr("texturedmesh").?,
-            .transform_matrix = Mat4.createTranslation(Vec3.new(0, 5, 0)),
-        };
-        try self.renderables.append(empire);
+        try self.addRenderable("monkey", "defaultmesh", Vec3.new(0, 2, 0), 1);
+        try self.addRenderable("lost_empire", "texturedmesh", Vec3.new(0, 5, 0), 1);
 
         var x: f32 = 0;
         while (x < 20) : (x += 1) {
             var y: f32 = 0;
             while (y < 20) : (y += 1) {
-                var matrix = Mat4.createTranslation(.{ .x = x, .y = 0, .z = y });
-                var scale_matrix = Mat4.createScale(.{ .x = 0.4, .y = 0.4, .z = 0.4 });
-
-                const mesh_material = if (@mod(x, 2) == 0) self.materials.getPtr("texturedmesh").? else self.materials.getPtr("redmesh").?;
-                const mesh = if (@mod(x, 2) == 0 and @mod(x, 6) == 0) self.meshes.getPtr("cube_thing").? else self.meshes.getPtr("triangle").?;
-                var object = RenderObject{
-                    .mesh = mesh,
-                    .material = mesh_material,
-                    .transform_matrix = Mat4.mul(matrix, scale_matrix),
-                };
-                try self.renderables.append(object);
+                const material: []const u8 = if (@mod(x, 2) == 0) "texturedmesh" else "redmesh";
+                const mesh: []const u8 = if (@mod(x, 2) == 0 and @mod(x, 6) == 0) "cube_thing" else "triangle";
 
-                matrix = Mat4.createTranslation(.{ .x = x, .y = 0.8, .z = y });
-                scale_matrix = Mat4.createScale(.{ .x = 0.2, .y = 0.2, .z = 0.2 });
+                try self.addRenderable(mesh, material, .{ .x = x, .y = 0, .z = y }, 0.4);
+                try self.addRenderable(mesh, material, .{ .x = x, .y = 0.8, .z = y }, 0.2);
+                try self.addRenderable(mesh, material, .{ .x = x, .y = -0.8, .z = y }, 0.2);
+            }
+        }
 
-                object = RenderObject{
-                    .mesh = mesh,
-                    .material = mesh_material,
-                    .transform_matrix = Mat4.mul(matrix, scale_matrix),
-                };
-                try self.renderables.append(object);
+        // the scene is static apart from objects spinning in place, so bounds are only computed once
+        try self.cull_spheres.ensureTotalCapacity(self.allocator, self.renderables.items.len);
+        for (self.renderables.items) |object| self.cull_spheres.appendAssumeCapacity(Sphere.fromTransform(object.transform_matrix.fields, object.mesh.bounds));
+
+        // nothing is in flight yet. Has to happen before buildGpuScene hands the object buffers to the GPU-driven path.
+        for (self.frames) |*frame| try frame.ensureObjectCapacity(self.gc, self.renderables.items.len);
+        try self.buildGpuScene();
+    }
+
+    /// the static scene for the GPU-driven path: one indirect command per run of objects sharing material and mesh, one
+    /// cull object per renderable and one draw group per run of commands sharing pipeline, texture set and push constants
+    fn buildGpuScene(self: *Self) !void {
+        // depth is irrelevant here, the order only has to group identical state
+        self.render_queue.clear();
+        for (self.renderables.items) |*object, i| {
+            try self.render_queue.push(@enumToInt(object.material.pipeline), @ptrToInt(object.material), @ptrToInt(object.mesh), 0, i);
+        }
+        try self.render_queue.sort();
+        try self.render_queue.buildBatches();
+        defer self.render_queue.clear();
+
+        const keys = self.render_queue.keys.items;
+        const batches = self.render_queue.batches.items;
+
+        var objects = try self.allocator.alloc(CullObject, keys.len);
+        defer self.allocator.free(objects);
+
+        var commands = try self.allocator.alloc(vk.DrawIndexedIndirectCommand, batches.len);
+        defer self.allocator.free(commands);
+
+        var groups = std.ArrayList(DrawGroup).init(self.allocator);
+        defer groups.deinit();
+        // the material the last group was started for
+        var group_material: *const Material = undefined;
+
+        for (batches) |batch, command_index| {
+            const first = &self.renderables.items[RenderQueue.objectIndex(keys[batch.first])];
+            const geometry = first.mesh.geometry;
+
+            // instance counts start at zero every frame, the cull shader bumps them for each visible object
+            commands[command_index] = .{
+                .index_count = geometry.index_count,
+                .instance_count = 0,
+                .first_index = geometry.first_index,
+                .vertex_offset = @intCast(i32, geometry.first_vertex),
+                .first_instance = batch.first,
+            };
 
-                matrix = Mat4.createTranslation(.{ .x = x, .y = -0.8, .z = y });
-                object = RenderObject{
-                    .mesh = mesh,
-                    .material = mesh_material,
-                    .transform_matrix = Mat4.mul(matrix, scale_matrix),
+            for (keys[batch.first .. batch.first + batch.count]) |key, j| {
+                const i = RenderQueue.objectIndex(key);
+                objects[batch.first + j] = .{
+                    .transform = self.renderables.items[i].transform_matrix.fields,
+                    .sphere = first.mesh.bounds,
+                    .command = @intCast(u32, command_index),
+                    .object_index = @intCast(u32, i),
+                    .texture_index = self.renderables.items[i].material.texture_index,
                 };
-                try self.renderables.append(object);
             }
+
+            const texture_set = first.material.texture_set orelse .null_handle;
+            if (groups.items.len > 0) {
+                const last = &groups.items[groups.items.len - 1];
+                // materials still drawing with the fallback keep their own group so updatePipelines can swap in their
+                // pipeline later
+                const final = group_material == first.material or (group_material.pending == null and first.material.pending == null);
+                if (final and last.pipeline == first.material.pipeline and last.pipeline_layout == first.material.pipeline_layout and
+                    last.texture_set == texture_set and std.meta.eql(last.push_constants, first.material.push_constants))
+                {
+                    last.command_count += 1;
+                    continue;
+                }
+            }
+
+            try groups.append(.{
+                .pipeline = first.material.pipeline,
+                .pipeline_layout = first.material.pipeline_layout,
+                .texture_set = texture_set,
+                .push_constants = first.material.push_constants,
+                .tag = @ptrToInt(first.material),
+                .first_command = @intCast(u32, command_index),
+                .command_count = 1,
+            });
+            group_material = first.material;
         }
+
+        var instance_buffers = try self.allocator.alloc(vk.Buffer, self.frames.len);
+        defer self.allocator.free(instance_buffers);
+        for (self.frames) |frame, i| instance_buffers[i] = frame.object_buffer.buffer;
+
+        try self.gpu_driven.build(objects, commands, groups.items, instance_buffers);
     }
 
-    fn draw(self: *Self, framebuffer: vk.Framebuffer, frame: FrameData) !void {
-        ig.igRender();
-        if ((ig.igGetIO().*.ConfigFlags & ig.ImGuiConfigFlags_ViewportsEnable) != 0) {
-            ig.igUpdatePlatformWindows();
-            ig.igRenderPlatformWindowsDefault(null, null);
-        }
+    /// adds an object that spins in place, its spin offset is its index
+    fn addRenderable(self: *Self, mesh: []const u8, material: []const u8, position: Vec3, scale: f32) !void {
+        const spin = @intToFloat(f32, self.renderables.items.len);
+        try self.renderables.append(.{
+            .mesh = self.meshes.getPtr(mesh).?,
+            .material = self.materials.getPtr(material).?,
+            .transform_matrix = Mat4.mul(Mat4.createTranslation(position), Mat4.createScale(.{ .x = scale, .y = scale, .z = scale })),
+        });
+        try self.transforms.append(self.allocator, .{ .x = position.x, .y = position.y, .z = position.z, .sx = scale, .sy = scale, .sz = scale, .spin = spin });
+    }
 
-        const cmdbuf = frame.cmd_buffer;
-        const clear = vk.ClearValue{
-            .color = .{ .float_32 = .{ 0.6, 0.5, 0, 1 } },
-        };
+    /// allocates a single-texture descriptor set pointing at `texture`
+    fn createTextureSet(self: *Self, texture: *const Texture) !vk.DescriptorSet {
+        const texture_set = try self.descriptors.allocate(self.single_tex_layout);
 
-        const depth_clear = vk.ClearValue{
-            .depth_stencil = .{ .depth = 1, .stencil = 0 },
+        const image_buffer_info = vk.DescriptorImageInfo{
+            .sampler = self.blocky_sampler,
+            .image_view = texture.view,
+            .image_layout = .shader_read_only_optimal,
         };
+        const texture1 = vkinit.writeDescriptorImage(.combined_image_sampler, texture_set, &image_buffer_info, 0);
+        self.gc.vkd.updateDescriptorSets(self.gc.dev, 1, @ptrCast([*]const vk.WriteDescriptorSet, &texture1), 0, undefined);
+
+        return texture_set;
+    }
 
-        const clear_values = [_]vk.ClearValue{ clear, depth_clear };
+    /// Defragmenter listener. Buffers are bound at record time so they need no patching but texture descriptor sets may still
+    /// be in use by frames in flight, so they get a fresh set or bindless slot. Old sets stay allocated, moves are rare and
+    /// sets are small, old slots are recycled.
+    fn onResourceMoved(ctx: *anyopaque, defragmenter: *Defragmenter, movable: *const Movable) anyerror!void {
+        _ = defragmenter;
+        const self = @ptrCast(*Self, @alignCast(@alignOf(Self), ctx));
+        switch (movable.*) {
+            .buffer => {},
+            .image => |img| {
+                var iter = self.materials.valueIterator();
+                while (iter.next()) |mat| {
+                    const texture = mat.texture orelse continue;
+                    if (&texture.image != img.handle) continue;
+
+                    if (self.bindless) |*bindless| {
+                        // frames in flight may still read the old slot, it is recycled once they finished. The CPU path
+                        // writes the index every frame, the GPU-driven objects are patched in order with this frame.
+                        const old_index = mat.texture_index;
+                        mat.texture_index = try bindless.add(texture.view, self.blocky_sampler);
+                        try bindless.retire(old_index, self.frameIndex());
+
+                        const cmd = CommandBuffer.init(self.frames[self.frameSlot()].cmd_buffer, self.gc);
+                        self.gpu_driven.replaceTextureIndex(cmd, old_index, mat.texture_index);
+                        continue;
+                    }
+
+                    const old_set = mat.texture_set.?;
+                    mat.texture_set = try self.createTextureSet(texture);
+
+                    for (self.gpu_driven.groups.items) |*group| {
+                        if (group.texture_set == old_set) group.texture_set = mat.texture_set.?;
+                    }
+                }
+            },
+        }
+    }
+
+    /// size of the swapchain or the headless target
+    fn targetExtent(self: Self) vk.Extent2D {
+        if (self.swapchain) |swapchain| return swapchain.extent;
+        return self.headless.?.extent;
+    }
+
+    fn frameIndex(self: Self) usize {
+        if (self.swapchain) |swapchain| return swapchain.frame_index;
+        return self.headless.?.frame_index;
+    }
+
+    fn frameSlot(self: Self) usize {
+        return self.frameIndex() % self.frames.len;
+    }
+
+    fn draw(self: *Self, frame: FrameData) !void {
+        const zone = cpu_profiler.begin("draw");
+        defer zone.end();
+
+        // there is no UI when headless
+        const gui = self.window != null;
+        if (gui) {
+            const imgui_zone = cpu_profiler.begin("imgui render");
+            defer imgui_zone.end();
+            ig.igRender();
+            if ((ig.igGetIO().*.ConfigFlags & ig.ImGuiConfigFlags_ViewportsEnable) != 0) {
+                ig.igUpdatePlatformWindows();
+                ig.igRenderPlatformWindowsDefault(null, null);
+            }
+        }
+
+        const cmdbuf = frame.cmd_buffer;
+        const extent = self.targetExtent();
+        const clear_color = vk.ClearColorValue{ .float_32 = .{ 0.6, 0.5, 0, 1 } };
 
         // This needs to be a separate definition - see https://github.com/ziglang/zig/issues/7627.
         const render_area = vk.Rect2D{
             .offset = .{ .x = 0, .y = 0 },
-            .extent = self.swapchain.extent,
+            .extent = extent,
         };
 
         const viewport = vk.Viewport{
             .x = 0,
             .y = 0,
-            .width = @intToFloat(f32, self.swapchain.extent.width),
-            .height = @intToFloat(f32, self.swapchain.extent.height),
+            .width = @intToFloat(f32, extent.width),
+            .height = @intToFloat(f32, extent.height),
             .min_depth = 0,
             .max_depth = 1,
         };
@@ -763,30 +1580,145 @@ pub const EngineChap5 = struct {
             .flags = .{ .one_time_submit_bit = true },
             .p_inheritance_info = null,
         });
+        const cmd = CommandBuffer.init(cmdbuf, self.gc);
+        try self.gpu_profiler.beginFrame(cmd, self.frameSlot());
+
+        // moves are recorded before the render pass so this frame already draws from the relocated resources
+        const defrag_scope = try self.gpu_profiler.begin(cmd, "defragment");
+        if (self.bindless) |*bindless| bindless.recycle(self.frameIndex(), self.frames.len);
+        try self.defragmenter.update(cmdbuf, self.frameIndex(), self.frames.len);
+        self.gpu_profiler.end(cmd, defrag_scope);
+
+        const pipelines_zone = cpu_profiler.begin("pipelines");
+        self.releaseRetiredPipelines();
+        try self.reloadShaders();
+        try self.updatePipelines();
+        pipelines_zone.end();
+
+        const view_proj = try self.updateFrameData(frame);
+        if (!self.options.gpu_driven) try self.prepareDraws(frame, view_proj);
+
+        const frame_slot = self.frameSlot();
+
+        const parallel = self.options.parallel_recording and !self.options.gpu_driven;
+        if (parallel) try frame.secondary.reset(self.gc);
+
+        const FramePasses = struct {
+            engine: *Self,
+            frame: FrameData,
+            frame_slot: usize,
+            view_proj: Mat4,
+            parallel: bool,
+            gui: bool,
+            viewport: vk.Viewport,
+            render_area: vk.Rect2D,
+
+            fn cull(passes: *@This(), pass: RenderGraph.PassContext) anyerror!void {
+                const angle = toRadians(25.0) * passes.engine.frame_num * 0.04;
+                passes.engine.gpu_driven.cull(pass.cmd, passes.frame_slot, passes.view_proj.fields, angle);
+            }
 
-        self.gc.vkd.cmdSetViewport(cmdbuf, 0, 1, @ptrCast([*]const vk.Viewport, &viewport));
-        self.gc.vkd.cmdSetScissor(cmdbuf, 0, 1, @ptrCast([*]const vk.Rect2D, &render_area));
+            fn forward(passes: *@This(), pass: RenderGraph.PassContext) anyerror!void {
+                const engine = passes.engine;
+                // secondary command buffers set their own, no commands may be recorded inline into their render pass
+                if (!passes.parallel) {
+                    pass.cmd.setViewport(0, 1, @ptrCast([*]const vk.Viewport, &passes.viewport));
+                    pass.cmd.setScissor(0, 1, @ptrCast([*]const vk.Rect2D, &passes.render_area));
+                }
 
-        self.gc.vkd.cmdBeginRenderPass(cmdbuf, &.{
-            .render_pass = self.render_pass,
-            .framebuffer = framebuffer,
+                if (engine.options.gpu_driven) {
+                    engine.drawGpuDriven(passes.frame, passes.frame_slot);
+                } else if (passes.parallel) {
+                    try engine.recordParallel(passes.frame, pass.framebuffer, passes.viewport, passes.render_area, passes.gui);
+                } else {
+                    engine.recordBatches(pass.cmd.cmdbuf, passes.frame, engine.render_queue.batches.items, &engine.render_queue.stats);
+                }
+
+                if (passes.gui and !passes.parallel) igvk.ImGui_ImplVulkan_RenderDrawData(ig.igGetDrawData(), pass.cmd.cmdbuf, .null_handle);
+            }
+
+            fn readback(passes: *@This(), pass: RenderGraph.PassContext) anyerror!void {
+                passes.engine.headless.?.recordReadback(pass.cmd);
+            }
+        };
+        var passes = FramePasses{
+            .engine = self,
+            .frame = frame,
+            .frame_slot = frame_slot,
+            .view_proj = view_proj,
+            .parallel = parallel,
+            .gui = gui,
+            .viewport = viewport,
             .render_area = render_area,
-            .clear_value_count = clear_values.len,
-            .p_clear_values = @ptrCast([*]const vk.ClearValue, &clear_values),
-        }, .@"inline");
+        };
+
+        // the graph places the barriers between culling and drawing and moves the swapchain image into and out of the
+        // attachment layout
+        self.graph.reset();
+        const backbuffer = if (self.swapchain) |swapchain| blk: {
+            const swap_image = swapchain.swap_images[swapchain.image_index];
+            break :blk try self.graph.importImage(.{
+                .image = swap_image.image,
+                .view = swap_image.view,
+                .format = swapchain.surface_format.format,
+                .extent = extent,
+                // the acquire semaphore is waited on at this stage
+                .initial = .{ .stages = .{ .color_attachment_output_bit = true } },
+                .final_layout = .present_src_khr,
+            });
+        } else try self.graph.importImage(.{
+            // the slot's fence was waited on, nothing on the GPU still uses the image
+            .image = self.headless.?.currentImage(),
+            .view = self.headless.?.currentView(),
+            .format = HeadlessTarget.format,
+            .extent = extent,
+        });
+        const depth = try self.graph.createImage(.{ .format = depth_format, .extent = extent, .aspect_mask = .{ .depth_bit = true } });
 
-        try self.drawRenderObjects(frame);
+        var commands: ?RenderGraph.BufferHandle = null;
+        var objects: ?RenderGraph.BufferHandle = null;
+        if (self.options.gpu_driven and self.gpu_driven.command_count > 0) {
+            commands = try self.graph.importBuffer(self.gpu_driven.command_buffers[frame_slot].buffer, .{});
+            objects = try self.graph.importBuffer(frame.object_buffer.buffer, .{});
+
+            const cull = try self.graph.addPass("cull", &passes, FramePasses.cull);
+            try cull.writeBuffer(commands.?, .storage_write_compute);
+            try cull.writeBuffer(objects.?, .storage_write_compute);
+        }
+
+        const forward = try self.graph.addPass("forward", &passes, FramePasses.forward);
+        try forward.colorAttachment(backbuffer, clear_color);
+        try forward.depthAttachment(depth, 1);
+        if (commands) |buffer| try forward.readBuffer(buffer, .indirect);
+        if (objects) |buffer| try forward.readBuffer(buffer, .storage_read_vertex);
+        if (parallel) forward.secondaryCommandBuffers();
+
+        if (self.headless != null) {
+            const readback = try self.graph.addPass("readback", &passes, FramePasses.readback);
+            try readback.readImage(backbuffer, .transfer_src);
+            readback.sideEffects();
+        }
 
-        igvk.ImGui_ImplVulkan_RenderDrawData(ig.igGetDrawData(), cmdbuf, .null_handle);
-        self.gc.vkd.cmdEndRenderPass(cmdbuf);
+        const graph_zone = cpu_profiler.begin("graph compile");
+        try self.graph.compile();
+        graph_zone.end();
+
+        const record_zone = cpu_profiler.begin("record");
+        try self.graph.execute(cmd, &self.gpu_profiler);
+        record_zone.end();
+
+        self.gpu_profiler.endFrame(cmd);
         try self.gc.vkd.endCommandBuffer(cmdbuf);
     }
 
-    fn drawRenderObjects(self: *Self, frame: FrameData) !void {
-        const cmdbuf = frame.cmd_buffer;
+    /// uploads camera and scene data for the frame and returns the view projection matrix
+    fn updateFrameData(self: *Self, frame: FrameData) !Mat4 {
+        const zone = cpu_profiler.begin("update frame data");
+        defer zone.end();
 
         var view = self.camera.getViewMatrix();
-        var proj = Mat4.createPerspective(toRadians(70.0), @intToFloat(f32, self.swapchain.extent.width) / @intToFloat(f32, self.swapchain.extent.height), 0.1, 200);
+        const extent = self.targetExtent();
+        var proj = Mat4.createPerspective(toRadians(70.0), @intToFloat(f32, extent.width) / @intToFloat(f32, extent.height), 0.1, draw_distance);
         proj.fields[1][1] *= -1;
         var view_proj = Mat4.mul(proj, view);
 
@@ -806,64 +1738,239 @@ pub const EngineChap5 = struct {
         const framed = self.frame_num / 12;
         self.scene_params.ambient_color = Vec4.new((std.math.sin(framed) + 1) * 0.5, 1, (std.math.cos(framed) + 1) * 0.5, 1);
 
-        const frame_index = @floatToInt(usize, self.frame_num) % FRAME_OVERLAP;
-        const data_offset = padUniformBufferSize(self.gc, @sizeOf(GpuSceneData)) * frame_index;
-        const scene_data_ptr = (try self.gc.allocator.mapMemoryAtOffset(GpuSceneData, self.scene_param_buffer.allocation, data_offset));
+        const scene_data_ptr = (try self.gc.allocator.mapMemoryAtOffset(GpuSceneData, self.scene_param_buffer.allocation, frame.scene_offset));
         scene_data_ptr.* = self.scene_params;
         self.gc.allocator.unmapMemory(self.scene_param_buffer.allocation);
 
-        // object SSBO
-        const object_data_ptr = try self.gc.allocator.mapMemory(GpuObjectData, frame.object_buffer.allocation);
-        for (self.renderables.items) |*object, i| {
-            var rot = Mat4.createAngleAxis(.{ .y = 1 }, toRadians(25.0) * self.frame_num * 0.04 + @intToFloat(f32, i));
-            object_data_ptr[i].model = object.transform_matrix.mul(rot);
+        return view_proj;
+    }
+
+    /// binds the arena and the descriptor sets shared by every material
+    fn bindSharedState(self: *Self, cmdbuf: vk.CommandBuffer, frame: FrameData, pipeline_layout: vk.PipelineLayout, stats: *RenderQueue.Stats) void {
+        // every mesh lives in the arena so its buffers are bound once for the whole pass
+        self.geometry.bind(cmdbuf);
+        stats.vertex_binds += 1;
+
+        // sets 0 and 1 use the same layouts in every material pipeline layout so they stay bound across pipeline switches
+        self.gc.vkd.cmdBindDescriptorSets(cmdbuf, .graphics, pipeline_layout, 0, 1, @ptrCast([*]const vk.DescriptorSet, &frame.global_descriptor), 1, @ptrCast([*]const u32, &frame.scene_offset));
+        self.gc.vkd.cmdBindDescriptorSets(cmdbuf, .graphics, pipeline_layout, 1, 1, @ptrCast([*]const vk.DescriptorSet, &frame.object_descriptor), 0, undefined);
+        stats.descriptor_binds += 2;
+    }
+
+    fn drawGpuDriven(self: *Self, frame: FrameData, frame_slot: usize) void {
+        self.render_queue.clear();
+        const groups = self.gpu_driven.groups.items;
+        if (groups.len == 0) return;
+
+        self.bindSharedState(frame.cmd_buffer, frame, groups[0].pipeline_layout, &self.render_queue.stats);
+        self.gpu_driven.draw(CommandBuffer.init(frame.cmd_buffer, self.gc), frame_slot, &self.render_queue.stats);
+    }
+
+    /// culls, sorts and batches the renderables and fills the object buffer. Recording happens in `recordBatches`.
+    fn prepareDraws(self: *Self, frame: FrameData, view_proj: Mat4) !void {
+        const zone = cpu_profiler.begin("prepare draws");
+        defer zone.end();
+
+        self.render_queue.clear();
+        self.visible.clearRetainingCapacity();
+        try Frustum.fromViewProj(view_proj.fields).cullSpheres(self.cull_spheres.slice(), &self.visible);
+        self.render_queue.stats.culled = @intCast(u32, self.renderables.items.len - self.visible.items.len);
+
+        // build a sort key per visible object, state first and front to back within the same state
+        for (self.visible.items) |i| {
+            const object = &self.renderables.items[i];
+            const pos = object.transform_matrix.fields[3];
+            const delta = Vec3.new(pos[0] - self.camera.pos.x, pos[1] - self.camera.pos.y, pos[2] - self.camera.pos.z);
+            const dist = std.math.sqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z);
+
+            // keyed by material rather than its texture set so a batch never mixes materials, each is one push
+            try self.render_queue.push(@enumToInt(object.material.pipeline), @ptrToInt(object.material), @ptrToInt(object.mesh), dist / draw_distance, i);
         }
+        try self.render_queue.sort();
+        try self.render_queue.buildBatches();
+
+        const stats = &self.render_queue.stats;
+        const keys = self.render_queue.keys.items;
+        if (keys.len == 0) return;
+
+        // object SSBO, written in key order so every batch covers a contiguous range of instances
+        // the buffer is sized for every renderable in initScene
+        if (keys.len > frame.object_capacity) return error.ObjectBufferTooSmall;
+        try self.draw_order.resize(keys.len);
+        for (keys) |key, slot| self.draw_order.items[slot] = @intCast(u32, RenderQueue.objectIndex(key));
+
+        const object_data = (try self.gc.allocator.mapMemory(GpuObjectData, frame.object_buffer.allocation))[0..keys.len];
+        const angle = toRadians(25.0) * self.frame_num * 0.04;
+        computeWorldMatricesParallel(self.jobs, self.transforms.slice(), self.draw_order.items, angle, object_data);
+        for (self.draw_order.items) |i, slot| object_data[slot].texture_index = self.renderables.items[i].material.texture_index;
         self.gc.allocator.unmapMemory(frame.object_buffer.allocation);
+        stats.objects = @intCast(u32, keys.len);
+    }
 
-        var last_mesh: *Mesh = @intToPtr(*Mesh, @ptrToInt(&self));
-        var last_material: *Material = @intToPtr(*Material, @ptrToInt(&self));
+    /// records a run of prepared batches. Only reads engine state so chunks can be recorded from several threads at once.
+    fn recordBatches(self: *Self, cmdbuf: vk.CommandBuffer, frame: FrameData, batches: []const RenderQueue.Batch, stats: *RenderQueue.Stats) void {
+        const zone = cpu_profiler.begin("record batches");
+        defer zone.end();
 
-        for (self.renderables.items) |*object, i| {
-            // only bind the pipeline if it doesnt match with the already bound one
-            if (object.material != last_material) {
-                last_material = object.material;
-                self.gc.vkd.cmdBindPipeline(cmdbuf, .graphics, object.material.pipeline);
+        if (batches.len == 0) return;
 
-                // offset for our scene buffer
-                const uniform_offset = padUniformBufferSize(self.gc, @sizeOf(GpuSceneData)) * frame_index;
+        const keys = self.render_queue.keys.items;
+        self.bindSharedState(cmdbuf, frame, self.renderables.items[RenderQueue.objectIndex(keys[batches[0].first])].material.pipeline_layout, stats);
 
-                // bind the descriptor set when changing pipeline
-                self.gc.vkd.cmdBindDescriptorSets(cmdbuf, .graphics, object.material.pipeline_layout, 0, 1, @ptrCast([*]const vk.DescriptorSet, &frame.global_descriptor), 1, @ptrCast([*]const u32, &uniform_offset));
+        const cmd = CommandBuffer.init(cmdbuf, self.gc);
+        var last_pipeline: vk.Pipeline = .null_handle;
+        var last_texture_set: vk.DescriptorSet = .null_handle;
+        var last_material: usize = 0;
 
-                // bind the object data descriptor
-                self.gc.vkd.cmdBindDescriptorSets(cmdbuf, .graphics, object.material.pipeline_layout, 1, 1, @ptrCast([*]const vk.DescriptorSet, &frame.object_descriptor), 0, undefined);
+        for (batches) |batch| {
+            const object = &self.renderables.items[RenderQueue.objectIndex(keys[batch.first])];
+
+            // only bind the pipeline if it doesnt match with the already bound one
+            if (object.material.pipeline != last_pipeline) {
+                last_pipeline = object.material.pipeline;
+                self.gc.vkd.cmdBindPipeline(cmdbuf, .graphics, object.material.pipeline);
+                stats.pipeline_binds += 1;
+            }
 
-                if (object.material.texture_set) |texture_set| {
+            if (object.material.texture_set) |texture_set| {
+                if (texture_set != last_texture_set) {
+                    last_texture_set = texture_set;
                     self.gc.vkd.cmdBindDescriptorSets(cmdbuf, .graphics, object.material.pipeline_layout, 2, 1, @ptrCast([*]const vk.DescriptorSet, &texture_set), 0, undefined);
+                    stats.descriptor_binds += 1;
                 }
             }
 
-            var model = object.transform_matrix;
-            var rot = Mat4.createAngleAxis(.{ .y = 1 }, toRadians(25.0) * self.frame_num * 0.04);
-            model = model.mul(rot);
+            if (@ptrToInt(object.material) != last_material) {
+                last_material = @ptrToInt(object.material);
+                cmd.pushConstants(object.material.pipeline_layout, DrawPushConstants.range.stage_flags, 0, @sizeOf(DrawPushConstants), &object.material.push_constants);
+                stats.push_constants += 1;
+            }
+
+            const geometry = object.mesh.geometry;
+            self.gc.vkd.cmdDrawIndexed(cmdbuf, geometry.index_count, batch.count, geometry.first_index, @intCast(i32, geometry.first_vertex), batch.first);
+            stats.draws += 1;
+        }
+    }
+
+    /// splits the batches into one chunk per worker, records them into secondary command buffers in parallel and executes
+    /// them from the primary. The render pass must have been begun with secondary command buffer contents.
+    fn recordParallel(self: *Self, frame: FrameData, framebuffer: vk.Framebuffer, viewport: vk.Viewport, scissor: vk.Rect2D, gui: bool) !void {
+        const zone = cpu_profiler.begin("record parallel");
+        defer zone.end();
+
+        const DrawChunks = struct {
+            engine: *Self,
+            frame: FrameData,
+            framebuffer: vk.Framebuffer,
+            viewport: vk.Viewport,
+            scissor: vk.Rect2D,
+            chunk_count: usize,
+            recorded: [max_record_threads + 1]vk.CommandBuffer = undefined,
+            stats: [max_record_threads]RenderQueue.Stats = [_]RenderQueue.Stats{.{}} ** max_record_threads,
+            errors: [max_record_threads]?anyerror = [_]?anyerror{null} ** max_record_threads,
+
+            fn record(chunks: *@This(), chunk: usize, worker: usize) void {
+                chunks.recordChunk(chunk, worker) catch |err| {
+                    chunks.errors[chunk] = err;
+                };
+            }
 
-            // only bind the mesh if its a different one from last bind
-            if (object.mesh != last_mesh) {
-                last_mesh = object.mesh;
-                // bind the mesh vertex buffer with offset 0
-                var offset: vk.DeviceSize = 0;
-                self.gc.vkd.cmdBindVertexBuffers(cmdbuf, 0, 1, @ptrCast([*]const vk.Buffer, &object.mesh.vert_buffer.buffer), @ptrCast([*]const vk.DeviceSize, &offset));
+            fn recordChunk(chunks: *@This(), chunk: usize, worker: usize) !void {
+                const engine = chunks.engine;
+                const batches = engine.render_queue.batches.items;
+                const first = batches.len * chunk / chunks.chunk_count;
+                const last = batches.len * (chunk + 1) / chunks.chunk_count;
+
+                // secondaries inherit neither dynamic state nor bindings from the primary
+                const cmdbuf = chunks.frame.secondary.get(worker, chunk);
+                try SecondaryCommands.begin(engine.gc, cmdbuf, engine.render_pass, chunks.framebuffer);
+                engine.gc.vkd.cmdSetViewport(cmdbuf, 0, 1, @ptrCast([*]const vk.Viewport, &chunks.viewport));
+                engine.gc.vkd.cmdSetScissor(cmdbuf, 0, 1, @ptrCast([*]const vk.Rect2D, &chunks.scissor));
+                engine.recordBatches(cmdbuf, chunks.frame, batches[first..last], &chunks.stats[chunk]);
+                try engine.gc.vkd.endCommandBuffer(cmdbuf);
+
+                chunks.recorded[chunk] = cmdbuf;
             }
+        };
 
-            self.gc.vkd.cmdDraw(cmdbuf, @intCast(u32, object.mesh.vertices.items.len), 1, 0, @intCast(u32, i));
+        const chunk_count = self.jobs.workerCount();
+        var chunks = DrawChunks{
+            .engine = self,
+            .frame = frame,
+            .framebuffer = framebuffer,
+            .viewport = viewport,
+            .scissor = scissor,
+            .chunk_count = chunk_count,
+        };
+        self.jobs.parallelFor(chunk_count, &chunks, DrawChunks.record);
+
+        for (chunks.errors[0..chunk_count]) |err| {
+            if (err) |e| return e;
         }
+        for (chunks.stats[0..chunk_count]) |stats| self.render_queue.stats.add(stats);
+
+        // nothing may be recorded inline in a subpass that executes secondaries, so imgui gets one as well. There is no
+        // imgui when running headless.
+        var recorded_count = chunk_count;
+        if (gui) {
+            const overlay = frame.secondary.get(0, chunk_count);
+            try SecondaryCommands.begin(self.gc, overlay, self.render_pass, framebuffer);
+            igvk.ImGui_ImplVulkan_RenderDrawData(ig.igGetDrawData(), overlay, .null_handle);
+            try self.gc.vkd.endCommandBuffer(overlay);
+            chunks.recorded[chunk_count] = overlay;
+            recorded_count += 1;
+        }
+
+        CommandBuffer.init(frame.cmd_buffer, self.gc).executeCommands(@intCast(u32, recorded_count), &chunks.recorded);
+    }
+
+    fn drawRenderStats(self: *Self) void {
+        defer ig.igEnd();
+        if (!ig.igBegin("Render Queue", null, ig.ImGuiWindowFlags_None)) return;
+
+        _ = ig.igCheckbox("GPU driven", &self.options.gpu_driven);
+        _ = ig.igCheckbox("parallel recording", &self.options.parallel_recording);
+
+        const stats = self.render_queue.stats;
+        var buf: [256]u8 = undefined;
+        const text = std.fmt.bufPrintZ(&buf, "objects: {d}\nculled: {d}\ndraws: {d}\npipeline binds: {d}\ndescriptor binds: {d}\nvertex binds: {d}\npush constants: {d}", .{ stats.objects, stats.culled, stats.draws, stats.pipeline_binds, stats.descriptor_binds, stats.vertex_binds, stats.push_constants }) catch return;
+        ig.igTextUnformatted(text.ptr, null);
+    }
+
+    fn drawFramePacing(self: *Self) void {
+        defer ig.igEnd();
+        if (!ig.igBegin("Frame Pacing", null, ig.ImGuiWindowFlags_None)) return;
+
+        // takes effect at the top of the next frame
+        _ = ig.igCheckbox("low latency", &self.options.low_latency);
+
+        const pacing = self.pacing;
+        var buf: [256]u8 = undefined;
+        const text = std.fmt.bufPrintZ(&buf, "present mode: {s}\nframes in flight: {d}\nframe: {d:.2} ms\ncpu wait: {d:.2} ms\ngpu: {d:.2} ms", .{
+            presentModeName(self.swapchain.?.present_mode),
+            self.frames.len,
+            pacing.frame_ms,
+            pacing.cpu_wait_ms,
+            pacing.gpu_ms,
+        }) catch return;
+        ig.igTextUnformatted(text.ptr, null);
     }
 };
 
-fn createRenderPass(gc: *const GraphicsContext, swapchain: Swapchain) !vk.RenderPass {
+fn presentModeName(mode: vk.PresentModeKHR) []const u8 {
+    return switch (mode) {
+        .fifo_khr => "fifo",
+        .mailbox_khr => "mailbox",
+        .immediate_khr => "immediate",
+        .fifo_relaxed_khr => "fifo relaxed",
+        else => "other",
+    };
+}
+
+fn createRenderPass(gc: *const GraphicsContext, color_format: vk.Format) !vk.RenderPass {
     const color_attachment = vk.AttachmentDescription{
         .flags = .{},
-        .format = swapchain.surface_format.format,
+        .format = color_format,
         .samples = .{ .@"1_bit" = true },
         .load_op = .clear,
         .store_op = .store,
@@ -956,46 +2063,11 @@ fn createRenderPass(gc: *const GraphicsContext, swapchain: Swapchain) !vk.Render
     }, null);
 }
 
-fn createDepthImage(gc: *const GraphicsContext, swapchain: Swapchain) !Texture {
-    const depth_extent = vk.Extent3D{ .width = swapchain.extent.width, .height = swapchain.extent.height, .depth = 1 };
-    const dimg_info = vkinit.imageCreateInfo(depth_format, depth_extent, .{ .depth_stencil_attachment_bit = true });
-
-    // we want to allocate it from GPU local memory
-    var malloc_info = std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{
-        .flags = .{},
-        .usage = .gpu_only,
-        .requiredFlags = .{ .device_local_bit = true },
-    });
-    var depth_image = Texture.init(try gc.allocator.createImage(&dimg_info, &malloc_info, null));
-
-    const dview_info = vkinit.imageViewCreateInfo(depth_format, depth_image.image.image, .{ .depth_bit = true });
-    depth_image.view = try gc.vkd.createImageView(gc.dev, &dview_info, null);
-
-    return depth_image;
-}
-
-fn createFramebuffers(gc: *const GraphicsContext, allocator: Allocator, render_pass: vk.RenderPass, swapchain: Swapchain, depth_image_view: vk.ImageView) ![]vk.Framebuffer {
-    const framebuffers = try allocator.alloc(vk.Framebuffer, swapchain.swap_images.len);
-    errdefer allocator.free(framebuffers);
-
-    var i: usize = 0;
-    errdefer for (framebuffers[0..i]) |fb| gc.destroy(fb);
-
-    for (framebuffers) |*fb| {
-        var attachments = [2]vk.ImageView{ swapchain.swap_images[i].view, depth_image_view };
-        fb.* = try gc.vkd.createFramebuffer(gc.dev, &.{
-            .flags = .{},
-            .render_pass = render_pass,
-            .attachment_count = 2,
-            .p_attachments = @ptrCast([*]const vk.ImageView, &attachments),
-            .width = swapchain.extent.width,
-            .height = swapchain.extent.height,
-            .layers = 1,
-        }, null);
-        i += 1;
-    }
-
-    return framebuffers;
+fn initBindless(gc: *const GraphicsContext, allocator: Allocator) ?BindlessTextures {
+    return BindlessTextures.init(gc, allocator) catch |err| {
+        std.debug.print("bindless textures unavailable, using a descriptor set per material: {}\n", .{err});
+        return null;
+    };
 }
 
 fn createShaderModule(gc: *const GraphicsContext, data: [*]const u32, len: usize) !vk.ShaderModule {
@@ -1016,20 +2088,19 @@ fn createShaderStageCreateInfo(shader_module: vk.ShaderModule, stage: vk.ShaderS
     };
 }
 
-fn createPipeline(
-    gc: *const GraphicsContext,
-    allocator: std.mem.Allocator,
-    render_pass: vk.RenderPass,
-    pipeline_layout: vk.PipelineLayout,
-    frag_shader_bytes: [:0]const u8,
-) !vk.Pipeline {
-    const vert = try createShaderModule(gc, @ptrCast([*]const u32, resources.tri_mesh_descriptors_vert), resources.tri_mesh_descriptors_vert.len);
-    const frag = try createShaderModule(gc, @ptrCast([*]const u32, @alignCast(@alignOf(u32), frag_shader_bytes)), frag_shader_bytes.len);
-
+/// runs on the MeshPipelines threads
+fn createPipeline(gc: *const GraphicsContext, allocator: std.mem.Allocator, pipeline_cache: vk.PipelineCache, desc: MeshPipelineDesc) anyerror!vk.Pipeline {
+    const vert = try createShaderModule(gc, @ptrCast([*]const u32, @alignCast(@alignOf(u32), desc.vert.ptr)), desc.vert.len);
     defer gc.destroy(vert);
+    const frag = try createShaderModule(gc, @ptrCast([*]const u32, @alignCast(@alignOf(u32), desc.frag.ptr)), desc.frag.len);
     defer gc.destroy(frag);
 
-    var builder = PipelineBuilder.init(allocator, pipeline_layout);
+    // the driver would happily read garbage for a location the vertex layout does not provide
+    const vert_reflection = try spirv_reflect.reflect(allocator, desc.vert);
+    defer vert_reflection.deinit(allocator);
+    if (!vert_reflection.acceptsVertexInput(&Vertex.attribute_description)) return error.VertexInputMismatch;
+
+    var builder = PipelineBuilder.init(allocator, desc.layout);
     builder.depth_stencil = vkinit.pipelineDepthStencilCreateInfo(true, true, .less_or_equal);
 
     builder.vertex_input_info.vertex_attribute_description_count = Vertex.attribute_description.len;
@@ -1038,8 +2109,8 @@ fn createPipeline(
     builder.vertex_input_info.p_vertex_binding_descriptions = @ptrCast([*]const vk.VertexInputBindingDescription, &Vertex.binding_description);
 
     try builder.addShaderStage(createShaderStageCreateInfo(vert, .{ .vertex_bit = true }));
-    try builder.addShaderStage(createShaderStageCreateInfo(frag, .{ .fragment_bit = true }));
-    return try builder.build(gc, render_pass);
+    try builder.addShaderStageSpecialized(createShaderStageCreateInfo(frag, .{ .fragment_bit = true }), desc.frag_specialization);
+    return try builder.build(gc, desc.render_pass, pipeline_cache);
 }
 
 fn padUniformBufferSize(gc: *const GraphicsContext, size: usize) usize {
@@ -1073,103 +2144,92 @@ fn createBuffer(gc: *const GraphicsContext, size: usize, usage: vk.BufferUsageFl
     return try gc.allocator.createBuffer(&buffer_info, &malloc_info, null);
 }
 
-fn createDescriptors(gc: *const GraphicsContext) struct { layout: vk.DescriptorSetLayout, pool: vk.DescriptorPool, scene_param_buffer: vma.AllocatedBuffer, object_set_layout: vk.DescriptorSetLayout, single_tex_layout: vk.DescriptorSetLayout } {
-    // binding for camera data at 0
-    const cam_bind = vkinit.descriptorSetLayoutBinding(.uniform_buffer, .{ .vertex_bit = true }, 0);
+/// the memory type and flags come from the pool
+fn createPoolBuffer(gc: *const GraphicsContext, size: usize, usage: vk.BufferUsageFlags, pool: vma.Pool) !vma.AllocatedBuffer {
+    const buffer_info = std.mem.zeroInit(vk.BufferCreateInfo, .{
+        .flags = .{},
+        .size = size,
+        .usage = usage,
+    });
 
-    // binding for scene data at 1
-    const scene_bind = vkinit.descriptorSetLayoutBinding(.uniform_buffer_dynamic, .{ .vertex_bit = true, .fragment_bit = true }, 1);
-    const bindings = [_]vk.DescriptorSetLayoutBinding{ cam_bind, scene_bind };
+    const malloc_info = std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{
+        .pool = pool.pool,
+    });
 
-    const set_info = vk.DescriptorSetLayoutCreateInfo{
-        .flags = .{},
-        .binding_count = 2,
-        .p_bindings = &bindings,
-    };
-    const global_set_layout = gc.vkd.createDescriptorSetLayout(gc.dev, &set_info, null) catch unreachable;
+    return try gc.allocator.createBuffer(&buffer_info, &malloc_info, null);
+}
 
-    // binding for object data at 0
-    const object_bind = vkinit.descriptorSetLayoutBinding(.storage_buffer, .{ .vertex_bit = true }, 0);
-    const set_info_object = vk.DescriptorSetLayoutCreateInfo{
-        .flags = .{},
-        .binding_count = 1,
-        .p_bindings = @ptrCast([*]const vk.DescriptorSetLayoutBinding, &object_bind),
+fn createDescriptors(gc: *const GraphicsContext, layout_cache: *PipelineLayoutCache, frame_pool: vma.Pool, frames_in_flight: usize) !struct { layout: vk.DescriptorSetLayout, scene_param_buffer: vma.AllocatedBuffer, object_set_layout: vk.DescriptorSetLayout, single_tex_layout: vk.DescriptorSetLayout } {
+    // sets 0 and 1 are bound once for every material so their layouts have to cover all the mesh shaders
+    const mesh_shaders = [_][]const u8{
+        resources.tri_mesh_descriptors_vert,
+        resources.colored_tri_frag,
+        resources.default_lit_frag,
+        resources.textured_lit_frag,
+        resources.textured_lit_bindless_frag,
     };
-    const object_set_layout = gc.vkd.createDescriptorSetLayout(gc.dev, &set_info_object, null) catch unreachable;
 
-    // another set, one that holds a single texture
-    const tex_bind = vkinit.descriptorSetLayoutBinding(.combined_image_sampler, .{ .fragment_bit = true }, 0);
+    // camera data at 0, scene data at 1 which is bound with a per frame offset into one buffer
+    const global_set_layout = try layout_cache.createSetLayout(&mesh_shaders, 0, .{ .dynamic_buffers = &.{.{ .set = 0, .binding = 1 }} });
 
-    const tex_set_info = vk.DescriptorSetLayoutCreateInfo{
-        .flags = .{},
-        .binding_count = 1,
-        .p_bindings = @ptrCast([*]const vk.DescriptorSetLayoutBinding, &tex_bind),
-    };
-    const single_tex_layout = gc.vkd.createDescriptorSetLayout(gc.dev, &tex_set_info, null) catch unreachable;
+    // object data at 0
+    const object_set_layout = try layout_cache.createSetLayout(&mesh_shaders, 1, .{});
 
-    const sizes = [_]vk.DescriptorPoolSize{
-        .{
-            .@"type" = .uniform_buffer,
-            .descriptor_count = 10,
-        },
-        .{
-            .@"type" = .uniform_buffer_dynamic,
-            .descriptor_count = 10,
-        },
-        .{
-            .@"type" = .storage_buffer,
-            .descriptor_count = 10,
-        },
-        .{
-            .@"type" = .combined_image_sampler,
-            .descriptor_count = 10,
-        },
-    };
-    var descriptor_pool = gc.vkd.createDescriptorPool(gc.dev, &.{
-        .flags = .{},
-        .max_sets = 10,
-        .pool_size_count = 4,
-        .p_pool_sizes = &sizes,
-    }, null) catch unreachable;
+    // another set, one that holds a single texture
+    const single_tex_layout = try layout_cache.createSetLayout(&.{resources.textured_lit_frag}, 2, .{});
 
-    const scene_param_buffer_size = FRAME_OVERLAP * padUniformBufferSize(gc, @sizeOf(GpuSceneData));
-    const scene_param_buffer = createBuffer(gc, scene_param_buffer_size, .{ .uniform_buffer_bit = true }, .cpu_to_gpu) catch unreachable;
+    const scene_param_buffer_size = frames_in_flight * padUniformBufferSize(gc, @sizeOf(GpuSceneData));
+    const scene_param_buffer = try createPoolBuffer(gc, scene_param_buffer_size, .{ .uniform_buffer_bit = true }, frame_pool);
 
     return .{
         .layout = global_set_layout,
-        .pool = descriptor_pool,
         .scene_param_buffer = scene_param_buffer,
         .object_set_layout = object_set_layout,
         .single_tex_layout = single_tex_layout,
     };
 }
 
-fn uploadMesh(gc: *const GraphicsContext, mesh: *Mesh, upload_context: UploadContext) !void {
-    const buffer_size = mesh.vertices.items.len * @sizeOf(Vertex);
+fn uploadMesh(gc: *const GraphicsContext, mesh: *Mesh, upload_context: UploadContext, arena: *GeometryArena) !void {
+    const zone = cpu_profiler.begin("upload mesh");
+    defer zone.end();
 
-    const staging_buffer = try createBuffer(gc, buffer_size, .{ .transfer_src_bit = true }, .cpu_only);
+    const vertex_bytes = std.mem.sliceAsBytes(mesh.vertices.items);
+    const index_bytes = std.mem.sliceAsBytes(mesh.indices.items);
+
+    // vertices and indices share one staging buffer, indices go right after the vertices
+    const staging_buffer = try createBuffer(gc, vertex_bytes.len + index_bytes.len, .{ .transfer_src_bit = true }, .cpu_only);
     defer staging_buffer.deinit(gc.allocator);
 
-    // copy vertex data
-    const verts = try gc.allocator.mapMemory(Vertex, staging_buffer.allocation);
-    std.mem.copy(Vertex, verts[0..mesh.vertices.items.len], mesh.vertices.items);
+    const data = try gc.allocator.mapMemory(u8, staging_buffer.allocation);
+    std.mem.copy(u8, data[0..vertex_bytes.len], vertex_bytes);
+    std.mem.copy(u8, data[vertex_bytes.len .. vertex_bytes.len + index_bytes.len], index_bytes);
     gc.allocator.unmapMemory(staging_buffer.allocation);
 
-    // create Mesh buffer
-    mesh.vert_buffer = try createBuffer(gc, buffer_size, .{ .vertex_buffer_bit = true, .transfer_dst_bit = true }, .gpu_only);
+    mesh.geometry = try arena.alloc(@intCast(u32, mesh.vertices.items.len), @intCast(u32, mesh.indices.items.len));
+    errdefer arena.free(mesh.geometry);
 
-    // execute the copy command on the GPU
+    // execute the copy commands on the GPU
     try upload_context.immediateSubmitBegin(gc);
-    const copy_region = vk.BufferCopy{
+    const vertex_region = vk.BufferCopy{
         .src_offset = 0,
-        .dst_offset = 0,
-        .size = buffer_size,
+        .dst_offset = mesh.geometry.vertexByteOffset(),
+        .size = vertex_bytes.len,
     };
-    gc.vkd.cmdCopyBuffer(upload_context.cmd_buf, staging_buffer.buffer, mesh.vert_buffer.buffer, 1, @ptrCast([*]const vk.BufferCopy, &copy_region));
+    gc.vkd.cmdCopyBuffer(upload_context.cmd_buf, staging_buffer.buffer, arena.vertex_buffer.buffer, 1, @ptrCast([*]const vk.BufferCopy, &vertex_region));
+
+    const index_region = vk.BufferCopy{
+        .src_offset = vertex_bytes.len,
+        .dst_offset = mesh.geometry.indexByteOffset(),
+        .size = index_bytes.len,
+    };
+    gc.vkd.cmdCopyBuffer(upload_context.cmd_buf, staging_buffer.buffer, arena.index_buffer.buffer, 1, @ptrCast([*]const vk.BufferCopy, &index_region));
     try upload_context.immediateSubmitEnd(gc);
 }
 
-fn loadTextureFromFile(gc: *const GraphicsContext, allocator: Allocator, file: []const u8, upload_context: UploadContext) !vma.AllocatedImage {
+fn loadTextureFromFile(gc: *const GraphicsContext, allocator: Allocator, file: []const u8, upload_context: UploadContext, texture_pool: vma.Pool) !struct { image: vma.AllocatedImage, info: vk.ImageCreateInfo } {
+    const zone = cpu_profiler.begin("load texture");
+    defer zone.end();
+
     const img = try stb.loadFromFile(allocator, file);
     defer img.deinit();
 
@@ -1185,11 +2245,21 @@ fn loadTextureFromFile(gc: *const GraphicsContext, allocator: Allocator, file: [
         .height = @intCast(u32, img.h),
         .depth = 1,
     };
-    const dimg_info = vkinit.imageCreateInfo(vk.Format.r8g8b8a8_srgb, img_extent, .{ .sampled_bit = true, .transfer_dst_bit = true });
+    const dimg_info = vkinit.imageCreateInfo(vk.Format.r8g8b8a8_srgb, img_extent, texture_image_usage);
+    const image = try gc.vkd.createImage(gc.dev, &dimg_info, null);
+    errdefer gc.vkd.destroyImage(gc.dev, image, null);
+
+    // the pool is picked from the real requirements, optimal tiling may pad the image well past its pixel size.
+    // Oversized images get a dedicated allocation from the default pools instead.
+    const requirements = gc.vkd.getImageMemoryRequirements(gc.dev, image);
     const malloc_info = std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{
         .usage = .gpu_only,
+        .pool = if (texture_pool.fitsRequirements(requirements)) texture_pool.pool else null,
     });
-    const new_img = try gc.allocator.createImage(&dimg_info, &malloc_info, null);
+    const allocation = try gc.allocator.allocateMemory(&requirements, &malloc_info);
+    errdefer gc.allocator.freeMemory(allocation);
+    try gc.allocator.bindImageMemory(allocation, image);
+    const new_img = vma.AllocatedImage{ .image = image, .allocation = allocation };
 
     try upload_context.immediateSubmitBegin(gc);
     {
@@ -1240,5 +2310,12 @@ fn loadTextureFromFile(gc: *const GraphicsContext, allocator: Allocator, file: [
     try upload_context.immediateSubmitEnd(gc);
 
     staging_buffer.deinit(gc.allocator);
-    return new_img;
+    return .{ .image = new_img, .info = dimg_info };
+}
+
+fn containsName(names: []const []const u8, name: []const u8) bool {
+    for (names) |n| {
+        if (std.mem.eql(u8, n, name)) return true;
+    }
+    return false;
 }
@@ -0,0 +1,106 @@
+const std = @import("std");
+const vk = @import("vulkan");
+const vma = @import("vma");
+const ig = @import("imgui");
+
+const Defragmenter = @import("../defragmenter.zig").Defragmenter;
+
+const mb: f32 = 1024 * 1024;
+
+/// imgui window showing VMA heap budgets and block/allocation statistics for the whole allocator and each custom pool
+pub fn drawMemoryPanel(allocator: vma.Allocator, pools: []const vma.Pool, defragmenter: ?*Defragmenter) void {
+    defer ig.igEnd();
+    if (!ig.igBegin("GPU Memory", null, ig.ImGuiWindowFlags_None)) return;
+
+    var buf: [256]u8 = undefined;
+    const mem_props = allocator.getMemoryProperties();
+
+    // budgets are cheap to query so they are always shown
+    var budget_storage: [vk.MAX_MEMORY_HEAPS]vma.VmaBudget = undefined;
+    const budgets = allocator.getHeapBudgets(&budget_storage);
+    for (budgets) |budget, i| {
+        const heap = mem_props.memory_heaps[i];
+        const device_local = if (heap.flags.device_local_bit) " (device local)" else "";
+        textFmt(&buf, "Heap {d}{s}: {d:.1} / {d:.1} MB", .{ i, device_local, @intToFloat(f32, budget.usage) / mb, @intToFloat(f32, budget.budget) / mb });
+
+        const fraction = if (budget.budget > 0) @intToFloat(f32, budget.usage) / @intToFloat(f32, budget.budget) else 0;
+        ig.igProgressBar(fraction, .{ .x = -1, .y = 0 }, null);
+    }
+
+    if (defragmenter) |defrag| {
+        if (defrag.isRunning()) {
+            ig.igTextUnformatted("Defragmenting...", null);
+        } else if (ig.igButton("Defragment", .{ .x = 0, .y = 0 })) {
+            defrag.start() catch |err| std.debug.print("failed to start defragmentation: {}\n", .{err});
+        }
+        textFmt(&buf, "Moved {d} allocations, freed {d:.2} MB", .{ defrag.total_stats.allocationsMoved, @intToFloat(f32, defrag.total_stats.bytesFreed) / mb });
+        const last = defrag.last_stats;
+        textFmt(&buf, "Last pool: {d} moved, {d:.2} MB and {d} blocks freed", .{ last.allocationsMoved, @intToFloat(f32, last.bytesFreed) / mb, last.deviceMemoryBlocksFreed });
+    }
+
+    if (!ig.igCollapsingHeader_TreeNodeFlags("Statistics", ig.ImGuiTreeNodeFlags_None)) return;
+
+    const stats = allocator.calculateStatistics();
+    textFmt(&buf, "Total: {d} blocks, {d} allocations", .{ stats.total.statistics.blockCount, stats.total.statistics.allocationCount });
+
+    const flags = ig.ImGuiTableFlags_Borders | ig.ImGuiTableFlags_RowBg | ig.ImGuiTableFlags_SizingFixedFit;
+    if (ig.igBeginTable("vma_heaps", 6, flags, .{ .x = 0, .y = 0 }, 0)) {
+        defer ig.igEndTable();
+
+        ig.igTableSetupColumn("Heap", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableSetupColumn("Blocks", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableSetupColumn("Allocs", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableSetupColumn("Block MB", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableSetupColumn("Used MB", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableSetupColumn("Free ranges", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableHeadersRow();
+
+        for (stats.memoryHeap[0..mem_props.memory_heap_count]) |heap_stats, i| {
+            detailedStatsRow(&buf, "{d}", .{i}, heap_stats);
+        }
+    }
+
+    if (pools.len == 0) return;
+    if (ig.igBeginTable("vma_pools", 6, flags, .{ .x = 0, .y = 0 }, 0)) {
+        defer ig.igEndTable();
+
+        ig.igTableSetupColumn("Pool", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableSetupColumn("Blocks", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableSetupColumn("Allocs", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableSetupColumn("Block MB", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableSetupColumn("Used MB", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableSetupColumn("Free ranges", ig.ImGuiTableColumnFlags_None, 0, 0);
+        ig.igTableHeadersRow();
+
+        for (pools) |pool| {
+            detailedStatsRow(&buf, "{s}", .{pool.name}, pool.calculateStatistics(allocator));
+        }
+    }
+}
+
+fn detailedStatsRow(buf: []u8, comptime label_fmt: []const u8, label_args: anytype, stats: vma.VmaDetailedStatistics) void {
+    ig.igTableNextRow(ig.ImGuiTableRowFlags_None, 0);
+    _ = ig.igTableNextColumn();
+    textFmt(buf, label_fmt, label_args);
+    _ = ig.igTableNextColumn();
+    textFmt(buf, "{d}", .{stats.statistics.blockCount});
+    _ = ig.igTableNextColumn();
+    textFmt(buf, "{d}", .{stats.statistics.allocationCount});
+    _ = ig.igTableNextColumn();
+    textFmt(buf, "{d:.2}", .{@intToFloat(f32, stats.statistics.blockBytes) / mb});
+    _ = ig.igTableNextColumn();
+    textFmt(buf, "{d:.2}", .{@intToFloat(f32, stats.statistics.allocationBytes) / mb});
+    _ = ig.igTableNextColumn();
+
+    // many free ranges with a small max size means the blocks are fragmented
+    if (stats.unusedRangeCount > 0) {
+        textFmt(buf, "{d} (max {d:.2} MB)", .{ stats.unusedRangeCount, @intToFloat(f32, stats.unusedRangeSizeMax) / mb });
+    } else {
+        textFmt(buf, "0", .{});
+    }
+}
+
+fn textFmt(buf: []u8, comptime fmt: []const u8, args: anytype) void {
+    const str = std.fmt.bufPrintZ(buf, fmt, args) catch return;
+    ig.igTextUnformatted(str.ptr, null);
+}
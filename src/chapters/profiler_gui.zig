@@ -0,0 +1,140 @@
+const std = @import("std");
+const ig = @import("imgui");
+
+const GpuProfiler = @import("../gpu_profiler.zig").GpuProfiler;
+const cpu_profiler = @import("../cpu_profiler.zig");
+
+/// threads beyond this share the last lane of the flame view
+const max_lanes = 16;
+
+/// imgui window with the GPU time of every profiler scope over the last `GpuProfiler.history_len` frames
+pub fn drawGpuProfiler(profiler: *const GpuProfiler) void {
+    defer ig.igEnd();
+    if (!ig.igBegin("GPU Profiler", null, ig.ImGuiWindowFlags_None)) return;
+
+    var buf: [256]u8 = undefined;
+    if (!profiler.enabled) {
+        ig.igTextUnformatted("timestamps are not supported by this device", null);
+        return;
+    }
+
+    const flags = ig.ImGuiTableFlags_Borders | ig.ImGuiTableFlags_RowBg | ig.ImGuiTableFlags_SizingFixedFit;
+    if (!ig.igBeginTable("gpu_scopes", 5, flags, .{ .x = 0, .y = 0 }, 0)) return;
+    defer ig.igEndTable();
+
+    ig.igTableSetupColumn("Scope", ig.ImGuiTableColumnFlags_None, 0, 0);
+    ig.igTableSetupColumn("Last ms", ig.ImGuiTableColumnFlags_None, 0, 0);
+    ig.igTableSetupColumn("Avg ms", ig.ImGuiTableColumnFlags_None, 0, 0);
+    ig.igTableSetupColumn("Max ms", ig.ImGuiTableColumnFlags_None, 0, 0);
+    ig.igTableSetupColumn("History", ig.ImGuiTableColumnFlags_None, 0, 0);
+    ig.igTableHeadersRow();
+
+    for (profiler.timings.items) |*timing| {
+        ig.igTableNextRow(ig.ImGuiTableRowFlags_None, 0);
+        _ = ig.igTableNextColumn();
+        // nested scopes are indented below their parent
+        const indent = @intToFloat(f32, timing.depth) * 10;
+        if (indent > 0) ig.igIndent(indent);
+        textFmt(&buf, "{s}", .{timing.name});
+        if (indent > 0) ig.igUnindent(indent);
+
+        const max = timing.max();
+        _ = ig.igTableNextColumn();
+        textFmt(&buf, "{d:.3}", .{timing.last()});
+        _ = ig.igTableNextColumn();
+        textFmt(&buf, "{d:.3}", .{timing.average()});
+        _ = ig.igTableNextColumn();
+        textFmt(&buf, "{d:.3}", .{max});
+
+        _ = ig.igTableNextColumn();
+        ig.igPushID_Ptr(timing);
+        defer ig.igPopID();
+        // oldest sample first once the history wrapped around
+        const offset = if (timing.count == GpuProfiler.history_len) timing.cursor else 0;
+        ig.igPlotLines_FloatPtr("", &timing.history, @intCast(c_int, timing.count), @intCast(c_int, offset), null, 0, max, .{ .x = 120, .y = 20 }, @sizeOf(f32));
+    }
+}
+
+/// imgui window with a flame view of the CPU zones of the last frame, one lane per thread. `events` is scratch space kept
+/// across frames.
+pub fn drawCpuProfiler(events: *std.ArrayList(cpu_profiler.Event), trace_path: []const u8) void {
+    defer ig.igEnd();
+    if (!ig.igBegin("CPU Profiler", null, ig.ImGuiWindowFlags_None)) return;
+
+    var buf: [256]u8 = undefined;
+    if (!cpu_profiler.enabled) {
+        ig.igTextUnformatted("built without -Dcpu_profiler=true", null);
+        return;
+    }
+
+    const frame = cpu_profiler.lastFrame();
+    if (frame[1] <= frame[0]) return;
+
+    events.clearRetainingCapacity();
+    cpu_profiler.collect(events, frame[0], frame[1]) catch return;
+
+    const frame_ns = @intToFloat(f32, frame[1] - frame[0]);
+    textFmt(&buf, "frame: {d:.2} ms, {d} zones", .{ frame_ns / std.time.ns_per_ms, events.items.len });
+    if (ig.igButton("Save trace", .{ .x = 0, .y = 0 })) {
+        cpu_profiler.writeChromeTrace(events.allocator, trace_path) catch |err| std.debug.print("failed writing trace to {s}: {}\n", .{ trace_path, err });
+    }
+
+    // every thread gets as many rows as its deepest zone needs
+    var lane_rows = [_]u32{0} ** max_lanes;
+    for (events.items) |event| {
+        const lane = std.math.min(event.thread, max_lanes - 1);
+        lane_rows[lane] = std.math.max(lane_rows[lane], @as(u32, event.depth) + 1);
+    }
+    var lane_first_row: [max_lanes]u32 = undefined;
+    var row_count: u32 = 0;
+    for (lane_rows) |rows, lane| {
+        lane_first_row[lane] = row_count;
+        row_count += rows;
+    }
+
+    var origin: ig.ImVec2 = undefined;
+    ig.igGetCursorScreenPos(&origin);
+    var avail: ig.ImVec2 = undefined;
+    ig.igGetContentRegionAvail(&avail);
+    const width = std.math.max(avail.x, 100);
+    const row_height = ig.igGetTextLineHeightWithSpacing();
+    const scale = width / frame_ns;
+    const draw_list = ig.igGetWindowDrawList();
+
+    for (events.items) |event| {
+        // zones are clipped to the frame, some started in the previous one or end in the next
+        const start = std.math.max(event.start_ns, frame[0]) - frame[0];
+        const end = std.math.min(event.end_ns, frame[1]) - frame[0];
+        const row = lane_first_row[std.math.min(event.thread, max_lanes - 1)] + event.depth;
+
+        const min = ig.ImVec2{ .x = origin.x + @intToFloat(f32, start) * scale, .y = origin.y + @intToFloat(f32, row) * row_height };
+        const max = ig.ImVec2{ .x = std.math.max(origin.x + @intToFloat(f32, end) * scale, min.x + 1), .y = min.y + row_height - 1 };
+        ig.ImDrawList_AddRectFilled(draw_list, min, max, zoneColor(event.name), 0, ig.ImDrawFlags_None);
+
+        ig.ImDrawList_PushClipRect(draw_list, min, max, true);
+        ig.ImDrawList_AddText_Vec2(draw_list, .{ .x = min.x + 2, .y = min.y }, 0xff000000, event.name, null);
+        ig.ImDrawList_PopClipRect(draw_list);
+
+        if (ig.igIsMouseHoveringRect(min, max, true)) {
+            const ms = @intToFloat(f64, event.end_ns - event.start_ns) / std.time.ns_per_ms;
+            ig.igSetTooltip("%s: %.3f ms", event.name, ms);
+        }
+    }
+
+    ig.igDummy(.{ .x = width, .y = @intToFloat(f32, row_count) * row_height });
+}
+
+/// a stable, light color per zone name so the same zone is easy to follow between frames
+fn zoneColor(name: [*:0]const u8) ig.ImU32 {
+    const hash = std.hash.Wyhash.hash(0, std.mem.span(name));
+    const r = 0x80 | @truncate(u32, hash & 0x7f);
+    const g = 0x80 | @truncate(u32, (hash >> 8) & 0x7f);
+    const b = 0x80 | @truncate(u32, (hash >> 16) & 0x7f);
+    // ImGui colors are ABGR
+    return 0xff000000 | (b << 16) | (g << 8) | r;
+}
+
+fn textFmt(buf: []u8, comptime fmt: []const u8, args: anytype) void {
+    const str = std.fmt.bufPrintZ(buf, fmt, args) catch return;
+    ig.igTextUnformatted(str.ptr, null);
+}
@@ -0,0 +1,230 @@
+const std = @import("std");
+const build_options = @import("build_options");
+
+/// Scoped CPU zones for attributing frame time, recorded per thread into a ring buffer of the last `capacity` zones:
+///
+///     const zone = cpu_profiler.begin("draw");
+///     defer zone.end();
+///
+/// Only enabled with `-Dcpu_profiler=true`. Otherwise `begin` and `end` are empty and compile away, so zones can stay in
+/// hot paths. Zone names have to be comptime known so recording never copies a string.
+pub const enabled = build_options.cpu_profiler;
+
+/// zones kept per thread
+pub const capacity = 16 * 1024;
+/// zones nested deeper than this are not recorded
+const max_depth = 32;
+
+pub const Event = struct {
+    name: [*:0]const u8,
+    /// nanoseconds since `init`
+    start_ns: u64,
+    end_ns: u64,
+    thread: u32,
+    depth: u8,
+};
+
+pub const Zone = struct {
+    pub fn end(self: Zone) void {
+        _ = self;
+        if (enabled) endZone();
+    }
+};
+
+const OpenZone = struct {
+    name: [*:0]const u8,
+    start_ns: u64,
+};
+
+const ThreadBuffer = struct {
+    id: u32,
+    /// only the owning thread touches the open zones, `events` is also read by `collect` and the trace export
+    open: [max_depth]OpenZone = undefined,
+    depth: u32 = 0,
+    lock: std.Thread.Mutex = .{},
+    events: [capacity]Event = undefined,
+    /// total zones ended on this thread, the ring holds the last `capacity` of them
+    written: usize = 0,
+
+    fn oldest(self: ThreadBuffer) usize {
+        return if (self.written > capacity) self.written - capacity else 0;
+    }
+};
+
+threadlocal var thread_buffer: ?*ThreadBuffer = null;
+
+var registry_lock = std.Thread.Mutex{};
+var buffers: std.ArrayListUnmanaged(*ThreadBuffer) = .{};
+/// thread buffers are never freed while threads may still record into them, only by `deinit`
+const buffer_allocator = std.heap.page_allocator;
+
+var epoch: i128 = 0;
+/// start and end of the last frame completed by `frameMark`
+var last_frame = [2]u64{ 0, 0 };
+var frame_start_ns: u64 = 0;
+
+/// starts the clock zones are timed against
+pub fn init() void {
+    if (!enabled) return;
+    epoch = std.time.nanoTimestamp();
+    frame_start_ns = 0;
+}
+
+/// frees every thread's ring buffer. No zones may be recorded afterwards.
+pub fn deinit() void {
+    if (!enabled) return;
+
+    registry_lock.lock();
+    defer registry_lock.unlock();
+    for (buffers.items) |buffer| buffer_allocator.destroy(buffer);
+    buffers.deinit(buffer_allocator);
+    buffers = .{};
+    thread_buffer = null;
+}
+
+pub fn begin(comptime name: [:0]const u8) Zone {
+    if (enabled) beginZone(name);
+    return .{};
+}
+
+/// ends the current frame, called once per frame by the thread running the frame loop
+pub fn frameMark() void {
+    if (!enabled) return;
+
+    const now_ns = now();
+    last_frame = .{ frame_start_ns, now_ns };
+    frame_start_ns = now_ns;
+}
+
+/// start and end of the last complete frame, in nanoseconds since `init`
+pub fn lastFrame() [2]u64 {
+    return last_frame;
+}
+
+/// appends every recorded zone overlapping `start_ns..end_ns` to `out`, thread by thread
+pub fn collect(out: *std.ArrayList(Event), start_ns: u64, end_ns: u64) !void {
+    if (!enabled) return;
+
+    registry_lock.lock();
+    defer registry_lock.unlock();
+    for (buffers.items) |buffer| {
+        buffer.lock.lock();
+        defer buffer.lock.unlock();
+
+        var i = buffer.oldest();
+        while (i < buffer.written) : (i += 1) {
+            const event = buffer.events[i % capacity];
+            if (event.end_ns >= start_ns and event.start_ns <= end_ns) try out.append(event);
+        }
+    }
+}
+
+/// writes every recorded zone as Chrome trace event JSON, viewable in chrome://tracing or Perfetto
+pub fn writeChromeTrace(allocator: std.mem.Allocator, path: []const u8) !void {
+    var events = std.ArrayList(Event).init(allocator);
+    defer events.deinit();
+    try collect(&events, 0, std.math.maxInt(u64));
+
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+
+    var buffered = std.io.bufferedWriter(file.writer());
+    const writer = buffered.writer();
+    try writer.writeAll("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    var thread_count: u32 = 0;
+    for (events.items) |event| thread_count = std.math.max(thread_count, event.thread + 1);
+    var thread: u32 = 0;
+    while (thread < thread_count) : (thread += 1) {
+        try writer.print("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{d},\"args\":{{\"name\":\"{s} {d}\"}}}},\n", .{ thread, if (thread == 0) "main" else "thread", thread });
+    }
+
+    // complete events, timestamps are in microseconds
+    for (events.items) |event, i| {
+        try writer.writeAll("{\"name\":");
+        try std.json.stringify(std.mem.span(event.name), .{}, writer);
+        try writer.print(",\"ph\":\"X\",\"pid\":0,\"tid\":{d},\"ts\":{d:.3},\"dur\":{d:.3}}}", .{
+            event.thread,
+            @intToFloat(f64, event.start_ns) / std.time.ns_per_us,
+            @intToFloat(f64, event.end_ns - event.start_ns) / std.time.ns_per_us,
+        });
+        try writer.writeAll(if (i + 1 < events.items.len) ",\n" else "\n");
+    }
+
+    try writer.writeAll("]}\n");
+    try buffered.flush();
+}
+
+fn now() u64 {
+    return @intCast(u64, std.math.max(std.time.nanoTimestamp() - epoch, 0));
+}
+
+/// null if the buffer could not be allocated, the thread then records nothing
+fn threadBuffer() ?*ThreadBuffer {
+    if (thread_buffer) |buffer| return buffer;
+
+    registry_lock.lock();
+    defer registry_lock.unlock();
+
+    const buffer = buffer_allocator.create(ThreadBuffer) catch return null;
+    buffer.* = .{ .id = @intCast(u32, buffers.items.len) };
+    buffers.append(buffer_allocator, buffer) catch {
+        buffer_allocator.destroy(buffer);
+        return null;
+    };
+
+    thread_buffer = buffer;
+    return buffer;
+}
+
+fn beginZone(name: [*:0]const u8) void {
+    const buffer = threadBuffer() orelse return;
+    if (buffer.depth < max_depth) buffer.open[buffer.depth] = .{ .name = name, .start_ns = now() };
+    buffer.depth += 1;
+}
+
+fn endZone() void {
+    const buffer = thread_buffer orelse return;
+    buffer.depth -= 1;
+    if (buffer.depth >= max_depth) return;
+
+    const open = buffer.open[buffer.depth];
+    const event = Event{
+        .name = open.name,
+        .start_ns = open.start_ns,
+        .end_ns = now(),
+        .thread = buffer.id,
+        .depth = @intCast(u8, buffer.depth),
+    };
+
+    buffer.lock.lock();
+    defer buffer.lock.unlock();
+    buffer.events[buffer.written % capacity] = event;
+    buffer.written += 1;
+}
+
+test "nested zones" {
+    if (!enabled) return error.SkipZigTest;
+
+    init();
+    defer deinit();
+    {
+        const outer = begin("outer");
+        defer outer.end();
+        const inner = begin("inner");
+        inner.end();
+    }
+
+    var events = std.ArrayList(Event).init(std.testing.allocator);
+    defer events.deinit();
+    try collect(&events, 0, std.math.maxInt(u64));
+
+    // zones are recorded when they end
+    try std.testing.expectEqual(@as(usize, 2), events.items.len);
+    try std.testing.expectEqualStrings("inner", std.mem.span(events.items[0].name));
+    try std.testing.expectEqual(@as(u8, 1), events.items[0].depth);
+    try std.testing.expectEqualStrings("outer", std.mem.span(events.items[1].name));
+    try std.testing.expectEqual(@as(u8, 0), events.items[1].depth);
+    try std.testing.expect(events.items[1].start_ns <= events.items[0].start_ns);
+    try std.testing.expect(events.items[1].end_ns >= events.items[0].end_ns);
+}
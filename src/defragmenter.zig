@@ -0,0 +1,358 @@
+const std = @import("std");
+const vk = @import("vulkan");
+const vma = @import("vma");
+const vkinit = @import("vkinit.zig");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+const Allocator = std.mem.Allocator;
+
+/// a resource the Defragmenter is allowed to relocate. The pointers must stay valid for as long as the resource is tracked.
+pub const Movable = union(enum) {
+    buffer: struct {
+        handle: *vma.AllocatedBuffer,
+        size: vk.DeviceSize,
+        usage: vk.BufferUsageFlags,
+    },
+    image: struct {
+        handle: *vma.AllocatedImage,
+        view: ?*vk.ImageView,
+        info: vk.ImageCreateInfo,
+        layout: vk.ImageLayout,
+        aspect_mask: vk.ImageAspectFlags,
+    },
+};
+
+/// called right after a Movable got its new handles so that anything caching them (descriptor sets) can be patched
+pub const MoveListener = struct {
+    ctx: *anyopaque,
+    func: fn (ctx: *anyopaque, defragmenter: *Defragmenter, movable: *const Movable) anyerror!void,
+};
+
+/// Incremental VMA defragmentation. Each frame at most one pass of `max_moves_per_pass` moves is recorded into the frame's
+/// command buffer. Allocations that are not tracked (no user data) are left alone. The pass is only ended, and the old
+/// resources destroyed, once the frame that recorded it is no longer in flight so no frame ever stalls on the copies.
+/// A run visits the default pools first and then every pool registered with `addPool`, one after the other.
+pub const Defragmenter = struct {
+    /// enough for a 32k texture
+    const max_mip_levels = 16;
+
+    pub const Retired = union(enum) {
+        buffer: vk.Buffer,
+        image: vk.Image,
+        image_view: vk.ImageView,
+    };
+
+    gc: *const GraphicsContext,
+    allocator: Allocator,
+    movables: std.ArrayList(*Movable),
+    retired: std.ArrayList(Retired),
+    /// null stands for the default pools
+    pools: std.ArrayList(?vma.Pool),
+    pool_index: usize = 0,
+    listener: ?MoveListener = null,
+    context: ?vma.DefragmentationContext = null,
+    pass: vma.VmaDefragmentationPassMoveInfo = undefined,
+    pass_frame: ?usize = null,
+    max_moves_per_pass: u32 = 16,
+    max_bytes_per_pass: vk.DeviceSize = 16 * 1024 * 1024,
+    /// fraction of free bytes inside the blocks of the `addPool` pools that kicks off a defragmentation. 0 disables auto
+    /// defragmentation.
+    auto_threshold: f32 = 0.3,
+    check_interval: usize = 300,
+    total_stats: vma.VmaDefragmentationStats = std.mem.zeroes(vma.VmaDefragmentationStats),
+    /// stats of the last pool that finished defragmenting
+    last_stats: vma.VmaDefragmentationStats = std.mem.zeroes(vma.VmaDefragmentationStats),
+
+    pub fn init(gc: *const GraphicsContext, allocator: Allocator) Defragmenter {
+        return .{
+            .gc = gc,
+            .allocator = allocator,
+            .movables = std.ArrayList(*Movable).init(allocator),
+            .pools = std.ArrayList(?vma.Pool).init(allocator),
+            .retired = std.ArrayList(Retired).init(allocator),
+        };
+    }
+
+    /// the device must be idle. Any in-progress pass is finished so all tracked handles are valid afterwards.
+    pub fn deinit(self: *Defragmenter) void {
+        if (self.context != null) {
+            if (self.pass_frame != null) self.finishPass() catch {};
+            self.endContext();
+        }
+
+        for (self.movables.items) |movable| {
+            self.gc.allocator.setAllocationUserData(allocationOf(movable), null);
+            self.allocator.destroy(movable);
+        }
+        self.movables.deinit();
+        self.pools.deinit();
+        self.retired.deinit();
+    }
+
+    /// linear pools cannot be defragmented so they must not be added
+    pub fn addPool(self: *Defragmenter, pool: vma.Pool) !void {
+        if (self.pools.items.len == 0) try self.pools.append(null);
+        try self.pools.append(pool);
+    }
+
+    pub fn trackBuffer(self: *Defragmenter, buffer: *vma.AllocatedBuffer, size: vk.DeviceSize, usage: vk.BufferUsageFlags) !void {
+        try self.track(.{ .buffer = .{ .handle = buffer, .size = size, .usage = usage } });
+    }
+
+    pub fn trackImage(self: *Defragmenter, image: *vma.AllocatedImage, view: ?*vk.ImageView, info: vk.ImageCreateInfo, layout: vk.ImageLayout, aspect_mask: vk.ImageAspectFlags) !void {
+        try self.track(.{ .image = .{ .handle = image, .view = view, .info = info, .layout = layout, .aspect_mask = aspect_mask } });
+    }
+
+    fn track(self: *Defragmenter, movable: Movable) !void {
+        const ptr = try self.allocator.create(Movable);
+        errdefer self.allocator.destroy(ptr);
+        ptr.* = movable;
+
+        try self.movables.append(ptr);
+        self.gc.allocator.setAllocationUserData(allocationOf(ptr), ptr);
+    }
+
+    /// queues a handle that may still be referenced by frames in flight. It is destroyed when the current pass ends.
+    pub fn retire(self: *Defragmenter, retired: Retired) !void {
+        try self.retired.append(retired);
+    }
+
+    pub fn isRunning(self: Defragmenter) bool {
+        return self.context != null;
+    }
+
+    pub fn start(self: *Defragmenter) !void {
+        if (self.context != null) return;
+        self.pool_index = 0;
+        try self.beginPool();
+    }
+
+    fn beginPool(self: *Defragmenter) !void {
+        const pool: vma.VmaPool = if (self.pools.items.len > 0 and self.pools.items[self.pool_index] != null) self.pools.items[self.pool_index].?.pool else null;
+        const info = std.mem.zeroInit(vma.VmaDefragmentationInfo, .{
+            .flags = vma.VMA_DEFRAGMENTATION_FLAG_ALGORITHM_FAST_BIT,
+            .pool = pool,
+            .maxBytesPerPass = self.max_bytes_per_pass,
+            .maxAllocationsPerPass = self.max_moves_per_pass,
+        });
+        self.context = try self.gc.allocator.beginDefragmentation(&info);
+    }
+
+    /// call once per frame after the frame's fence was waited on, with `cmdbuf` recording and outside of a render pass.
+    /// `frames_in_flight` is how many frames can be queued on the GPU at once.
+    pub fn update(self: *Defragmenter, cmdbuf: vk.CommandBuffer, frame_index: usize, frames_in_flight: usize) !void {
+        if (self.context == null) {
+            if (self.auto_threshold > 0 and frame_index % self.check_interval == 0 and self.isFragmented()) try self.start();
+            if (self.context == null) return;
+        }
+
+        if (self.pass_frame) |pass_frame| {
+            // the frame that recorded the copies may still be executing
+            if (frame_index < pass_frame + frames_in_flight) return;
+            if (!try self.finishPass()) {
+                try self.endDefragmentation();
+                return;
+            }
+        }
+
+        if (!try self.context.?.beginPass(&self.pass)) {
+            try self.endDefragmentation();
+            return;
+        }
+
+        try self.recordMoves(cmdbuf);
+        self.pass_frame = frame_index;
+    }
+
+    /// only measures the pools registered with `addPool`. VMA cannot report the default pools apart from custom pools that
+    /// are never defragmented, like the linear per-frame pool, which are mostly empty by design.
+    fn isFragmented(self: Defragmenter) bool {
+        var total = std.mem.zeroes(vma.VmaStatistics);
+        for (self.pools.items) |maybe_pool| {
+            const pool = maybe_pool orelse continue;
+            const stats = pool.calculateStatistics(self.gc.allocator).statistics;
+            total.blockCount += stats.blockCount;
+            total.blockBytes += stats.blockBytes;
+            total.allocationBytes += stats.allocationBytes;
+        }
+        if (total.blockCount < 2 or total.blockBytes == 0) return false;
+
+        const free_bytes = total.blockBytes - total.allocationBytes;
+        return @intToFloat(f32, free_bytes) / @intToFloat(f32, total.blockBytes) > self.auto_threshold;
+    }
+
+    fn recordMoves(self: *Defragmenter, cmdbuf: vk.CommandBuffer) !void {
+        const moves = self.pass.pMoves[0..self.pass.moveCount];
+        for (moves) |*move| {
+            const info = self.gc.allocator.getAllocationInfo(move.srcAllocation);
+            const movable = @ptrCast(?*Movable, @alignCast(@alignOf(Movable), info.pUserData)) orelse {
+                move.operation = vma.VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                continue;
+            };
+
+            switch (movable.*) {
+                .buffer => |buf| try self.moveBuffer(cmdbuf, buf.handle, buf.size, buf.usage, move.dstTmpAllocation),
+                .image => |img| try self.moveImage(cmdbuf, img.handle, img.view, img.info, img.layout, img.aspect_mask, move.dstTmpAllocation),
+            }
+
+            if (self.listener) |listener| try listener.func(listener.ctx, self, movable);
+        }
+    }
+
+    fn moveBuffer(self: *Defragmenter, cmdbuf: vk.CommandBuffer, handle: *vma.AllocatedBuffer, size: vk.DeviceSize, usage: vk.BufferUsageFlags, dst: vma.VmaAllocation) !void {
+        const gc = self.gc;
+        const new_buffer = try gc.vkd.createBuffer(gc.dev, &std.mem.zeroInit(vk.BufferCreateInfo, .{
+            .flags = .{},
+            .size = size,
+            .usage = usage,
+        }), null);
+        errdefer gc.vkd.destroyBuffer(gc.dev, new_buffer, null);
+        try gc.allocator.bindBufferMemory(dst, new_buffer);
+
+        const region = vk.BufferCopy{ .src_offset = 0, .dst_offset = 0, .size = size };
+        gc.vkd.cmdCopyBuffer(cmdbuf, handle.buffer, new_buffer, 1, @ptrCast([*]const vk.BufferCopy, &region));
+
+        // later commands in this frame may already consume the new buffer
+        const barrier = std.mem.zeroInit(vk.BufferMemoryBarrier, .{
+            .src_access_mask = .{ .transfer_write_bit = true },
+            .dst_access_mask = .{ .vertex_attribute_read_bit = true, .index_read_bit = true, .shader_read_bit = true },
+            .src_queue_family_index = vk.QUEUE_FAMILY_IGNORED,
+            .dst_queue_family_index = vk.QUEUE_FAMILY_IGNORED,
+            .buffer = new_buffer,
+            .offset = 0,
+            .size = vk.WHOLE_SIZE,
+        });
+        gc.vkd.cmdPipelineBarrier(cmdbuf, .{ .transfer_bit = true }, .{ .vertex_input_bit = true, .vertex_shader_bit = true }, .{}, 0, undefined, 1, @ptrCast([*]const vk.BufferMemoryBarrier, &barrier), 0, undefined);
+
+        try self.retire(.{ .buffer = handle.buffer });
+        handle.buffer = new_buffer;
+    }
+
+    fn moveImage(self: *Defragmenter, cmdbuf: vk.CommandBuffer, handle: *vma.AllocatedImage, view: ?*vk.ImageView, info: vk.ImageCreateInfo, layout: vk.ImageLayout, aspect_mask: vk.ImageAspectFlags, dst: vma.VmaAllocation) !void {
+        const gc = self.gc;
+        var create_info = info;
+        create_info.usage.transfer_dst_bit = true;
+
+        const new_image = try gc.vkd.createImage(gc.dev, &create_info, null);
+        errdefer gc.vkd.destroyImage(gc.dev, new_image, null);
+        try gc.allocator.bindImageMemory(dst, new_image);
+
+        const range = vk.ImageSubresourceRange{
+            .aspect_mask = aspect_mask,
+            .base_mip_level = 0,
+            .level_count = info.mip_levels,
+            .base_array_layer = 0,
+            .layer_count = info.array_layers,
+        };
+
+        const to_transfer = [_]vk.ImageMemoryBarrier{
+            std.mem.zeroInit(vk.ImageMemoryBarrier, .{
+                .src_access_mask = .{ .shader_read_bit = true },
+                .dst_access_mask = .{ .transfer_read_bit = true },
+                .old_layout = layout,
+                .new_layout = .transfer_src_optimal,
+                .src_queue_family_index = vk.QUEUE_FAMILY_IGNORED,
+                .dst_queue_family_index = vk.QUEUE_FAMILY_IGNORED,
+                .image = handle.image,
+                .subresource_range = range,
+            }),
+            std.mem.zeroInit(vk.ImageMemoryBarrier, .{
+                .dst_access_mask = .{ .transfer_write_bit = true },
+                .old_layout = .@"undefined",
+                .new_layout = .transfer_dst_optimal,
+                .src_queue_family_index = vk.QUEUE_FAMILY_IGNORED,
+                .dst_queue_family_index = vk.QUEUE_FAMILY_IGNORED,
+                .image = new_image,
+                .subresource_range = range,
+            }),
+        };
+        gc.vkd.cmdPipelineBarrier(cmdbuf, .{ .fragment_shader_bit = true }, .{ .transfer_bit = true }, .{}, 0, undefined, 0, undefined, to_transfer.len, &to_transfer);
+
+        // one region per mip level, each half the size of the previous one
+        std.debug.assert(info.mip_levels <= max_mip_levels);
+        var regions: [max_mip_levels]vk.ImageCopy = undefined;
+        for (regions[0..info.mip_levels]) |*region, mip| {
+            const subresource = vk.ImageSubresourceLayers{
+                .aspect_mask = aspect_mask,
+                .mip_level = @intCast(u32, mip),
+                .base_array_layer = 0,
+                .layer_count = info.array_layers,
+            };
+            region.* = .{
+                .src_subresource = subresource,
+                .src_offset = std.mem.zeroes(vk.Offset3D),
+                .dst_subresource = subresource,
+                .dst_offset = std.mem.zeroes(vk.Offset3D),
+                .extent = .{
+                    .width = std.math.max(info.extent.width >> @intCast(u5, mip), 1),
+                    .height = std.math.max(info.extent.height >> @intCast(u5, mip), 1),
+                    .depth = std.math.max(info.extent.depth >> @intCast(u5, mip), 1),
+                },
+            };
+        }
+        gc.vkd.cmdCopyImage(cmdbuf, handle.image, .transfer_src_optimal, new_image, .transfer_dst_optimal, info.mip_levels, &regions);
+
+        const to_readable = std.mem.zeroInit(vk.ImageMemoryBarrier, .{
+            .src_access_mask = .{ .transfer_write_bit = true },
+            .dst_access_mask = .{ .shader_read_bit = true },
+            .old_layout = .transfer_dst_optimal,
+            .new_layout = layout,
+            .src_queue_family_index = vk.QUEUE_FAMILY_IGNORED,
+            .dst_queue_family_index = vk.QUEUE_FAMILY_IGNORED,
+            .image = new_image,
+            .subresource_range = range,
+        });
+        gc.vkd.cmdPipelineBarrier(cmdbuf, .{ .transfer_bit = true }, .{ .fragment_shader_bit = true }, .{}, 0, undefined, 0, undefined, 1, @ptrCast([*]const vk.ImageMemoryBarrier, &to_readable));
+
+        try self.retire(.{ .image = handle.image });
+        handle.image = new_image;
+
+        if (view) |v| {
+            const view_info = vkinit.imageViewCreateInfo(info.format, new_image, aspect_mask);
+            const new_view = try gc.vkd.createImageView(gc.dev, &view_info, null);
+            try self.retire(.{ .image_view = v.* });
+            v.* = new_view;
+        }
+    }
+
+    /// destroys everything retired during the pass and lets VMA swap the allocations over. Returns true if more passes are needed.
+    fn finishPass(self: *Defragmenter) !bool {
+        for (self.retired.items) |retired| {
+            switch (retired) {
+                .buffer => |buffer| self.gc.vkd.destroyBuffer(self.gc.dev, buffer, null),
+                .image => |image| self.gc.vkd.destroyImage(self.gc.dev, image, null),
+                .image_view => |view| self.gc.destroy(view),
+            }
+        }
+        self.retired.clearRetainingCapacity();
+
+        self.pass_frame = null;
+        return try self.context.?.endPass(&self.pass);
+    }
+
+    /// ends the current pool and moves on to the next one, if any
+    fn endDefragmentation(self: *Defragmenter) !void {
+        self.endContext();
+
+        self.pool_index += 1;
+        if (self.pool_index < self.pools.items.len) try self.beginPool();
+    }
+
+    fn endContext(self: *Defragmenter) void {
+        const stats = self.context.?.end();
+        self.context = null;
+
+        self.total_stats.bytesMoved += stats.bytesMoved;
+        self.total_stats.bytesFreed += stats.bytesFreed;
+        self.total_stats.allocationsMoved += stats.allocationsMoved;
+        self.total_stats.deviceMemoryBlocksFreed += stats.deviceMemoryBlocksFreed;
+        self.last_stats = stats;
+    }
+};
+
+fn allocationOf(movable: *const Movable) vma.VmaAllocation {
+    return switch (movable.*) {
+        .buffer => |buf| buf.handle.allocation,
+        .image => |img| img.handle.allocation,
+    };
+}
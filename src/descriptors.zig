@@ -0,0 +1,302 @@
+const std = @import("std");
+const vk = @import("vulkan");
+const vkinit = @import("vkinit.zig");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+const PipelineReflection = @import("spirv_reflect.zig").PipelineReflection;
+
+/// Hands out descriptor sets from a chain of pools. When a pool runs out a fresh one is started, so allocation only
+/// fails when the device is out of memory. Sets are never freed one by one: `reset` recycles every pool at once, which
+/// suits sets that live for a single frame, and an allocator that is never reset simply keeps its sets until `deinit`.
+pub const DescriptorAllocator = struct {
+    const sets_per_pool = 128;
+
+    /// descriptors of each type per pool, relative to `sets_per_pool`
+    const pool_ratios = [_]struct { @"type": vk.DescriptorType, ratio: f32 }{
+        .{ .@"type" = .uniform_buffer, .ratio = 1 },
+        .{ .@"type" = .uniform_buffer_dynamic, .ratio = 1 },
+        .{ .@"type" = .storage_buffer, .ratio = 1 },
+        .{ .@"type" = .storage_buffer_dynamic, .ratio = 0.5 },
+        .{ .@"type" = .combined_image_sampler, .ratio = 2 },
+        .{ .@"type" = .sampled_image, .ratio = 1 },
+        .{ .@"type" = .sampler, .ratio = 0.5 },
+        .{ .@"type" = .storage_image, .ratio = 0.5 },
+    };
+
+    gc: *const GraphicsContext,
+    current: vk.DescriptorPool = .null_handle,
+    /// pools sets were allocated from since the last reset, including `current`
+    used: std.ArrayList(vk.DescriptorPool),
+    /// reset pools waiting to be reused
+    free: std.ArrayList(vk.DescriptorPool),
+
+    pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator) DescriptorAllocator {
+        return .{
+            .gc = gc,
+            .used = std.ArrayList(vk.DescriptorPool).init(allocator),
+            .free = std.ArrayList(vk.DescriptorPool).init(allocator),
+        };
+    }
+
+    pub fn deinit(self: DescriptorAllocator) void {
+        for (self.used.items) |pool| self.gc.destroy(pool);
+        for (self.free.items) |pool| self.gc.destroy(pool);
+        self.used.deinit();
+        self.free.deinit();
+    }
+
+    pub fn allocate(self: *DescriptorAllocator, layout: vk.DescriptorSetLayout) !vk.DescriptorSet {
+        if (self.current == .null_handle) try self.nextPool();
+
+        return self.allocateFromCurrent(layout) catch |err| switch (err) {
+            error.FragmentedPool, error.OutOfPoolMemory => {
+                // a fresh pool can always fit a single set
+                try self.nextPool();
+                return try self.allocateFromCurrent(layout);
+            },
+            else => |e| return e,
+        };
+    }
+
+    /// frees every set allocated so far. None of them may still be in use by the GPU.
+    pub fn reset(self: *DescriptorAllocator) !void {
+        for (self.used.items) |pool| try self.gc.vkd.resetDescriptorPool(self.gc.dev, pool, .{});
+        try self.free.appendSlice(self.used.items);
+        self.used.clearRetainingCapacity();
+        self.current = .null_handle;
+    }
+
+    fn allocateFromCurrent(self: *DescriptorAllocator, layout: vk.DescriptorSetLayout) !vk.DescriptorSet {
+        var set: vk.DescriptorSet = undefined;
+        try self.gc.vkd.allocateDescriptorSets(self.gc.dev, &.{
+            .descriptor_pool = self.current,
+            .descriptor_set_count = 1,
+            .p_set_layouts = @ptrCast([*]const vk.DescriptorSetLayout, &layout),
+        }, @ptrCast([*]vk.DescriptorSet, &set));
+        return set;
+    }
+
+    fn nextPool(self: *DescriptorAllocator) !void {
+        try self.used.ensureUnusedCapacity(1);
+        const pool = self.free.popOrNull() orelse try createPool(self.gc);
+        self.used.appendAssumeCapacity(pool);
+        self.current = pool;
+    }
+
+    fn createPool(gc: *const GraphicsContext) !vk.DescriptorPool {
+        var sizes: [pool_ratios.len]vk.DescriptorPoolSize = undefined;
+        for (pool_ratios) |r, i| {
+            sizes[i] = .{
+                .@"type" = r.@"type",
+                .descriptor_count = @floatToInt(u32, r.ratio * sets_per_pool),
+            };
+        }
+
+        return try gc.vkd.createDescriptorPool(gc.dev, &.{
+            .flags = .{},
+            .max_sets = sets_per_pool,
+            .pool_size_count = sizes.len,
+            .p_pool_sizes = &sizes,
+        }, null);
+    }
+};
+
+/// Creates each distinct DescriptorSetLayout once. Layouts with the same bindings, in any order, share a handle, which
+/// also keeps pipeline layouts built from them compatible. The cache owns every layout it returns.
+pub const DescriptorLayoutCache = struct {
+    const Bindings = []const vk.DescriptorSetLayoutBinding;
+
+    const Context = struct {
+        pub fn hash(_: Context, bindings: Bindings) u64 {
+            var hasher = std.hash.Wyhash.init(0);
+            for (bindings) |b| {
+                std.hash.autoHash(&hasher, b.binding);
+                std.hash.autoHash(&hasher, b.descriptor_type);
+                std.hash.autoHash(&hasher, b.descriptor_count);
+                std.hash.autoHash(&hasher, b.stage_flags.toInt());
+            }
+            return hasher.final();
+        }
+
+        pub fn eql(_: Context, a: Bindings, b: Bindings) bool {
+            if (a.len != b.len) return false;
+            for (a) |x, i| {
+                const y = b[i];
+                if (x.binding != y.binding or x.descriptor_type != y.descriptor_type or x.descriptor_count != y.descriptor_count or
+                    x.stage_flags.toInt() != y.stage_flags.toInt() or x.p_immutable_samplers != y.p_immutable_samplers) return false;
+            }
+            return true;
+        }
+    };
+
+    const LayoutMap = std.HashMap(Bindings, vk.DescriptorSetLayout, Context, std.hash_map.default_max_load_percentage);
+
+    gc: *const GraphicsContext,
+    allocator: std.mem.Allocator,
+    /// keys are sorted copies of the bindings, owned by the cache
+    layouts: LayoutMap,
+
+    pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator) DescriptorLayoutCache {
+        return .{
+            .gc = gc,
+            .allocator = allocator,
+            .layouts = LayoutMap.init(allocator),
+        };
+    }
+
+    pub fn deinit(self: *DescriptorLayoutCache) void {
+        var iter = self.layouts.iterator();
+        while (iter.next()) |entry| {
+            self.gc.destroy(entry.value_ptr.*);
+            self.allocator.free(entry.key_ptr.*);
+        }
+        self.layouts.deinit();
+    }
+
+    /// returns the layout for `info`, creating it on first use. Extensions in `p_next` and flags are not part of the key,
+    /// layouts that need them must be created directly.
+    pub fn create(self: *DescriptorLayoutCache, info: *const vk.DescriptorSetLayoutCreateInfo) !vk.DescriptorSetLayout {
+        var stack_bindings: [16]vk.DescriptorSetLayoutBinding = undefined;
+        if (info.binding_count > stack_bindings.len) return error.TooManyBindings;
+
+        const bindings = stack_bindings[0..info.binding_count];
+        std.mem.copy(vk.DescriptorSetLayoutBinding, bindings, info.p_bindings[0..info.binding_count]);
+        std.sort.sort(vk.DescriptorSetLayoutBinding, bindings, {}, lessThan);
+
+        if (self.layouts.get(bindings)) |layout| return layout;
+
+        const key = try self.allocator.dupe(vk.DescriptorSetLayoutBinding, bindings);
+        errdefer self.allocator.free(key);
+
+        const layout = try self.gc.vkd.createDescriptorSetLayout(self.gc.dev, info, null);
+        errdefer self.gc.destroy(layout);
+
+        try self.layouts.put(key, layout);
+        return layout;
+    }
+
+    fn lessThan(_: void, a: vk.DescriptorSetLayoutBinding, b: vk.DescriptorSetLayoutBinding) bool {
+        return a.binding < b.binding;
+    }
+};
+
+/// Builds pipeline layouts from the SPIR-V of a pipelines shaders, so set counts, bindings and push constant ranges can
+/// not drift from what the shaders declare. Set layouts go through a DescriptorLayoutCache and pipeline layouts are
+/// deduplicated by their set layouts and push constant range, pipelines with the same interface share one layout. The
+/// cache owns every layout it returns.
+pub const PipelineLayoutCache = struct {
+    pub const max_sets = 4;
+
+    pub const SetBinding = struct { set: u32, binding: u32 };
+
+    pub const Options = struct {
+        /// buffers bound with a dynamic offset, which the shader can not express
+        dynamic_buffers: []const SetBinding = &.{},
+        /// layouts used as is for the set at their index instead of reflecting it. Sets shared by several pipelines need
+        /// one so they stay compatible, as do sets with runtime arrays whose size and flags are not in the shader.
+        sets: [max_sets]?vk.DescriptorSetLayout = [_]?vk.DescriptorSetLayout{null} ** max_sets,
+    };
+
+    const Key = struct {
+        sets: [max_sets]u64,
+        set_count: u32,
+        push_stages: u32,
+        push_size: u32,
+    };
+
+    gc: *const GraphicsContext,
+    allocator: std.mem.Allocator,
+    set_layouts: DescriptorLayoutCache,
+    layouts: std.AutoHashMap(Key, vk.PipelineLayout),
+
+    pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator) PipelineLayoutCache {
+        return .{
+            .gc = gc,
+            .allocator = allocator,
+            .set_layouts = DescriptorLayoutCache.init(gc, allocator),
+            .layouts = std.AutoHashMap(Key, vk.PipelineLayout).init(allocator),
+        };
+    }
+
+    pub fn deinit(self: *PipelineLayoutCache) void {
+        var iter = self.layouts.valueIterator();
+        while (iter.next()) |layout| self.gc.destroy(layout.*);
+        self.layouts.deinit();
+        self.set_layouts.deinit();
+    }
+
+    /// returns the layout matching the combined interface of the SPIR-V modules in `shaders`
+    pub fn create(self: *PipelineLayoutCache, shaders: []const []const u8, options: Options) !vk.PipelineLayout {
+        const reflection = try PipelineReflection.fromSpirv(self.allocator, shaders, null);
+        defer reflection.deinit(self.allocator);
+
+        var set_count = reflection.setCount();
+        for (options.sets) |layout, set| {
+            if (layout != null) set_count = std.math.max(set_count, @intCast(u32, set + 1));
+        }
+        if (set_count > max_sets) return error.TooManySets;
+
+        var key = Key{ .sets = [_]u64{0} ** max_sets, .set_count = set_count, .push_stages = 0, .push_size = 0 };
+        var set_layouts: [max_sets]vk.DescriptorSetLayout = undefined;
+        for (set_layouts[0..set_count]) |*layout, set| {
+            // sets the shaders skip still need a layout, reflecting them yields an empty one
+            layout.* = options.sets[set] orelse try self.reflectedSetLayout(reflection, @intCast(u32, set), options);
+            key.sets[set] = @enumToInt(layout.*);
+        }
+
+        var info = vkinit.pipelineLayoutCreateInfo();
+        info.set_layout_count = set_count;
+        info.p_set_layouts = &set_layouts;
+        if (reflection.push_constants) |*range| {
+            key.push_stages = range.stage_flags.toInt();
+            key.push_size = range.size;
+            info.push_constant_range_count = 1;
+            info.p_push_constant_ranges = @ptrCast([*]const vk.PushConstantRange, range);
+        }
+
+        if (self.layouts.get(key)) |layout| return layout;
+
+        try self.layouts.ensureUnusedCapacity(1);
+        const layout = try self.gc.vkd.createPipelineLayout(self.gc.dev, &info, null);
+        self.layouts.putAssumeCapacity(key, layout);
+        return layout;
+    }
+
+    /// the layout of one set as reflected from `shaders`, for allocating sets before any pipeline using them exists.
+    /// Only that set has to agree between the shaders.
+    pub fn createSetLayout(self: *PipelineLayoutCache, shaders: []const []const u8, set: u32, options: Options) !vk.DescriptorSetLayout {
+        const reflection = try PipelineReflection.fromSpirv(self.allocator, shaders, set);
+        defer reflection.deinit(self.allocator);
+        return try self.reflectedSetLayout(reflection, set, options);
+    }
+
+    fn reflectedSetLayout(self: *PipelineLayoutCache, reflection: PipelineReflection, set: u32, options: Options) !vk.DescriptorSetLayout {
+        const reflected = reflection.setBindings(set);
+        var bindings: [16]vk.DescriptorSetLayoutBinding = undefined;
+        if (reflected.len > bindings.len) return error.TooManyBindings;
+
+        for (reflected) |b, i| {
+            if (b.count == 0) return error.UnsizedDescriptorArray;
+            bindings[i] = vkinit.descriptorSetLayoutBinding(try bindingType(b.descriptor_type, set, b.binding, options), b.stages, b.binding);
+            bindings[i].descriptor_count = b.count;
+        }
+
+        return try self.set_layouts.create(&.{
+            .flags = .{},
+            .binding_count = @intCast(u32, reflected.len),
+            .p_bindings = &bindings,
+        });
+    }
+
+    fn bindingType(reflected: vk.DescriptorType, set: u32, binding: u32, options: Options) !vk.DescriptorType {
+        for (options.dynamic_buffers) |dynamic| {
+            if (dynamic.set != set or dynamic.binding != binding) continue;
+            return switch (reflected) {
+                .uniform_buffer => .uniform_buffer_dynamic,
+                .storage_buffer => .storage_buffer_dynamic,
+                else => error.NotABuffer,
+            };
+        }
+        return reflected;
+    }
+};
@@ -0,0 +1,31 @@
+const std = @import("std");
+
+/// Measures where a frame's time goes: how long the CPU blocked waiting for a frame slot and the swapchain, and how long
+/// the GPU spent on the frame's command buffer, as timed by the root scope of the `GpuProfiler`. Values are smoothed so
+/// they can be read off a UI.
+pub const FramePacing = struct {
+    /// weight of the newest sample in the moving averages
+    const smoothing = 0.1;
+
+    cpu_wait_ms: f32 = 0,
+    /// stays 0 without timestamp support
+    gpu_ms: f32 = 0,
+    frame_ms: f32 = 0,
+
+    pub fn addCpuWait(self: *FramePacing, seconds: f64) void {
+        self.cpu_wait_ms = smooth(self.cpu_wait_ms, @floatCast(f32, seconds * std.time.ms_per_s));
+    }
+
+    pub fn addGpuTime(self: *FramePacing, ms: f32) void {
+        self.gpu_ms = smooth(self.gpu_ms, ms);
+    }
+
+    pub fn addFrame(self: *FramePacing, seconds: f64) void {
+        self.frame_ms = smooth(self.frame_ms, @floatCast(f32, seconds * std.time.ms_per_s));
+    }
+
+    fn smooth(current: f32, sample: f32) f32 {
+        if (current == 0) return sample;
+        return current + (sample - current) * smoothing;
+    }
+};
@@ -0,0 +1,136 @@
+const std = @import("std");
+
+/// the six clip planes of a view-projection matrix as (normal, distance). A point p is inside a plane when
+/// dot(normal, p) + distance >= 0.
+pub const Frustum = struct {
+    planes: [6][4]f32,
+
+    /// Gribb/Hartmann plane extraction. `m` is column major ([col][row]) and uses -1..1 clip space depth like Mat4.createPerspective.
+    pub fn fromViewProj(m: [4][4]f32) Frustum {
+        var frustum: Frustum = undefined;
+        const combos = [6]struct { row: usize, sign: f32 }{
+            .{ .row = 0, .sign = 1 }, // left
+            .{ .row = 0, .sign = -1 }, // right
+            .{ .row = 1, .sign = 1 }, // bottom
+            .{ .row = 1, .sign = -1 }, // top
+            .{ .row = 2, .sign = 1 }, // near
+            .{ .row = 2, .sign = -1 }, // far
+        };
+
+        for (combos) |combo, i| {
+            var plane: [4]f32 = undefined;
+            for (plane) |*p, col| p.* = m[col][3] + combo.sign * m[col][combo.row];
+
+            const len = std.math.sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            for (plane) |*p| p.* /= len;
+            frustum.planes[i] = plane;
+        }
+
+        return frustum;
+    }
+
+    pub fn containsSphere(self: Frustum, center: [3]f32, radius: f32) bool {
+        for (self.planes) |plane| {
+            if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius) return false;
+        }
+        return true;
+    }
+
+    /// appends the index of every sphere that is at least partially inside. `lanes` spheres are tested per plane with one
+    /// vector op; the remainder goes through `containsSphere`.
+    pub fn cullSpheres(self: Frustum, spheres: SphereList.Slice, visible: *std.ArrayList(u32)) !void {
+        const xs = spheres.items(.x);
+        const ys = spheres.items(.y);
+        const zs = spheres.items(.z);
+        const radii = spheres.items(.radius);
+        try visible.ensureUnusedCapacity(xs.len);
+
+        const V = @Vector(lanes, f32);
+        var i: usize = 0;
+        while (i + lanes <= xs.len) : (i += lanes) {
+            const x: V = xs[i..][0..lanes].*;
+            const y: V = ys[i..][0..lanes].*;
+            const z: V = zs[i..][0..lanes].*;
+            const r: V = radii[i..][0..lanes].*;
+
+            // smallest signed distance to any plane, pushed out by the radius. Negative means fully outside that plane.
+            var min_dist = @splat(lanes, std.math.inf(f32));
+            for (self.planes) |plane| {
+                const dist = x * @splat(lanes, plane[0]) + y * @splat(lanes, plane[1]) + z * @splat(lanes, plane[2]) + @splat(lanes, plane[3]);
+                min_dist = @minimum(min_dist, dist + r);
+            }
+
+            const inside: [lanes]bool = min_dist >= @splat(lanes, @as(f32, 0));
+            for (inside) |is_inside, lane| {
+                if (is_inside) visible.appendAssumeCapacity(@intCast(u32, i + lane));
+            }
+        }
+
+        while (i < xs.len) : (i += 1) {
+            if (self.containsSphere(.{ xs[i], ys[i], zs[i] }, radii[i])) visible.appendAssumeCapacity(@intCast(u32, i));
+        }
+    }
+};
+
+const lanes = 8;
+
+pub const Sphere = struct {
+    x: f32,
+    y: f32,
+    z: f32,
+    radius: f32,
+
+    /// world space bounds of a mesh with local bounding sphere `local` (xyz center, w radius) placed by `transform`. The sphere
+    /// is centered on the objects origin so it stays valid however the object spins around it.
+    pub fn fromTransform(transform: [4][4]f32, local: [4]f32) Sphere {
+        const center_dist = std.math.sqrt(local[0] * local[0] + local[1] * local[1] + local[2] * local[2]);
+
+        var scale: f32 = 0;
+        for (transform[0..3]) |col| scale = std.math.max(scale, std.math.sqrt(col[0] * col[0] + col[1] * col[1] + col[2] * col[2]));
+
+        return .{
+            .x = transform[3][0],
+            .y = transform[3][1],
+            .z = transform[3][2],
+            .radius = (center_dist + local[3]) * scale,
+        };
+    }
+};
+
+/// bounding spheres in SoA layout so `Frustum.cullSpheres` can load several of them into one vector
+pub const SphereList = std.MultiArrayList(Sphere);
+
+test "cullSpheres matches containsSphere" {
+    // identity view projection, so the frustum is the -1..1 cube
+    const identity = [4][4]f32{
+        .{ 1, 0, 0, 0 },
+        .{ 0, 1, 0, 0 },
+        .{ 0, 0, 1, 0 },
+        .{ 0, 0, 0, 1 },
+    };
+    const frustum = Frustum.fromViewProj(identity);
+
+    var spheres = SphereList{};
+    defer spheres.deinit(std.testing.allocator);
+
+    // more than one vector worth so the scalar tail runs too
+    var i: usize = 0;
+    while (i < lanes * 2 + 3) : (i += 1) {
+        const offset = @intToFloat(f32, i) * 0.5 - 3;
+        try spheres.append(std.testing.allocator, .{ .x = offset, .y = 0, .z = -offset * 0.5, .radius = 0.25 });
+    }
+
+    var visible = std.ArrayList(u32).init(std.testing.allocator);
+    defer visible.deinit();
+    try frustum.cullSpheres(spheres.slice(), &visible);
+
+    var expected = std.ArrayList(u32).init(std.testing.allocator);
+    defer expected.deinit();
+    for (spheres.items(.x)) |x, j| {
+        if (frustum.containsSphere(.{ x, spheres.items(.y)[j], spheres.items(.z)[j] }, spheres.items(.radius)[j])) try expected.append(@intCast(u32, j));
+    }
+
+    try std.testing.expect(visible.items.len > 0);
+    try std.testing.expect(visible.items.len < spheres.len);
+    try std.testing.expectEqualSlices(u32, expected.items, visible.items);
+}
@@ -0,0 +1,114 @@
+const std = @import("std");
+const vk = @import("vulkan");
+const vma = @import("vma");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+const Vertex = @import("mesh.zig").Vertex;
+
+/// One device local vertex buffer and one index buffer shared by all static meshes. Both are suballocated with a VMA
+/// virtual block measured in elements, so an Allocation maps directly onto the `vertex_offset`/`first_index` of an
+/// indexed draw and the buffers only need to be bound once per command buffer.
+pub const GeometryArena = struct {
+    pub const vertex_usage = vk.BufferUsageFlags{ .vertex_buffer_bit = true, .transfer_dst_bit = true };
+    pub const index_usage = vk.BufferUsageFlags{ .index_buffer_bit = true, .transfer_dst_bit = true };
+
+    pub const Allocation = struct {
+        vertices: vma.VmaVirtualAllocation,
+        indices: vma.VmaVirtualAllocation,
+        first_vertex: u32,
+        vertex_count: u32,
+        first_index: u32,
+        index_count: u32,
+
+        pub fn vertexByteOffset(self: Allocation) vk.DeviceSize {
+            return @as(vk.DeviceSize, self.first_vertex) * @sizeOf(Vertex);
+        }
+
+        pub fn indexByteOffset(self: Allocation) vk.DeviceSize {
+            return @as(vk.DeviceSize, self.first_index) * @sizeOf(u32);
+        }
+    };
+
+    gc: *const GraphicsContext,
+    vertex_buffer: vma.AllocatedBuffer,
+    index_buffer: vma.AllocatedBuffer,
+    vertex_block: vma.VirtualBlock,
+    index_block: vma.VirtualBlock,
+    max_vertices: u32,
+    max_indices: u32,
+
+    /// buffers come from `pool` when they fit into one of its blocks, otherwise from the default pools
+    pub fn init(gc: *const GraphicsContext, max_vertices: u32, max_indices: u32, pool: ?vma.Pool) !GeometryArena {
+        const vertex_buffer = try createBuffer(gc, @as(vk.DeviceSize, max_vertices) * @sizeOf(Vertex), vertex_usage, pool);
+        errdefer vertex_buffer.deinit(gc.allocator);
+
+        const index_buffer = try createBuffer(gc, @as(vk.DeviceSize, max_indices) * @sizeOf(u32), index_usage, pool);
+        errdefer index_buffer.deinit(gc.allocator);
+
+        const vertex_block = try vma.VirtualBlock.init(max_vertices);
+        errdefer vertex_block.deinit();
+
+        return GeometryArena{
+            .gc = gc,
+            .vertex_buffer = vertex_buffer,
+            .index_buffer = index_buffer,
+            .vertex_block = vertex_block,
+            .index_block = try vma.VirtualBlock.init(max_indices),
+            .max_vertices = max_vertices,
+            .max_indices = max_indices,
+        };
+    }
+
+    /// every Allocation must be freed first
+    pub fn deinit(self: GeometryArena) void {
+        self.vertex_block.deinit();
+        self.index_block.deinit();
+        self.vertex_buffer.deinit(self.gc.allocator);
+        self.index_buffer.deinit(self.gc.allocator);
+    }
+
+    /// reserves room for a mesh. The data still has to be copied to the returned byte offsets.
+    pub fn alloc(self: *GeometryArena, vertex_count: u32, index_count: u32) !Allocation {
+        const vertices = try self.vertex_block.allocate(vertex_count, 1);
+        errdefer self.vertex_block.free(vertices.allocation);
+
+        const indices = try self.index_block.allocate(index_count, 1);
+
+        return Allocation{
+            .vertices = vertices.allocation,
+            .vertex_count = vertex_count,
+            .first_vertex = @intCast(u32, vertices.offset),
+            .indices = indices.allocation,
+            .index_count = index_count,
+            .first_index = @intCast(u32, indices.offset),
+        };
+    }
+
+    /// the range must no longer be referenced by any frame in flight
+    pub fn free(self: *GeometryArena, allocation: Allocation) void {
+        self.vertex_block.free(allocation.vertices);
+        self.index_block.free(allocation.indices);
+    }
+
+    pub fn bind(self: GeometryArena, cmdbuf: vk.CommandBuffer) void {
+        const offset: vk.DeviceSize = 0;
+        self.gc.vkd.cmdBindVertexBuffers(cmdbuf, 0, 1, @ptrCast([*]const vk.Buffer, &self.vertex_buffer.buffer), @ptrCast([*]const vk.DeviceSize, &offset));
+        self.gc.vkd.cmdBindIndexBuffer(cmdbuf, self.index_buffer.buffer, 0, .uint32);
+    }
+};
+
+fn createBuffer(gc: *const GraphicsContext, size: vk.DeviceSize, usage: vk.BufferUsageFlags, pool: ?vma.Pool) !vma.AllocatedBuffer {
+    const buffer_info = std.mem.zeroInit(vk.BufferCreateInfo, .{
+        .flags = .{},
+        .size = size,
+        .usage = usage,
+    });
+
+    const use_pool = if (pool) |p| p.fits(size) else false;
+    const malloc_info = std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{
+        .usage = .gpu_only,
+        .pool = if (use_pool) pool.?.pool else null,
+    });
+
+    return try gc.allocator.createBuffer(&buffer_info, &malloc_info, null);
+}
@@ -0,0 +1,351 @@
+const std = @import("std");
+const vk = @import("vulkan");
+const vma = @import("vma");
+const vkinit = @import("vkinit.zig");
+const resources = @import("resources");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+const CommandBuffer = @import("vk_objs/command_buffer.zig").CommandBuffer;
+const Frustum = @import("frustum.zig").Frustum;
+const RenderQueue = @import("render_queue.zig").RenderQueue;
+
+/// per-object input of the cull shader, matches CullObject in cull.comp
+pub const CullObject = extern struct {
+    transform: [4][4]f32,
+    /// xyz center, w radius in mesh space
+    sphere: [4]f32,
+    /// the indirect command this object is an instance of
+    command: u32,
+    /// the objects index in the scene, seeds its spin
+    object_index: u32,
+    /// copied into the instance data for bindless texturing
+    texture_index: u32 = 0,
+    pad: u32 = 0,
+};
+
+/// small per-material values pushed before each draw, matches the push_constant block in tri_mesh_descriptors.vert. Mesh
+/// pipeline layouts reflect `range` from that block so these never need an object buffer write or a dynamic offset.
+pub const DrawPushConstants = extern struct {
+    /// multiplied into the vertex color
+    tint: [4]f32 = .{ 1, 1, 1, 1 },
+
+    pub const range = vk.PushConstantRange{
+        .stage_flags = .{ .vertex_bit = true },
+        .offset = 0,
+        .size = @sizeOf(DrawPushConstants),
+    };
+};
+
+/// a run of indirect commands that share pipeline and descriptor sets and are issued with a single drawIndexedIndirect
+pub const DrawGroup = struct {
+    pipeline: vk.Pipeline,
+    pipeline_layout: vk.PipelineLayout,
+    /// null_handle when the material has no textures
+    texture_set: vk.DescriptorSet,
+    push_constants: DrawPushConstants,
+    /// identifies what the caller built the group from, so it can find the group again e.g. to swap its pipeline
+    tag: usize = 0,
+    first_command: u32,
+    command_count: u32,
+};
+
+const PushConstants = extern struct {
+    planes: [6][4]f32,
+    angle: f32,
+    object_count: u32,
+};
+
+const workgroup_size = 256;
+
+/// GPU-driven drawing. Object transforms and bounds live in a static buffer, a compute shader frustum culls them every
+/// frame, writes the model matrices of the survivors into the frames object buffer and bumps the instance counts of the
+/// indirect commands. The CPU only records one dispatch and one indirect draw per DrawGroup, however many objects there are.
+pub const GpuDriven = struct {
+    gc: *const GraphicsContext,
+    set_layout: vk.DescriptorSetLayout,
+    pipeline_layout: vk.PipelineLayout,
+    pipeline: vk.Pipeline,
+    descriptor_pool: vk.DescriptorPool,
+    descriptor_sets: []vk.DescriptorSet,
+    /// one per frame, the cull shader writes the instance counts
+    command_buffers: []vma.AllocatedBuffer,
+    /// the commands with zeroed instance counts, copied over the frames commands before culling
+    command_template: ?vma.AllocatedBuffer = null,
+    objects: ?vma.AllocatedBuffer = null,
+    /// copy of what `objects` holds, so parts of it can be rewritten
+    object_data: std.ArrayListUnmanaged(CullObject) = .{},
+    object_count: u32 = 0,
+    command_count: u32 = 0,
+    groups: std.ArrayList(DrawGroup),
+
+    pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator, frame_count: usize, pipeline_cache: vk.PipelineCache) !GpuDriven {
+        const bindings = [_]vk.DescriptorSetLayoutBinding{
+            vkinit.descriptorSetLayoutBinding(.storage_buffer, .{ .compute_bit = true }, 0),
+            vkinit.descriptorSetLayoutBinding(.storage_buffer, .{ .compute_bit = true }, 1),
+            vkinit.descriptorSetLayoutBinding(.storage_buffer, .{ .compute_bit = true }, 2),
+        };
+        const set_layout = try gc.vkd.createDescriptorSetLayout(gc.dev, &.{
+            .flags = .{},
+            .binding_count = bindings.len,
+            .p_bindings = &bindings,
+        }, null);
+        errdefer gc.destroy(set_layout);
+
+        const push_constant_range = vk.PushConstantRange{
+            .stage_flags = .{ .compute_bit = true },
+            .offset = 0,
+            .size = @sizeOf(PushConstants),
+        };
+        var layout_info = vkinit.pipelineLayoutCreateInfo();
+        layout_info.set_layout_count = 1;
+        layout_info.p_set_layouts = @ptrCast([*]const vk.DescriptorSetLayout, &set_layout);
+        layout_info.push_constant_range_count = 1;
+        layout_info.p_push_constant_ranges = @ptrCast([*]const vk.PushConstantRange, &push_constant_range);
+        const pipeline_layout = try gc.vkd.createPipelineLayout(gc.dev, &layout_info, null);
+        errdefer gc.destroy(pipeline_layout);
+
+        const pipeline = try createCullPipeline(gc, pipeline_layout, pipeline_cache);
+        errdefer gc.destroy(pipeline);
+
+        const pool_size = vk.DescriptorPoolSize{
+            .@"type" = .storage_buffer,
+            .descriptor_count = @intCast(u32, bindings.len * frame_count),
+        };
+        const descriptor_pool = try gc.vkd.createDescriptorPool(gc.dev, &.{
+            .flags = .{},
+            .max_sets = @intCast(u32, frame_count),
+            .pool_size_count = 1,
+            .p_pool_sizes = @ptrCast([*]const vk.DescriptorPoolSize, &pool_size),
+        }, null);
+        errdefer gc.destroy(descriptor_pool);
+
+        const descriptor_sets = try allocator.alloc(vk.DescriptorSet, frame_count);
+        errdefer allocator.free(descriptor_sets);
+        for (descriptor_sets) |*set| {
+            try gc.vkd.allocateDescriptorSets(gc.dev, &.{
+                .descriptor_pool = descriptor_pool,
+                .descriptor_set_count = 1,
+                .p_set_layouts = @ptrCast([*]const vk.DescriptorSetLayout, &set_layout),
+            }, @ptrCast([*]vk.DescriptorSet, set));
+        }
+
+        const command_buffers = try allocator.alloc(vma.AllocatedBuffer, frame_count);
+        std.mem.set(vma.AllocatedBuffer, command_buffers, .{ .buffer = .null_handle, .allocation = null });
+
+        return GpuDriven{
+            .gc = gc,
+            .set_layout = set_layout,
+            .pipeline_layout = pipeline_layout,
+            .pipeline = pipeline,
+            .descriptor_pool = descriptor_pool,
+            .descriptor_sets = descriptor_sets,
+            .command_buffers = command_buffers,
+            .groups = std.ArrayList(DrawGroup).init(allocator),
+        };
+    }
+
+    pub fn deinit(self: *GpuDriven) void {
+        self.destroySceneBuffers();
+
+        const allocator = self.groups.allocator;
+        self.object_data.deinit(allocator);
+        self.groups.deinit();
+        allocator.free(self.command_buffers);
+        allocator.free(self.descriptor_sets);
+
+        self.gc.destroy(self.descriptor_pool);
+        self.gc.destroy(self.pipeline);
+        self.gc.destroy(self.pipeline_layout);
+        self.gc.destroy(self.set_layout);
+    }
+
+    /// uploads the scene. `commands` must have zero instance counts and their first_instance ranges must cover every object
+    /// that references them. `instance_buffers` are the per-frame object buffers the vertex shader reads. No frame may be in flight.
+    pub fn build(self: *GpuDriven, objects: []const CullObject, commands: []const vk.DrawIndexedIndirectCommand, groups: []const DrawGroup, instance_buffers: []const vk.Buffer) !void {
+        std.debug.assert(instance_buffers.len == self.descriptor_sets.len);
+        self.destroySceneBuffers();
+
+        self.objects = try createHostBuffer(self.gc, std.mem.sliceAsBytes(objects), .{ .storage_buffer_bit = true, .transfer_dst_bit = true });
+        self.command_template = try createHostBuffer(self.gc, std.mem.sliceAsBytes(commands), .{ .transfer_src_bit = true });
+        self.object_count = @intCast(u32, objects.len);
+        self.command_count = @intCast(u32, commands.len);
+
+        self.object_data.clearRetainingCapacity();
+        try self.object_data.appendSlice(self.groups.allocator, objects);
+
+        self.groups.clearRetainingCapacity();
+        try self.groups.appendSlice(groups);
+
+        const commands_size = @sizeOf(vk.DrawIndexedIndirectCommand) * commands.len;
+        for (self.command_buffers) |*buffer, i| {
+            buffer.* = try self.gc.allocator.createBuffer(&std.mem.zeroInit(vk.BufferCreateInfo, .{
+                .flags = .{},
+                .size = commands_size,
+                .usage = vk.BufferUsageFlags{ .storage_buffer_bit = true, .indirect_buffer_bit = true, .transfer_dst_bit = true },
+            }), &std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{ .usage = .gpu_only }), null);
+
+            const object_info = vk.DescriptorBufferInfo{ .buffer = self.objects.?.buffer, .offset = 0, .range = vk.WHOLE_SIZE };
+            const command_info = vk.DescriptorBufferInfo{ .buffer = buffer.buffer, .offset = 0, .range = vk.WHOLE_SIZE };
+            const instance_info = vk.DescriptorBufferInfo{ .buffer = instance_buffers[i], .offset = 0, .range = vk.WHOLE_SIZE };
+
+            const set = self.descriptor_sets[i];
+            const writes = [_]vk.WriteDescriptorSet{
+                vkinit.writeDescriptorBuffer(.storage_buffer, set, &object_info, 0),
+                vkinit.writeDescriptorBuffer(.storage_buffer, set, &command_info, 1),
+                vkinit.writeDescriptorBuffer(.storage_buffer, set, &instance_info, 2),
+            };
+            self.gc.vkd.updateDescriptorSets(self.gc.dev, writes.len, &writes, 0, undefined);
+        }
+    }
+
+    /// points every object using bindless slot `old` at `new`. The update is recorded into `cmd` instead of written through
+    /// the mapping so frames already in flight keep reading `old`, which must stay valid until they finished. Must be
+    /// recorded outside of a render pass and before `cull`.
+    pub fn replaceTextureIndex(self: *GpuDriven, cmd: CommandBuffer, old: u32, new: u32) void {
+        const buffer = (self.objects orelse return).buffer;
+        const objects = self.object_data.items;
+        // vkCmdUpdateBuffer writes at most 65536 bytes
+        const max_run = 65536 / @sizeOf(CullObject);
+
+        var recorded = false;
+        var i: usize = 0;
+        while (i < objects.len) {
+            if (objects[i].texture_index != old) {
+                i += 1;
+                continue;
+            }
+
+            if (!recorded) {
+                // earlier submissions may still be culling with the old values
+                cmd.pipelineBarrier(.{ .compute_shader_bit = true }, .{ .transfer_bit = true }, .{}, 0, undefined, 0, undefined, 0, undefined);
+                recorded = true;
+            }
+
+            // consecutive objects of the same material go out in one update
+            const first = i;
+            while (i < objects.len and i - first < max_run and objects[i].texture_index == old) : (i += 1) objects[i].texture_index = new;
+            cmd.updateBuffer(buffer, first * @sizeOf(CullObject), (i - first) * @sizeOf(CullObject), &objects[first]);
+        }
+        if (!recorded) return;
+
+        const barrier = vk.MemoryBarrier{
+            .src_access_mask = .{ .transfer_write_bit = true },
+            .dst_access_mask = .{ .shader_read_bit = true },
+        };
+        cmd.pipelineBarrier(.{ .transfer_bit = true }, .{ .compute_shader_bit = true }, .{}, 1, @ptrCast([*]const vk.MemoryBarrier, &barrier), 0, undefined, 0, undefined);
+    }
+
+    /// resets the frames commands and runs the cull shader. Must be recorded outside of a render pass. The barrier making
+    /// the commands and instance data visible to the draws is up to the caller, the render graph places it.
+    pub fn cull(self: GpuDriven, cmd: CommandBuffer, frame_slot: usize, view_proj: [4][4]f32, angle: f32) void {
+        if (self.command_count == 0) return;
+
+        const commands = self.command_buffers[frame_slot].buffer;
+        const region = vk.BufferCopy{ .src_offset = 0, .dst_offset = 0, .size = @sizeOf(vk.DrawIndexedIndirectCommand) * self.command_count };
+        cmd.copyBuffer(self.command_template.?.buffer, commands, 1, @ptrCast([*]const vk.BufferCopy, &region));
+
+        const reset_barrier = vk.MemoryBarrier{
+            .src_access_mask = .{ .transfer_write_bit = true },
+            .dst_access_mask = .{ .shader_read_bit = true, .shader_write_bit = true },
+        };
+        cmd.pipelineBarrier(.{ .transfer_bit = true }, .{ .compute_shader_bit = true }, .{}, 1, @ptrCast([*]const vk.MemoryBarrier, &reset_barrier), 0, undefined, 0, undefined);
+
+        const constants = PushConstants{
+            .planes = Frustum.fromViewProj(view_proj).planes,
+            .angle = angle,
+            .object_count = self.object_count,
+        };
+        cmd.bindPipeline(.compute, self.pipeline);
+        cmd.bindDescriptorSets(.compute, self.pipeline_layout, 0, 1, @ptrCast([*]const vk.DescriptorSet, &self.descriptor_sets[frame_slot]), 0, undefined);
+        cmd.pushConstants(self.pipeline_layout, .{ .compute_bit = true }, 0, @sizeOf(PushConstants), &constants);
+        cmd.dispatch((self.object_count + workgroup_size - 1) / workgroup_size, 1, 1);
+    }
+
+    /// issues one indirect draw per group. Vertex/index buffers and the descriptor sets shared by all materials must already be bound.
+    pub fn draw(self: GpuDriven, cmd: CommandBuffer, frame_slot: usize, stats: *RenderQueue.Stats) void {
+        const commands = self.command_buffers[frame_slot].buffer;
+        const stride = @sizeOf(vk.DrawIndexedIndirectCommand);
+
+        var last_pipeline: vk.Pipeline = .null_handle;
+        var last_texture_set: vk.DescriptorSet = .null_handle;
+        for (self.groups.items) |group| {
+            if (group.pipeline != last_pipeline) {
+                last_pipeline = group.pipeline;
+                cmd.bindPipeline(.graphics, group.pipeline);
+                stats.pipeline_binds += 1;
+            }
+
+            if (group.texture_set != .null_handle and group.texture_set != last_texture_set) {
+                last_texture_set = group.texture_set;
+                cmd.bindDescriptorSets(.graphics, group.pipeline_layout, 2, 1, @ptrCast([*]const vk.DescriptorSet, &group.texture_set), 0, undefined);
+                stats.descriptor_binds += 1;
+            }
+
+            cmd.pushConstants(group.pipeline_layout, DrawPushConstants.range.stage_flags, 0, @sizeOf(DrawPushConstants), &group.push_constants);
+            stats.push_constants += 1;
+
+            cmd.drawIndexedIndirect(commands, group.first_command * stride, group.command_count, stride);
+            stats.draws += 1;
+        }
+        stats.objects = self.object_count;
+    }
+
+    fn destroySceneBuffers(self: *GpuDriven) void {
+        if (self.objects) |buffer| buffer.deinit(self.gc.allocator);
+        if (self.command_template) |buffer| buffer.deinit(self.gc.allocator);
+        self.objects = null;
+        self.command_template = null;
+
+        for (self.command_buffers) |*buffer| {
+            if (buffer.buffer != .null_handle) buffer.deinit(self.gc.allocator);
+            buffer.* = .{ .buffer = .null_handle, .allocation = null };
+        }
+    }
+};
+
+fn createCullPipeline(gc: *const GraphicsContext, pipeline_layout: vk.PipelineLayout, pipeline_cache: vk.PipelineCache) !vk.Pipeline {
+    const code = resources.cull_comp;
+    const module = try gc.vkd.createShaderModule(gc.dev, &.{
+        .flags = .{},
+        .code_size = code.len,
+        .p_code = @ptrCast([*]const u32, @alignCast(@alignOf(u32), code)),
+    }, null);
+    defer gc.destroy(module);
+
+    const create_info = vk.ComputePipelineCreateInfo{
+        .flags = .{},
+        .stage = .{
+            .flags = .{},
+            .stage = .{ .compute_bit = true },
+            .module = module,
+            .p_name = "main",
+            .p_specialization_info = null,
+        },
+        .layout = pipeline_layout,
+        .base_pipeline_handle = .null_handle,
+        .base_pipeline_index = -1,
+    };
+
+    var pipeline: vk.Pipeline = undefined;
+    _ = try gc.vkd.createComputePipelines(gc.dev, pipeline_cache, 1, @ptrCast([*]const vk.ComputePipelineCreateInfo, &create_info), null, @ptrCast([*]vk.Pipeline, &pipeline));
+    return pipeline;
+}
+
+/// small static buffers the CPU writes once. VMA places them in device local memory when it is host visible.
+fn createHostBuffer(gc: *const GraphicsContext, data: []const u8, usage: vk.BufferUsageFlags) !vma.AllocatedBuffer {
+    const buffer = try gc.allocator.createBuffer(&std.mem.zeroInit(vk.BufferCreateInfo, .{
+        .flags = .{},
+        .size = std.math.max(data.len, 4),
+        .usage = usage,
+    }), &std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{
+        .flags = .{ .host_access_sequential_write = true },
+        .usage = .auto,
+        .requiredFlags = .{ .host_visible_bit = true, .host_coherent_bit = true },
+    }), null);
+
+    const ptr = try gc.allocator.mapMemory(u8, buffer.allocation);
+    std.mem.copy(u8, ptr[0..data.len], data);
+    gc.allocator.unmapMemory(buffer.allocation);
+
+    return buffer;
+}
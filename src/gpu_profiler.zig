@@ -0,0 +1,235 @@
+const std = @import("std");
+const vk = @import("vulkan");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+const CommandBuffer = @import("vk_objs/command_buffer.zig").CommandBuffer;
+
+/// Times named, possibly nested scopes of a frame on the GPU. Every frame in flight has its own query pool with a pair of
+/// timestamps per scope. A slot is only read back once its fence signalled, so results arrive `frames_in_flight` frames
+/// late but collecting them never waits on the GPU. The last `history_len` durations of each scope are kept for the UI.
+/// Every frame is wrapped in a root `frame_scope_name` scope, `collect` returns its duration for the frame pacing stats.
+pub const GpuProfiler = struct {
+    pub const max_scopes = 32;
+    pub const history_len = 120;
+    pub const frame_scope_name = "frame";
+
+    pub const ScopeId = struct { index: u32 };
+
+    /// timings of every scope recorded under one name, in the order the names were first seen
+    pub const Timing = struct {
+        name: []const u8,
+        /// nesting level the scope was last recorded at
+        depth: u32,
+        history: [history_len]f32 = [_]f32{0} ** history_len,
+        /// next entry of `history` to write
+        cursor: u32 = 0,
+        count: u32 = 0,
+
+        pub fn last(self: Timing) f32 {
+            if (self.count == 0) return 0;
+            return self.history[(self.cursor + history_len - 1) % history_len];
+        }
+
+        pub fn average(self: Timing) f32 {
+            if (self.count == 0) return 0;
+            var sum: f32 = 0;
+            for (self.history[0..self.count]) |ms| sum += ms;
+            return sum / @intToFloat(f32, self.count);
+        }
+
+        pub fn max(self: Timing) f32 {
+            var result: f32 = 0;
+            for (self.history[0..self.count]) |ms| result = std.math.max(result, ms);
+            return result;
+        }
+
+        fn add(self: *Timing, ms: f32) void {
+            self.history[self.cursor] = ms;
+            self.cursor = (self.cursor + 1) % history_len;
+            self.count = std.math.min(self.count + 1, history_len);
+        }
+    };
+
+    const Frame = struct {
+        query_pool: vk.QueryPool,
+        /// index into `timings` of each scope begun this frame
+        timings: [max_scopes]u32 = undefined,
+        scope_count: u32 = 0,
+        /// set once the frames timestamps were submitted and not read back yet
+        pending: bool = false,
+    };
+
+    gc: *const GraphicsContext,
+    allocator: std.mem.Allocator,
+    frames: []Frame,
+    timings: std.ArrayListUnmanaged(Timing) = .{},
+    timestamp_period: f32,
+    /// only the low `timestampValidBits` of a timestamp are meaningful, the rest is garbage
+    timestamp_mask: u64,
+    /// empty when timestamps are unsupported, every call is then a no-op
+    enabled: bool,
+    /// slot of the frame being recorded
+    current: usize = 0,
+    depth: u32 = 0,
+    frame_scope: ?ScopeId = null,
+
+    pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator, frame_count: usize) !GpuProfiler {
+        const valid_bits = try timestampValidBits(gc, allocator);
+        const enabled = gc.props.limits.timestamp_compute_and_graphics == vk.TRUE and valid_bits > 0;
+
+        const frames = try allocator.alloc(Frame, frame_count);
+        errdefer allocator.free(frames);
+
+        var count: usize = 0;
+        errdefer for (frames[0..count]) |frame| gc.destroy(frame.query_pool);
+
+        for (frames) |*frame| {
+            frame.* = .{ .query_pool = .null_handle };
+            if (!enabled) continue;
+
+            frame.query_pool = try gc.vkd.createQueryPool(gc.dev, &.{
+                .flags = .{},
+                .query_type = .timestamp,
+                .query_count = max_scopes * 2,
+                .pipeline_statistics = .{},
+            }, null);
+            count += 1;
+        }
+
+        return GpuProfiler{
+            .gc = gc,
+            .allocator = allocator,
+            .frames = frames,
+            .timestamp_period = gc.props.limits.timestamp_period,
+            .timestamp_mask = if (valid_bits >= 64) std.math.maxInt(u64) else (@as(u64, 1) << @intCast(u6, valid_bits)) - 1,
+            .enabled = enabled,
+        };
+    }
+
+    pub fn deinit(self: *GpuProfiler) void {
+        for (self.frames) |frame| {
+            if (frame.query_pool != .null_handle) self.gc.destroy(frame.query_pool);
+        }
+        self.allocator.free(self.frames);
+        for (self.timings.items) |timing| self.allocator.free(timing.name);
+        self.timings.deinit(self.allocator);
+    }
+
+    /// starts recording the scopes of `slot` and opens the root frame scope. Call at the start of the frames command
+    /// buffer, outside of a render pass, after `collect` read back the previous use of the slot.
+    pub fn beginFrame(self: *GpuProfiler, cmd: CommandBuffer, slot: usize) !void {
+        self.current = slot;
+        self.depth = 0;
+
+        const frame = &self.frames[slot];
+        frame.scope_count = 0;
+        frame.pending = false;
+        if (!self.enabled) return;
+
+        cmd.resetQueryPool(frame.query_pool, 0, max_scopes * 2);
+        self.frame_scope = try self.begin(cmd, frame_scope_name);
+    }
+
+    /// closes the root frame scope, call last thing in the frames command buffer
+    pub fn endFrame(self: *GpuProfiler, cmd: CommandBuffer) void {
+        self.end(cmd, self.frame_scope);
+        self.frame_scope = null;
+    }
+
+    /// opens a scope, the name is copied. Inside a render pass that executes secondary command buffers no timestamps
+    /// may be written, scope the whole pass instead. Scopes past `max_scopes` are dropped.
+    pub fn begin(self: *GpuProfiler, cmd: CommandBuffer, name: []const u8) !?ScopeId {
+        const frame = &self.frames[self.current];
+        if (!self.enabled or frame.scope_count == max_scopes) return null;
+
+        const index = frame.scope_count;
+        frame.timings[index] = try self.timingIndex(name);
+        frame.scope_count += 1;
+        self.timings.items[frame.timings[index]].depth = self.depth;
+        self.depth += 1;
+
+        cmd.writeTimestamp(.{ .top_of_pipe_bit = true }, frame.query_pool, index * 2);
+        return ScopeId{ .index = index };
+    }
+
+    pub fn end(self: *GpuProfiler, cmd: CommandBuffer, scope: ?ScopeId) void {
+        const id = scope orelse return;
+        const frame = &self.frames[self.current];
+        self.depth -= 1;
+
+        cmd.writeTimestamp(.{ .bottom_of_pipe_bit = true }, frame.query_pool, id.index * 2 + 1);
+        frame.pending = true;
+    }
+
+    /// adds the durations of the last submission of `slot` to the timings and returns the duration of its frame scope in
+    /// ms. Its fence must have signalled, scopes whose timestamps are not available are skipped instead of waited on.
+    pub fn collect(self: *GpuProfiler, slot: usize) ?f32 {
+        const frame = &self.frames[slot];
+        if (!frame.pending) return null;
+        frame.pending = false;
+
+        // a timestamp and its availability per query
+        var results: [max_scopes * 2][2]u64 = undefined;
+        const query_count = frame.scope_count * 2;
+        _ = self.gc.vkd.getQueryPoolResults(
+            self.gc.dev,
+            frame.query_pool,
+            0,
+            query_count,
+            @sizeOf([2]u64) * query_count,
+            &results,
+            @sizeOf([2]u64),
+            .{ .@"64_bit" = true, .with_availability_bit = true },
+        ) catch return null;
+
+        var frame_ms: ?f32 = null;
+        for (frame.timings[0..frame.scope_count]) |timing, i| {
+            const begin_ts = results[i * 2];
+            const end_ts = results[i * 2 + 1];
+            if (begin_ts[1] == 0 or end_ts[1] == 0) continue;
+
+            // masked after the wrapping subtraction so a counter that rolled over between the two still works out
+            const ticks = (end_ts[0] -% begin_ts[0]) & self.timestamp_mask;
+            const ms = @intToFloat(f32, ticks) * self.timestamp_period / std.time.ns_per_ms;
+            self.timings.items[timing].add(ms);
+            if (i == 0) frame_ms = ms;
+        }
+        return frame_ms;
+    }
+
+    fn timestampValidBits(gc: *const GraphicsContext, allocator: std.mem.Allocator) !u32 {
+        var family_count: u32 = undefined;
+        gc.vki.getPhysicalDeviceQueueFamilyProperties(gc.pdev, &family_count, null);
+
+        const families = try allocator.alloc(vk.QueueFamilyProperties, family_count);
+        defer allocator.free(families);
+        gc.vki.getPhysicalDeviceQueueFamilyProperties(gc.pdev, &family_count, families.ptr);
+
+        return families[gc.graphics_queue.family].timestamp_valid_bits;
+    }
+
+    fn timingIndex(self: *GpuProfiler, name: []const u8) !u32 {
+        for (self.timings.items) |timing, i| {
+            if (std.mem.eql(u8, timing.name, name)) return @intCast(u32, i);
+        }
+
+        const owned = try self.allocator.dupe(u8, name);
+        errdefer self.allocator.free(owned);
+        try self.timings.append(self.allocator, .{ .name = owned, .depth = self.depth });
+        return @intCast(u32, self.timings.items.len - 1);
+    }
+};
+
+test "timing history wraps around" {
+    var timing = GpuProfiler.Timing{ .name = "pass", .depth = 0 };
+    try std.testing.expectEqual(@as(f32, 0), timing.average());
+
+    var i: u32 = 0;
+    while (i < GpuProfiler.history_len + 2) : (i += 1) timing.add(@intToFloat(f32, i));
+
+    try std.testing.expectEqual(@as(u32, GpuProfiler.history_len), timing.count);
+    try std.testing.expectEqual(@intToFloat(f32, GpuProfiler.history_len + 1), timing.last());
+    try std.testing.expectEqual(@intToFloat(f32, GpuProfiler.history_len + 1), timing.max());
+    // 2 ... history_len + 1
+    try std.testing.expectEqual(@intToFloat(f32, GpuProfiler.history_len + 3) / 2, timing.average());
+}
@@ -1,4 +1,5 @@
 const std = @import("std");
+const builtin = @import("builtin");
 const vk = @import("vulkan");
 const vma = @import("vma");
 const glfw = @import("glfw");
@@ -10,9 +11,17 @@ const InstanceDispatch = dispatch.InstanceDispatch;
 const DeviceDispatch = dispatch.DeviceDispatch;
 const enableValidationLayers = dispatch.enableValidationLayers;
 
-const required_device_extensions = [_][*:0]const u8{vk.extension_info.khr_swapchain.name} ++ if (@import("builtin").os.tag == .macos) [_][*:0]const u8{vk.extension_info.khr_portability_subset.name} else [_][*:0]const u8{};
+// khr_swapchain has to stay first, it is dropped when running headless
+const required_device_extensions = [_][*:0]const u8{vk.extension_info.khr_swapchain.name} ++ if (builtin.os.tag == .macos) [_][*:0]const u8{vk.extension_info.khr_portability_subset.name} else [_][*:0]const u8{};
 const required_instance_extensions = if (enableValidationLayers) [_][*:0]const u8{vk.extension_info.ext_debug_utils.name} else [_][*:0]const u8{};
 const validation_layers = [_][*:0]const u8{"VK_LAYER_KHRONOS_validation"};
+/// GpuDriven issues one drawIndexedIndirect per material group covering many commands, each starting at its own instance
+const required_features = vk.PhysicalDeviceFeatures{
+    .multi_draw_indirect = vk.TRUE,
+    .draw_indirect_first_instance = vk.TRUE,
+};
+
+const GetInstanceProcAddr = fn (instance: vk.Instance, procname: [*:0]const u8) callconv(.C) vk.PfnVoidFunction;
 
 pub const GraphicsContext = struct {
     vkb: BaseDispatch,
@@ -20,11 +29,16 @@ pub const GraphicsContext = struct {
     vkd: DeviceDispatch,
 
     instance: vk.Instance,
+    /// null_handle when running headless
     surface: vk.SurfaceKHR,
+    /// the Vulkan loader, opened directly when running headless since glfw may not be able to initialize without a display
+    vulkan_lib: ?std.DynLib,
     pdev: vk.PhysicalDevice,
     props: vk.PhysicalDeviceProperties,
     mem_props: vk.PhysicalDeviceMemoryProperties,
     gpu_props: vk.PhysicalDeviceProperties,
+    /// the descriptor indexing features bindless textures rely on are supported and enabled
+    descriptor_indexing: bool,
 
     dev: vk.Device,
     graphics_queue: Queue,
@@ -32,12 +46,20 @@ pub const GraphicsContext = struct {
     allocator: vma.Allocator,
     debug_message: if (enableValidationLayers) vk.DebugUtilsMessengerEXT else void,
 
-    pub fn init(allocator: Allocator, app_name: [*:0]const u8, window: glfw.Window) !GraphicsContext {
+    /// without a window no surface is created and the device does not need swapchain support, e.g. to render offscreen
+    /// on a software implementation like lavapipe
+    pub fn init(allocator: Allocator, app_name: [*:0]const u8, window: ?glfw.Window) !GraphicsContext {
         var self: GraphicsContext = undefined;
-        const vk_proc = @ptrCast(fn (instance: vk.Instance, procname: [*:0]const u8) callconv(.C) vk.PfnVoidFunction, glfw.getInstanceProcAddress);
+        self.vulkan_lib = if (window == null) try openVulkanLibrary() else null;
+        errdefer if (self.vulkan_lib) |*lib| lib.close();
+
+        const vk_proc = if (self.vulkan_lib) |*lib|
+            (lib.lookup(GetInstanceProcAddr, "vkGetInstanceProcAddr") orelse return error.VulkanLoaderIncompatible)
+        else
+            @ptrCast(GetInstanceProcAddr, glfw.getInstanceProcAddress);
         self.vkb = try BaseDispatch.load(vk_proc);
 
-        const glfw_exts = try glfw.getRequiredInstanceExtensions();
+        const glfw_exts: []const [*:0]const u8 = if (window != null) try glfw.getRequiredInstanceExtensions() else &.{};
 
         const app_info = vk.ApplicationInfo{
             .p_application_name = app_name,
@@ -74,19 +96,20 @@ pub const GraphicsContext = struct {
             .enabled_layer_count = if (enableValidationLayers) validation_layers.len else 0,
             .pp_enabled_layer_names = if (enableValidationLayers) &validation_layers else undefined,
             .enabled_extension_count = @intCast(u32, instance_exts.len),
-            .pp_enabled_extension_names = @ptrCast([*]const [*:0]const u8, &instance_exts[0]),
+            .pp_enabled_extension_names = instance_exts.ptr,
         }, null);
 
         self.vki = try InstanceDispatch.load(self.instance, vk_proc);
         errdefer self.vki.destroyInstance(self.instance, null);
 
-        self.surface = try createSurfaceGlfw(self.instance, window);
-        errdefer self.vki.destroySurfaceKHR(self.instance, self.surface, null);
+        self.surface = if (window) |w| try createSurfaceGlfw(self.instance, w) else .null_handle;
+        errdefer if (self.surface != .null_handle) self.vki.destroySurfaceKHR(self.instance, self.surface, null);
 
         const candidate = try pickPhysicalDevice(self.vki, self.instance, allocator, self.surface);
         self.pdev = candidate.pdev;
         self.props = candidate.props;
-        self.dev = try initializeCandidate(self.vki, candidate);
+        self.descriptor_indexing = supportsDescriptorIndexing(self.vki, candidate);
+        self.dev = try initializeCandidate(self.vki, candidate, deviceExtensions(self.surface), self.descriptor_indexing);
         self.vkd = try DeviceDispatch.load(self.dev, self.vki.dispatch.vkGetDeviceProcAddr);
         errdefer self.vkd.destroyDevice(self.dev, null);
 
@@ -132,9 +155,12 @@ pub const GraphicsContext = struct {
     pub fn deinit(self: GraphicsContext) void {
         self.allocator.deinit();
         self.vkd.destroyDevice(self.dev, null);
-        self.vki.destroySurfaceKHR(self.instance, self.surface, null);
+        if (self.surface != .null_handle) self.vki.destroySurfaceKHR(self.instance, self.surface, null);
         if (enableValidationLayers) self.vki.destroyDebugUtilsMessengerEXT(self.instance, self.debug_message, null);
         self.vki.destroyInstance(self.instance, null);
+
+        var lib = self.vulkan_lib;
+        if (lib) |*l| l.close();
     }
 
     pub fn deviceName(self: GraphicsContext) []const u8 {
@@ -176,6 +202,23 @@ pub const Queue = struct {
     }
 };
 
+fn openVulkanLibrary() !std.DynLib {
+    const names: []const []const u8 = switch (builtin.os.tag) {
+        .windows => &.{"vulkan-1.dll"},
+        .macos => &.{ "libvulkan.1.dylib", "libMoltenVK.dylib" },
+        else => &.{ "libvulkan.so.1", "libvulkan.so" },
+    };
+    for (names) |name| {
+        return std.DynLib.open(name) catch continue;
+    }
+    return error.VulkanLoaderNotFound;
+}
+
+/// swapchain support is only needed with a surface to present to
+fn deviceExtensions(surface: vk.SurfaceKHR) []const [*:0]const u8 {
+    return if (surface == .null_handle) required_device_extensions[1..] else &required_device_extensions;
+}
+
 fn createSurfaceGlfw(instance: vk.Instance, window: glfw.Window) !vk.SurfaceKHR {
     var surface: vk.SurfaceKHR = undefined;
     if ((try glfw.createWindowSurface(instance, window, null, &surface)) != @enumToInt(vk.Result.success)) {
@@ -185,7 +228,7 @@ fn createSurfaceGlfw(instance: vk.Instance, window: glfw.Window) !vk.SurfaceKHR
     return surface;
 }
 
-fn initializeCandidate(vki: InstanceDispatch, candidate: DeviceCandidate) !vk.Device {
+fn initializeCandidate(vki: InstanceDispatch, candidate: DeviceCandidate, extensions: []const [*:0]const u8, descriptor_indexing: bool) !vk.Device {
     const priority = [_]f32{1};
     const qci = [_]vk.DeviceQueueCreateInfo{
         .{
@@ -207,13 +250,24 @@ fn initializeCandidate(vki: InstanceDispatch, candidate: DeviceCandidate) !vk.De
     else
         2;
 
+    // only what the engine uses is enabled, features like robustBufferAccess cost performance for nothing
+    var features12 = vk.PhysicalDeviceVulkan12Features{};
+    if (descriptor_indexing) {
+        features12.runtime_descriptor_array = vk.TRUE;
+        features12.descriptor_binding_partially_bound = vk.TRUE;
+        features12.descriptor_binding_sampled_image_update_after_bind = vk.TRUE;
+        features12.shader_sampled_image_array_non_uniform_indexing = vk.TRUE;
+    }
     // required for access to gl_BaseInstance: https://www.khronos.org/registry/vulkan/specs/1.2-extensions/html/vkspec.html#features-shaderDrawParameters
-    var physical_features2 = std.mem.zeroInit(vk.PhysicalDeviceFeatures2, .{
-        .p_next = &std.mem.zeroInit(vk.PhysicalDeviceVulkan11Features, .{
-            .shader_draw_parameters = vk.TRUE,
-        }),
-    });
-    vki.getPhysicalDeviceFeatures2(candidate.pdev, &physical_features2);
+    var draw_parameters = vk.PhysicalDeviceShaderDrawParametersFeatures{
+        // the 1.2 struct may only be chained on 1.2 devices, descriptor indexing is never supported on older ones
+        .p_next = if (descriptor_indexing) @ptrCast(*anyopaque, &features12) else null,
+        .shader_draw_parameters = vk.TRUE,
+    };
+    var physical_features2 = vk.PhysicalDeviceFeatures2{
+        .p_next = @ptrCast(*anyopaque, &draw_parameters),
+        .features = required_features,
+    };
 
     return try vki.createDevice(candidate.pdev, &.{
         .p_next = &physical_features2,
@@ -222,12 +276,25 @@ fn initializeCandidate(vki: InstanceDispatch, candidate: DeviceCandidate) !vk.De
         .p_queue_create_infos = &qci,
         .enabled_layer_count = 0,
         .pp_enabled_layer_names = undefined,
-        .enabled_extension_count = required_device_extensions.len,
-        .pp_enabled_extension_names = @ptrCast([*]const [*:0]const u8, &required_device_extensions),
+        .enabled_extension_count = @intCast(u32, extensions.len),
+        .pp_enabled_extension_names = extensions.ptr,
         .p_enabled_features = null,
     }, null);
 }
 
+fn supportsDescriptorIndexing(vki: InstanceDispatch, candidate: DeviceCandidate) bool {
+    if (candidate.props.api_version < vk.API_VERSION_1_2) return false;
+
+    var features12 = vk.PhysicalDeviceVulkan12Features{};
+    var features2 = vk.PhysicalDeviceFeatures2{ .p_next = @ptrCast(*anyopaque, &features12), .features = .{} };
+    vki.getPhysicalDeviceFeatures2(candidate.pdev, &features2);
+
+    return features12.runtime_descriptor_array == vk.TRUE and
+        features12.descriptor_binding_partially_bound == vk.TRUE and
+        features12.descriptor_binding_sampled_image_update_after_bind == vk.TRUE and
+        features12.shader_sampled_image_array_non_uniform_indexing == vk.TRUE;
+}
+
 const DeviceCandidate = struct {
     pdev: vk.PhysicalDevice,
     props: vk.PhysicalDeviceProperties,
@@ -270,11 +337,15 @@ fn checkSuitable(
 ) !?DeviceCandidate {
     const props = vki.getPhysicalDeviceProperties(pdev);
 
-    if (!try checkExtensionSupport(vki, pdev, allocator)) {
+    if (!try checkExtensionSupport(vki, pdev, allocator, deviceExtensions(surface))) {
+        return null;
+    }
+
+    if (surface != .null_handle and !try checkSurfaceSupport(vki, pdev, surface)) {
         return null;
     }
 
-    if (!try checkSurfaceSupport(vki, pdev, surface)) {
+    if (!checkFeatureSupport(vki, pdev)) {
         return null;
     }
 
@@ -307,11 +378,14 @@ fn allocateQueues(vki: InstanceDispatch, pdev: vk.PhysicalDevice, allocator: All
             graphics_family = family;
         }
 
-        if (present_family == null and (try vki.getPhysicalDeviceSurfaceSupportKHR(pdev, family, surface)) == vk.TRUE) {
+        if (present_family == null and surface != .null_handle and (try vki.getPhysicalDeviceSurfaceSupportKHR(pdev, family, surface)) == vk.TRUE) {
             present_family = family;
         }
     }
 
+    // nothing is presented, the graphics queue stands in
+    if (surface == .null_handle) present_family = graphics_family;
+
     if (graphics_family != null and present_family != null) {
         return QueueAllocation{
             .graphics_family = graphics_family.?,
@@ -332,10 +406,21 @@ fn checkSurfaceSupport(vki: InstanceDispatch, pdev: vk.PhysicalDevice, surface:
     return format_count > 0 and present_mode_count > 0;
 }
 
+fn checkFeatureSupport(vki: InstanceDispatch, pdev: vk.PhysicalDevice) bool {
+    var draw_parameters = vk.PhysicalDeviceShaderDrawParametersFeatures{};
+    var features2 = vk.PhysicalDeviceFeatures2{ .p_next = @ptrCast(*anyopaque, &draw_parameters), .features = .{} };
+    vki.getPhysicalDeviceFeatures2(pdev, &features2);
+
+    return features2.features.multi_draw_indirect == vk.TRUE and
+        features2.features.draw_indirect_first_instance == vk.TRUE and
+        draw_parameters.shader_draw_parameters == vk.TRUE;
+}
+
 fn checkExtensionSupport(
     vki: InstanceDispatch,
     pdev: vk.PhysicalDevice,
     allocator: Allocator,
+    extensions: []const [*:0]const u8,
 ) !bool {
     var count: u32 = undefined;
     _ = try vki.enumerateDeviceExtensionProperties(pdev, null, &count, null);
@@ -345,7 +430,7 @@ fn checkExtensionSupport(
 
     _ = try vki.enumerateDeviceExtensionProperties(pdev, null, &count, propsv.ptr);
 
-    for (required_device_extensions) |ext| {
+    for (extensions) |ext| {
         for (propsv) |props| {
             const len = std.mem.indexOfScalar(u8, &props.extension_name, 0).?;
             const prop_ext_name = props.extension_name[0..len];
@@ -0,0 +1,164 @@
+const std = @import("std");
+const vk = @import("vulkan");
+const vma = @import("vma");
+const vkinit = @import("vkinit.zig");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+const CommandBuffer = @import("vk_objs/command_buffer.zig").CommandBuffer;
+
+/// Stands in for the swapchain when running without a window. Frames are rendered into an offscreen color image and
+/// copied into host visible memory. Every frame in flight gets its own image and readback buffer so recording a frame
+/// never touches one the GPU or the CPU may still be using.
+pub const HeadlessTarget = struct {
+    pub const format = vk.Format.r8g8b8a8_srgb;
+    const bytes_per_pixel = 4;
+
+    const Slot = struct {
+        image: vma.AllocatedImage,
+        view: vk.ImageView,
+        readback: vma.AllocatedBuffer,
+        /// persistently mapped `readback`
+        pixels: [*]u8,
+    };
+
+    gc: *const GraphicsContext,
+    allocator: std.mem.Allocator,
+    extent: vk.Extent2D,
+    slots: []Slot,
+    /// incremented by every `submit`, the same as `Swapchain.frame_index`
+    frame_index: usize = 0,
+
+    pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator, extent: vk.Extent2D, frames_in_flight: usize) !HeadlessTarget {
+        const slots = try allocator.alloc(Slot, frames_in_flight);
+        errdefer allocator.free(slots);
+
+        var count: usize = 0;
+        errdefer for (slots[0..count]) |slot| destroySlot(gc, slot);
+
+        for (slots) |*slot| {
+            slot.* = try createSlot(gc, extent);
+            count += 1;
+        }
+
+        return HeadlessTarget{
+            .gc = gc,
+            .allocator = allocator,
+            .extent = extent,
+            .slots = slots,
+        };
+    }
+
+    pub fn deinit(self: HeadlessTarget) void {
+        for (self.slots) |slot| destroySlot(self.gc, slot);
+        self.allocator.free(self.slots);
+    }
+
+    pub fn frameSlot(self: HeadlessTarget) usize {
+        return self.frame_index % self.slots.len;
+    }
+
+    /// the image the current frame renders into
+    pub fn currentImage(self: HeadlessTarget) vk.Image {
+        return self.slots[self.frameSlot()].image.image;
+    }
+
+    pub fn currentView(self: HeadlessTarget) vk.ImageView {
+        return self.slots[self.frameSlot()].view;
+    }
+
+    /// copies the current image, which must be in transfer_src_optimal, into its readback buffer and makes the copy
+    /// visible to the host. Must be recorded outside of a render pass.
+    pub fn recordReadback(self: HeadlessTarget, cmd: CommandBuffer) void {
+        const slot = self.slots[self.frameSlot()];
+        const region = vk.BufferImageCopy{
+            .buffer_offset = 0,
+            // tightly packed
+            .buffer_row_length = 0,
+            .buffer_image_height = 0,
+            .image_subresource = .{
+                .aspect_mask = .{ .color_bit = true },
+                .mip_level = 0,
+                .base_array_layer = 0,
+                .layer_count = 1,
+            },
+            .image_offset = .{ .x = 0, .y = 0, .z = 0 },
+            .image_extent = .{ .width = self.extent.width, .height = self.extent.height, .depth = 1 },
+        };
+        cmd.copyImageToBuffer(slot.image.image, .transfer_src_optimal, slot.readback.buffer, 1, @ptrCast([*]const vk.BufferImageCopy, &region));
+
+        const host_barrier = vk.MemoryBarrier{
+            .src_access_mask = .{ .transfer_write_bit = true },
+            .dst_access_mask = .{ .host_read_bit = true },
+        };
+        cmd.pipelineBarrier(.{ .transfer_bit = true }, .{ .host_bit = true }, .{}, 1, @ptrCast([*]const vk.MemoryBarrier, &host_barrier), 0, undefined, 0, undefined);
+    }
+
+    /// submits `cmdbuf`, signalling `fence` once the GPU is done with it, and moves on to the next slot. There is nothing
+    /// to acquire or present so no semaphores are involved.
+    pub fn submit(self: *HeadlessTarget, cmdbuf: vk.CommandBuffer, fence: vk.Fence) !void {
+        try self.gc.vkd.queueSubmit(self.gc.graphics_queue.handle, 1, &[_]vk.SubmitInfo{.{
+            .wait_semaphore_count = 0,
+            .p_wait_semaphores = undefined,
+            .p_wait_dst_stage_mask = undefined,
+            .command_buffer_count = 1,
+            .p_command_buffers = @ptrCast([*]const vk.CommandBuffer, &cmdbuf),
+            .signal_semaphore_count = 0,
+            .p_signal_semaphores = undefined,
+        }}, fence);
+
+        self.frame_index += 1;
+    }
+
+    /// the RGBA pixels of the frame last rendered in `slot`, rows tightly packed. The fence of the frame that used the slot
+    /// has to be waited on first and the slice is only valid until the slot is rendered to again.
+    pub fn readPixels(self: HeadlessTarget, slot: usize) ![]const u8 {
+        const size = self.extent.width * self.extent.height * bytes_per_pixel;
+        try self.gc.allocator.invalidateAllocation(self.slots[slot].readback.allocation, 0, vk.WHOLE_SIZE);
+        return self.slots[slot].pixels[0..size];
+    }
+
+    /// writes pixels from `readPixels` as a binary PPM, alpha is dropped
+    pub fn writePpm(self: HeadlessTarget, pixels: []const u8, path: []const u8) !void {
+        const file = try std.fs.cwd().createFile(path, .{});
+        defer file.close();
+
+        var buffered = std.io.bufferedWriter(file.writer());
+        const writer = buffered.writer();
+        try writer.print("P6\n{d} {d}\n255\n", .{ self.extent.width, self.extent.height });
+
+        var i: usize = 0;
+        while (i < pixels.len) : (i += bytes_per_pixel) try writer.writeAll(pixels[i .. i + 3]);
+        try buffered.flush();
+    }
+
+    fn createSlot(gc: *const GraphicsContext, extent: vk.Extent2D) !Slot {
+        const image_info = vkinit.imageCreateInfo(format, .{ .width = extent.width, .height = extent.height, .depth = 1 }, .{ .color_attachment_bit = true, .transfer_src_bit = true });
+        const image = try gc.allocator.createImage(&image_info, &std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{ .usage = .gpu_only }), null);
+        errdefer image.deinit(gc.allocator);
+
+        const view_info = vkinit.imageViewCreateInfo(format, image.image, .{ .color_bit = true });
+        const view = try gc.vkd.createImageView(gc.dev, &view_info, null);
+        errdefer gc.destroy(view);
+
+        const readback = try gc.allocator.createBuffer(&std.mem.zeroInit(vk.BufferCreateInfo, .{
+            .flags = .{},
+            .size = extent.width * extent.height * bytes_per_pixel,
+            .usage = vk.BufferUsageFlags{ .transfer_dst_bit = true },
+        }), &std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{ .usage = .gpu_to_cpu }), null);
+        errdefer readback.deinit(gc.allocator);
+
+        return Slot{
+            .image = image,
+            .view = view,
+            .readback = readback,
+            .pixels = try gc.allocator.mapMemory(u8, readback.allocation),
+        };
+    }
+
+    fn destroySlot(gc: *const GraphicsContext, slot: Slot) void {
+        gc.allocator.unmapMemory(slot.readback.allocation);
+        slot.readback.deinit(gc.allocator);
+        gc.destroy(slot.view);
+        slot.image.deinit(gc.allocator);
+    }
+};
@@ -0,0 +1,137 @@
+const std = @import("std");
+
+/// A fixed set of worker threads running parallel-for style jobs. The calling thread works on the job as well and
+/// `parallelFor` only returns once every index has been processed, so jobs can freely point at stack data.
+pub const JobPool = struct {
+    const Job = struct {
+        ctx: *anyopaque,
+        func: fn (*anyopaque, usize, usize) void,
+        count: usize,
+    };
+
+    allocator: std.mem.Allocator,
+    threads: []std.Thread,
+    mutex: std.Thread.Mutex = .{},
+    wake: std.Thread.Condition = .{},
+    done: std.Thread.Condition = .{},
+    job: Job = undefined,
+    /// bumped for every job so sleeping workers can tell a new one arrived
+    generation: usize = 0,
+    /// workers that have not finished the current job yet
+    pending: usize = 0,
+    /// next index to hand out, only touched atomically
+    next: usize = 0,
+    quit: bool = false,
+
+    /// `thread_count` extra threads are spawned, zero runs every job on the caller
+    pub fn init(allocator: std.mem.Allocator, thread_count: usize) !*JobPool {
+        const self = try allocator.create(JobPool);
+        errdefer allocator.destroy(self);
+
+        self.* = .{
+            .allocator = allocator,
+            .threads = try allocator.alloc(std.Thread, thread_count),
+        };
+        errdefer allocator.free(self.threads);
+
+        for (self.threads) |*thread, i| {
+            thread.* = std.Thread.spawn(.{}, workerMain, .{ self, i + 1 }) catch |err| {
+                self.stop(self.threads[0..i]);
+                return err;
+            };
+        }
+
+        return self;
+    }
+
+    /// one worker per core besides the calling thread, capped at `max_threads`
+    pub fn initForCpu(allocator: std.mem.Allocator, max_threads: usize) !*JobPool {
+        const cpu_count = std.Thread.getCpuCount() catch 1;
+        return try init(allocator, std.math.min(cpu_count -| 1, max_threads));
+    }
+
+    pub fn deinit(self: *JobPool) void {
+        self.stop(self.threads);
+        self.allocator.free(self.threads);
+        self.allocator.destroy(self);
+    }
+
+    /// the number of distinct `worker` values a job can see, including the calling thread which is always worker 0
+    pub fn workerCount(self: JobPool) usize {
+        return self.threads.len + 1;
+    }
+
+    /// calls `func(context, index, worker)` for every index in 0..count and blocks until all of them are done. `worker`
+    /// identifies the thread running the call, so per-worker resources can be used without locking.
+    pub fn parallelFor(self: *JobPool, count: usize, context: anytype, comptime func: fn (@TypeOf(context), usize, usize) void) void {
+        const Context = @TypeOf(context);
+        const Erased = struct {
+            fn call(ptr: *anyopaque, index: usize, worker: usize) void {
+                func(@ptrCast(Context, @alignCast(@alignOf(std.meta.Child(Context)), ptr)), index, worker);
+            }
+        };
+
+        if (count == 0) return;
+        if (self.threads.len == 0 or count == 1) {
+            var i: usize = 0;
+            while (i < count) : (i += 1) func(context, i, 0);
+            return;
+        }
+
+        const job = Job{ .ctx = @ptrCast(*anyopaque, context), .func = Erased.call, .count = count };
+
+        self.mutex.lock();
+        self.job = job;
+        @atomicStore(usize, &self.next, 0, .Monotonic);
+        self.pending = self.threads.len;
+        self.generation +%= 1;
+        self.wake.broadcast();
+        self.mutex.unlock();
+
+        self.work(job, 0);
+
+        // every worker has to check in, otherwise a late one could still be pulling indices when the next job starts
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        while (self.pending != 0) self.done.wait(&self.mutex);
+    }
+
+    fn work(self: *JobPool, job: Job, worker: usize) void {
+        while (true) {
+            const index = @atomicRmw(usize, &self.next, .Add, 1, .Monotonic);
+            if (index >= job.count) return;
+            job.func(job.ctx, index, worker);
+        }
+    }
+
+    fn workerMain(self: *JobPool, worker: usize) void {
+        var seen: usize = 0;
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        while (true) {
+            while (self.generation == seen and !self.quit) self.wake.wait(&self.mutex);
+            if (self.quit) return;
+
+            seen = self.generation;
+            const job = self.job;
+            self.mutex.unlock();
+
+            self.work(job, worker);
+
+            self.mutex.lock();
+            self.pending -= 1;
+            if (self.pending == 0) self.done.signal();
+        }
+    }
+
+    fn stop(self: *JobPool, threads: []std.Thread) void {
+        self.mutex.lock();
+        self.quit = true;
+        self.wake.broadcast();
+        self.mutex.unlock();
+
+        for (threads) |thread| thread.join();
+    }
+};
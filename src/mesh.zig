@@ -4,6 +4,7 @@ const vma = @import("vma");
 const tiny = @import("tiny");
 
 const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+const GeometryArena = @import("geometry_arena.zig").GeometryArena;
 
 pub const Vertex = extern struct {
     pub const binding_description = vk.VertexInputBindingDescription{
@@ -47,12 +48,17 @@ pub const Vertex = extern struct {
 
 pub const Mesh = struct {
     vertices: std.ArrayList(Vertex),
-    vert_buffer: vma.AllocatedBuffer,
+    indices: std.ArrayList(u32),
+    /// where the mesh lives in the GeometryArena once uploaded
+    geometry: GeometryArena.Allocation,
+    /// local bounding sphere, xyz center and w radius. Kept up to date by `updateBounds`.
+    bounds: [4]f32 = .{ 0, 0, 0, 0 },
 
     pub fn init(allocator: std.mem.Allocator) Mesh {
         return .{
             .vertices = std.ArrayList(Vertex).init(allocator),
-            .vert_buffer = undefined,
+            .indices = std.ArrayList(u32).init(allocator),
+            .geometry = undefined,
         };
     }
 
@@ -61,46 +67,144 @@ pub const Mesh = struct {
         defer tiny.obj_free(ret);
 
         var vertices = std.ArrayList(Vertex).init(allocator);
+        errdefer vertices.deinit();
+        var indices = std.ArrayList(u32).init(allocator);
+        errdefer indices.deinit();
+
+        // tinyobj hands us a flat triangle list so identical vertices are welded to get an index buffer out of it
+        var unique = std.AutoHashMap([@sizeOf(Vertex)]u8, u32).init(allocator);
+        defer unique.deinit();
 
         var s: usize = 0;
         while (s < ret.num_shapes) : (s += 1) {
             const shape = ret.shapes[s];
-            try vertices.ensureTotalCapacity(vertices.items.len + shape.num_vertices);
+            try indices.ensureTotalCapacity(indices.items.len + shape.num_vertices);
 
             var i: usize = 0;
             while (i < shape.num_vertices) : (i += 1) {
-                var vert: Vertex = undefined;
-                vert.position[0] = shape.vertices[i].x;
-                vert.position[1] = shape.vertices[i].y;
-                vert.position[2] = shape.vertices[i].z;
-
-                if (shape.num_normals > 0) {
-                    vert.normal[0] = shape.normals[i].x;
-                    vert.normal[1] = shape.normals[i].y;
-                    vert.normal[2] = shape.normals[i].z;
+                const vert = objVertex(shape, i);
+                const entry = try unique.getOrPut(std.mem.toBytes(vert));
+                if (!entry.found_existing) {
+                    entry.value_ptr.* = @intCast(u32, vertices.items.len);
+                    try vertices.append(vert);
                 }
+                indices.appendAssumeCapacity(entry.value_ptr.*);
+            }
+        }
 
-                if (shape.num_uvs > 0) {
-                    vert.uv[0] = shape.uvs[i].u;
-                    vert.uv[1] = shape.uvs[i].v;
-                }
+        var mesh = Mesh{
+            .vertices = vertices,
+            .indices = indices,
+            .geometry = undefined,
+        };
+        mesh.updateBounds();
+        return mesh;
+    }
 
-                vert.color[0] = shape.colors[i].x;
-                vert.color[1] = shape.colors[i].y;
-                vert.color[2] = shape.colors[i].z;
+    /// call after changing the vertices of a mesh built by hand
+    pub fn updateBounds(self: *Mesh) void {
+        self.bounds = self.boundingSphere();
+    }
+
+    /// center in xyz and radius in w. Centered on the bounding box, which is tighter than the vertex average for most meshes.
+    pub fn boundingSphere(self: Mesh) [4]f32 {
+        if (self.vertices.items.len == 0) return .{ 0, 0, 0, 0 };
 
-                vertices.appendAssumeCapacity(vert);
+        var min = self.vertices.items[0].position;
+        var max = min;
+        for (self.vertices.items) |vert| {
+            for (vert.position) |p, i| {
+                min[i] = std.math.min(min[i], p);
+                max[i] = std.math.max(max[i], p);
             }
         }
 
-        return Mesh{
+        const center = [3]f32{ (min[0] + max[0]) * 0.5, (min[1] + max[1]) * 0.5, (min[2] + max[2]) * 0.5 };
+        var radius_sq: f32 = 0;
+        for (self.vertices.items) |vert| {
+            const dx = vert.position[0] - center[0];
+            const dy = vert.position[1] - center[1];
+            const dz = vert.position[2] - center[2];
+            radius_sq = std.math.max(radius_sq, dx * dx + dy * dy + dz * dz);
+        }
+
+        return .{ center[0], center[1], center[2], std.math.sqrt(radius_sq) };
+    }
+
+    /// for meshes built by hand that have no index data yet
+    pub fn generateIndices(self: *Mesh) !void {
+        try self.indices.resize(self.vertices.items.len);
+        for (self.indices.items) |*index, i| index.* = @intCast(u32, i);
+    }
+
+    pub fn deinit(self: Mesh, arena: *GeometryArena) void {
+        arena.free(self.geometry);
+        self.vertices.deinit();
+        self.indices.deinit();
+    }
+};
+
+/// A mesh with its own vertex buffer and no index data, drawn with `cmdDraw`. Used by the earlier chapters that predate
+/// the GeometryArena.
+pub const StandaloneMesh = struct {
+    vertices: std.ArrayList(Vertex),
+    vert_buffer: vma.AllocatedBuffer,
+
+    pub fn init(allocator: std.mem.Allocator) StandaloneMesh {
+        return .{
+            .vertices = std.ArrayList(Vertex).init(allocator),
+            .vert_buffer = undefined,
+        };
+    }
+
+    pub fn initFromObj(allocator: std.mem.Allocator, filename: []const u8) !StandaloneMesh {
+        const ret = tiny.obj_load(filename.ptr);
+        defer tiny.obj_free(ret);
+
+        var vertices = std.ArrayList(Vertex).init(allocator);
+        errdefer vertices.deinit();
+
+        var s: usize = 0;
+        while (s < ret.num_shapes) : (s += 1) {
+            const shape = ret.shapes[s];
+            try vertices.ensureTotalCapacity(vertices.items.len + shape.num_vertices);
+
+            var i: usize = 0;
+            while (i < shape.num_vertices) : (i += 1) vertices.appendAssumeCapacity(objVertex(shape, i));
+        }
+
+        return StandaloneMesh{
             .vertices = vertices,
             .vert_buffer = undefined,
         };
     }
 
-    pub fn deinit(self: Mesh, allocator: vma.Allocator) void {
+    pub fn deinit(self: StandaloneMesh, allocator: vma.Allocator) void {
         self.vert_buffer.deinit(allocator);
         self.vertices.deinit();
     }
 };
+
+fn objVertex(shape: anytype, i: usize) Vertex {
+    // zeroed so missing normals/uvs dont leave garbage bytes in the weld key
+    var vert = std.mem.zeroes(Vertex);
+    vert.position[0] = shape.vertices[i].x;
+    vert.position[1] = shape.vertices[i].y;
+    vert.position[2] = shape.vertices[i].z;
+
+    if (shape.num_normals > 0) {
+        vert.normal[0] = shape.normals[i].x;
+        vert.normal[1] = shape.normals[i].y;
+        vert.normal[2] = shape.normals[i].z;
+    }
+
+    if (shape.num_uvs > 0) {
+        vert.uv[0] = shape.uvs[i].u;
+        vert.uv[1] = shape.uvs[i].v;
+    }
+
+    vert.color[0] = shape.colors[i].x;
+    vert.color[1] = shape.colors[i].y;
+    vert.color[2] = shape.colors[i].z;
+    return vert;
+}
@@ -4,8 +4,58 @@ const vkinit = @import("vkinit.zig");
 
 const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
 
+/// values for the `layout (constant_id = N)` constants of a shader stage. The driver folds them in when the pipeline is
+/// built, so one SPIR-V module yields pipelines as fast as separately compiled variants.
+pub const Specialization = struct {
+    pub const max_constants = 8;
+
+    entries: [max_constants]vk.SpecializationMapEntry = undefined,
+    /// every constant is stored as 32 bits, which covers bool (as VkBool32), int, uint and float
+    data: [max_constants]u32 = undefined,
+    count: u32 = 0,
+
+    pub fn set(self: *Specialization, constant_id: u32, value: u32) void {
+        for (self.entries[0..self.count]) |entry, i| {
+            if (entry.constant_id == constant_id) {
+                self.data[i] = value;
+                return;
+            }
+        }
+
+        std.debug.assert(self.count < max_constants);
+        self.entries[self.count] = .{
+            .constant_id = constant_id,
+            .offset = self.count * @sizeOf(u32),
+            .size = @sizeOf(u32),
+        };
+        self.data[self.count] = value;
+        self.count += 1;
+    }
+
+    pub fn setBool(self: *Specialization, constant_id: u32, value: bool) void {
+        self.set(constant_id, @boolToInt(value));
+    }
+
+    /// feeds the constants into `hasher`, two specializations hash alike when they set the same values in the same order
+    pub fn hash(self: Specialization, hasher: anytype) void {
+        hasher.update(std.mem.sliceAsBytes(self.entries[0..self.count]));
+        hasher.update(std.mem.sliceAsBytes(self.data[0..self.count]));
+    }
+
+    fn info(self: *const Specialization) vk.SpecializationInfo {
+        return .{
+            .map_entry_count = self.count,
+            .p_map_entries = &self.entries,
+            .data_size = self.count * @sizeOf(u32),
+            .p_data = &self.data,
+        };
+    }
+};
+
 pub const PipelineBuilder = struct {
     shader_stages: std.ArrayList(vk.PipelineShaderStageCreateInfo),
+    /// one per shader stage, same order
+    specializations: std.ArrayList(?Specialization),
     vertex_input_info: vk.PipelineVertexInputStateCreateInfo,
     input_assembly: vk.PipelineInputAssemblyStateCreateInfo,
     rasterizer: vk.PipelineRasterizationStateCreateInfo,
@@ -17,6 +67,7 @@ pub const PipelineBuilder = struct {
     pub fn init(allocator: std.mem.Allocator, pipeline_layout: vk.PipelineLayout) PipelineBuilder {
         return .{
             .shader_stages = std.ArrayList(vk.PipelineShaderStageCreateInfo).init(allocator),
+            .specializations = std.ArrayList(?Specialization).init(allocator),
             .vertex_input_info = .{
                 .flags = .{},
                 .vertex_binding_description_count = 0,
@@ -34,14 +85,32 @@ pub const PipelineBuilder = struct {
 
     pub fn deinit(self: PipelineBuilder) void {
         self.shader_stages.deinit();
+        self.specializations.deinit();
     }
 
     pub fn addShaderStage(self: *PipelineBuilder, stage: vk.PipelineShaderStageCreateInfo) !void {
+        try self.addShaderStageSpecialized(stage, null);
+    }
+
+    /// `specialization` is copied, a null or empty one leaves the constants at their defaults from the shader
+    pub fn addShaderStageSpecialized(self: *PipelineBuilder, stage: vk.PipelineShaderStageCreateInfo, specialization: ?Specialization) !void {
         try self.shader_stages.append(stage);
+        try self.specializations.append(specialization);
     }
 
-    pub fn build(self: PipelineBuilder, gc: *const GraphicsContext, render_pass: vk.RenderPass) !vk.Pipeline {
-        defer self.shader_stages.deinit();
+    /// `cache` may be .null_handle
+    pub fn build(self: PipelineBuilder, gc: *const GraphicsContext, render_pass: vk.RenderPass, cache: vk.PipelineCache) !vk.Pipeline {
+        defer self.deinit();
+
+        // pointers into `specializations` stay valid since no stage is added while building
+        const spec_infos = try self.specializations.allocator.alloc(vk.SpecializationInfo, self.specializations.items.len);
+        defer self.specializations.allocator.free(spec_infos);
+        for (self.specializations.items) |*specialization, i| {
+            const spec = if (specialization.*) |*spec| spec else continue;
+            if (spec.count == 0) continue;
+            spec_infos[i] = spec.info();
+            self.shader_stages.items[i].p_specialization_info = &spec_infos[i];
+        }
 
         const viewport_state = vk.PipelineViewportStateCreateInfo{
             .flags = .{},
@@ -91,7 +160,7 @@ pub const PipelineBuilder = struct {
         var pipeline: vk.Pipeline = undefined;
         _ = try gc.vkd.createGraphicsPipelines(
             gc.dev,
-            .null_handle,
+            cache,
             1,
             @ptrCast([*]const vk.GraphicsPipelineCreateInfo, &gpci),
             null,
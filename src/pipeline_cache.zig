@@ -0,0 +1,94 @@
+const std = @import("std");
+const vk = @import("vulkan");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+
+/// A VkPipelineCache that survives restarts. The blob written by the driver is loaded at startup and handed to every
+/// pipeline build so the driver can skip compiling SPIR-V it has seen before, and is written back on `deinit`.
+pub const PipelineCache = struct {
+    /// refuse to read anything bigger, a cache that large is not ours
+    const max_file_size = 64 * 1024 * 1024;
+
+    gc: *const GraphicsContext,
+    allocator: std.mem.Allocator,
+    handle: vk.PipelineCache,
+    /// where the cache is read from and saved to. null keeps it in memory only.
+    path: ?[]const u8,
+
+    pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator, path: ?[]const u8) !PipelineCache {
+        const data = if (path) |p| try loadData(gc, allocator, p) else null;
+        defer if (data) |d| allocator.free(d);
+
+        const handle = try gc.vkd.createPipelineCache(gc.dev, &.{
+            .flags = .{},
+            .initial_data_size = if (data) |d| d.len else 0,
+            .p_initial_data = if (data) |d| @ptrCast(*const anyopaque, d.ptr) else undefined,
+        }, null);
+
+        return PipelineCache{
+            .gc = gc,
+            .allocator = allocator,
+            .handle = handle,
+            .path = path,
+        };
+    }
+
+    /// saves the cache, the device must be idle or at least done creating pipelines
+    pub fn deinit(self: PipelineCache) void {
+        self.save() catch |err| std.debug.print("failed writing pipeline cache to {s}: {}\n", .{ self.path.?, err });
+        self.gc.destroy(self.handle);
+    }
+
+    pub fn save(self: PipelineCache) !void {
+        const path = self.path orelse return;
+
+        var size: usize = 0;
+        _ = try self.gc.vkd.getPipelineCacheData(self.gc.dev, self.handle, &size, null);
+        const data = try self.allocator.alloc(u8, size);
+        defer self.allocator.free(data);
+        _ = try self.gc.vkd.getPipelineCacheData(self.gc.dev, self.handle, &size, data.ptr);
+
+        // write next to the target and rename so a crash mid write can not leave a truncated cache behind
+        var tmp_buf: [std.fs.MAX_PATH_BYTES]u8 = undefined;
+        const tmp_path = try std.fmt.bufPrint(&tmp_buf, "{s}.tmp", .{path});
+
+        const file = try std.fs.cwd().createFile(tmp_path, .{});
+        defer file.close();
+        try file.writeAll(data[0..size]);
+        try std.fs.cwd().rename(tmp_path, path);
+    }
+};
+
+/// returns the cache file contents or null when there is none or it was written by a different device or driver. Drivers
+/// validate the header as well but not all of them gracefully, so mismatches never reach vkCreatePipelineCache.
+fn loadData(gc: *const GraphicsContext, allocator: std.mem.Allocator, path: []const u8) !?[]u8 {
+    const data = std.fs.cwd().readFileAlloc(allocator, path, PipelineCache.max_file_size) catch |err| switch (err) {
+        error.FileNotFound => return null,
+        else => return err,
+    };
+
+    if (!isCompatible(gc, data)) {
+        std.debug.print("discarding pipeline cache {s}, it was created by a different device or driver\n", .{path});
+        allocator.free(data);
+        return null;
+    }
+    return data;
+}
+
+/// checks the VkPipelineCacheHeaderVersionOne every cache blob starts with against the current device
+fn isCompatible(gc: *const GraphicsContext, data: []const u8) bool {
+    const header_size = 16 + vk.UUID_SIZE;
+    if (data.len < header_size) return false;
+
+    const length = std.mem.readIntLittle(u32, data[0..4]);
+    const version = std.mem.readIntLittle(u32, data[4..8]);
+    const vendor_id = std.mem.readIntLittle(u32, data[8..12]);
+    const device_id = std.mem.readIntLittle(u32, data[12..16]);
+    const uuid = data[16..header_size];
+
+    return length >= header_size and
+        version == @enumToInt(vk.PipelineCacheHeaderVersion.one) and
+        vendor_id == gc.props.vendor_id and
+        device_id == gc.props.device_id and
+        std.mem.eql(u8, uuid, &gc.props.pipeline_cache_uuid);
+}
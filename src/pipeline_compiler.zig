@@ -0,0 +1,212 @@
+const std = @import("std");
+const vk = @import("vulkan");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+
+/// Builds pipelines on background threads so startup does not wait on the driver compiling every material. `submit`
+/// returns a handle right away, `poll` hands out the pipeline once it is done and `wait` blocks for it. All threads share
+/// one VkPipelineCache, which is internally synchronized.
+///
+/// `Desc` is whatever `buildFn` needs to create a pipeline and is copied, so anything it points at has to outlive the
+/// build. The compiler owns every pipeline it builds and destroys them in `release` or `deinit`. Released handles are
+/// reused by later submits.
+///
+/// The JobPool is not used for this: `parallelFor` blocks its caller, while these builds have to keep running across
+/// frames.
+pub fn PipelineCompiler(comptime Desc: type, comptime buildFn: fn (*const GraphicsContext, std.mem.Allocator, vk.PipelineCache, Desc) anyerror!vk.Pipeline) type {
+    return struct {
+        const Self = @This();
+
+        pub const Handle = u32;
+
+        const State = enum { queued, ready, failed, free };
+
+        const Entry = struct {
+            desc: Desc,
+            state: State = .queued,
+            pipeline: vk.Pipeline = .null_handle,
+            /// released while still building, the worker destroys the pipeline as soon as it is done
+            released: bool = false,
+        };
+
+        gc: *const GraphicsContext,
+        allocator: std.mem.Allocator,
+        cache: vk.PipelineCache,
+        threads: []std.Thread,
+        mutex: std.Thread.Mutex = .{},
+        wake: std.Thread.Condition = .{},
+        /// signalled whenever an entry leaves the queued state
+        done: std.Thread.Condition = .{},
+        entries: std.ArrayList(Entry),
+        /// submitted entries no thread picked up yet, oldest first
+        queue: std.ArrayList(Handle),
+        /// released entries that `submit` can reuse
+        free_handles: std.ArrayList(Handle),
+        quit: bool = false,
+
+        /// `thread_count` is clamped to at least one, otherwise nothing would ever get built
+        pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator, cache: vk.PipelineCache, thread_count: usize) !*Self {
+            const self = try allocator.create(Self);
+            errdefer allocator.destroy(self);
+
+            self.* = .{
+                .gc = gc,
+                .allocator = allocator,
+                .cache = cache,
+                .threads = try allocator.alloc(std.Thread, std.math.max(thread_count, 1)),
+                .entries = std.ArrayList(Entry).init(allocator),
+                .queue = std.ArrayList(Handle).init(allocator),
+                .free_handles = std.ArrayList(Handle).init(allocator),
+            };
+            errdefer allocator.free(self.threads);
+
+            for (self.threads) |*thread, i| {
+                thread.* = std.Thread.spawn(.{}, workerMain, .{self}) catch |err| {
+                    self.stop(self.threads[0..i]);
+                    return err;
+                };
+            }
+
+            return self;
+        }
+
+        /// one thread per core besides the calling thread, capped at `max_threads`
+        pub fn initForCpu(gc: *const GraphicsContext, allocator: std.mem.Allocator, cache: vk.PipelineCache, max_threads: usize) !*Self {
+            const cpu_count = std.Thread.getCpuCount() catch 1;
+            return try init(gc, allocator, cache, std.math.min(cpu_count -| 1, max_threads));
+        }
+
+        /// waits for builds already running, queued ones are dropped
+        pub fn deinit(self: *Self) void {
+            self.stop(self.threads);
+            for (self.entries.items) |entry| {
+                if (entry.state == .ready) self.gc.destroy(entry.pipeline);
+            }
+            self.entries.deinit();
+            self.queue.deinit();
+            self.free_handles.deinit();
+            self.allocator.free(self.threads);
+            self.allocator.destroy(self);
+        }
+
+        pub fn submit(self: *Self, desc: Desc) !Handle {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+
+            try self.queue.ensureUnusedCapacity(1);
+            const handle = if (self.free_handles.popOrNull()) |handle| blk: {
+                self.entries.items[handle] = .{ .desc = desc };
+                break :blk handle;
+            } else blk: {
+                try self.entries.append(.{ .desc = desc });
+                break :blk @intCast(Handle, self.entries.items.len - 1);
+            };
+
+            self.queue.appendAssumeCapacity(handle);
+            self.wake.signal();
+            return handle;
+        }
+
+        /// destroys the pipeline of `handle` and recycles the handle, which must not be used afterwards. Nothing on the
+        /// GPU may still use the pipeline. A build that is still running is finished and thrown away.
+        pub fn release(self: *Self, handle: Handle) void {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+
+            const entry = &self.entries.items[handle];
+            std.debug.assert(entry.state != .free and !entry.released);
+            if (entry.state == .queued) {
+                entry.released = true;
+                return;
+            }
+            self.freeEntry(handle);
+        }
+
+        /// the pipeline if it finished building, null while it is still queued or building
+        pub fn poll(self: *Self, handle: Handle) !?vk.Pipeline {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+
+            const entry = self.entries.items[handle];
+            return switch (entry.state) {
+                .queued => null,
+                .ready => entry.pipeline,
+                .failed => error.PipelineBuildFailed,
+                .free => error.PipelineReleased,
+            };
+        }
+
+        pub fn wait(self: *Self, handle: Handle) !vk.Pipeline {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+
+            while (self.entries.items[handle].state == .queued) self.done.wait(&self.mutex);
+
+            const entry = self.entries.items[handle];
+            return switch (entry.state) {
+                .queued => unreachable,
+                .ready => entry.pipeline,
+                .failed => error.PipelineBuildFailed,
+                .free => error.PipelineReleased,
+            };
+        }
+
+        /// builds that were submitted and did not finish yet
+        pub fn pendingCount(self: *Self) usize {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+
+            var count: usize = 0;
+            for (self.entries.items) |entry| {
+                if (entry.state == .queued) count += 1;
+            }
+            return count;
+        }
+
+        fn workerMain(self: *Self) void {
+            self.mutex.lock();
+            defer self.mutex.unlock();
+
+            while (true) {
+                while (self.queue.items.len == 0 and !self.quit) self.wake.wait(&self.mutex);
+                if (self.quit) return;
+
+                const index = self.queue.orderedRemove(0);
+                // entries may be reallocated by `submit` while the build runs, so only a copy is used unlocked
+                const desc = self.entries.items[index].desc;
+                self.mutex.unlock();
+
+                const result = buildFn(self.gc, self.allocator, self.cache, desc);
+
+                self.mutex.lock();
+                const entry = &self.entries.items[index];
+                if (result) |pipeline| {
+                    entry.pipeline = pipeline;
+                    entry.state = .ready;
+                } else |err| {
+                    std.debug.print("pipeline build {d} failed: {}\n", .{ index, err });
+                    entry.state = .failed;
+                }
+                if (entry.released) self.freeEntry(index);
+                self.done.broadcast();
+            }
+        }
+
+        /// the mutex must be held. Out of memory only means the handle is not reused.
+        fn freeEntry(self: *Self, handle: Handle) void {
+            const entry = &self.entries.items[handle];
+            if (entry.state == .ready) self.gc.destroy(entry.pipeline);
+            entry.* = .{ .desc = undefined, .state = .free };
+            self.free_handles.append(handle) catch {};
+        }
+
+        fn stop(self: *Self, threads: []std.Thread) void {
+            self.mutex.lock();
+            self.quit = true;
+            self.wake.broadcast();
+            self.mutex.unlock();
+
+            for (threads) |thread| thread.join();
+        }
+    };
+}
@@ -0,0 +1,993 @@
+const std = @import("std");
+const vk = @import("vulkan");
+const vma = @import("vma");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+const CommandBuffer = @import("vk_objs/command_buffer.zig").CommandBuffer;
+const FrameBufferAttachment = @import("vk_objs/frame_buffer_attachment.zig").FrameBufferAttachment;
+const OffscreenPass = @import("vk_objs/offscreen_pass.zig").OffscreenPass;
+const GpuProfiler = @import("gpu_profiler.zig").GpuProfiler;
+
+/// A frame described as passes that declare how they use images and buffers. `compile` drops the passes whose results
+/// nothing reads, works out the barriers between the rest and places transient images that are never alive at the same
+/// time in the same memory, `execute` records it all. The graph is meant to be rebuilt every frame with `reset`, the
+/// Vulkan objects behind it (transient images, render passes, framebuffers) are cached and only recreated when they change.
+///
+/// Images are either imported, e.g. the swapchain image, or transient, which the graph creates and which never hold
+/// anything across frames. Buffers are always imported. Passes run in the order they were added.
+pub const RenderGraph = struct {
+    pub const ImageHandle = struct { index: u32 };
+    pub const BufferHandle = struct { index: u32 };
+
+    /// how a pass uses a resource. Each maps to the stages, accesses and image layout of `usageOf`.
+    pub const Access = enum {
+        color_attachment,
+        depth_attachment,
+        /// depth testing without writes
+        depth_read,
+        sampled_fragment,
+        sampled_compute,
+        storage_read_vertex,
+        storage_read_compute,
+        storage_write_compute,
+        indirect,
+        transfer_src,
+        transfer_dst,
+    };
+
+    /// what touched an imported resource last before the graph, e.g. the stage the image acquire semaphore is waited on
+    pub const ImportState = struct {
+        layout: vk.ImageLayout = .@"undefined",
+        stages: vk.PipelineStageFlags = .{},
+        access: vk.AccessFlags = .{},
+    };
+
+    pub const ImportedImage = struct {
+        image: vk.Image,
+        view: vk.ImageView,
+        format: vk.Format,
+        extent: vk.Extent2D,
+        aspect_mask: vk.ImageAspectFlags = .{ .color_bit = true },
+        initial: ImportState = .{},
+        /// the image is moved into this layout after its last use, e.g. present_src_khr for the swapchain
+        final_layout: ?vk.ImageLayout = null,
+    };
+
+    pub const TransientImage = struct {
+        format: vk.Format,
+        extent: vk.Extent2D,
+        aspect_mask: vk.ImageAspectFlags = .{ .color_bit = true },
+    };
+
+    /// handed to a pass while it records. Passes with attachments run inside `render_pass`, which is already begun.
+    pub const PassContext = struct {
+        cmd: CommandBuffer,
+        render_pass: vk.RenderPass = .null_handle,
+        framebuffer: vk.Framebuffer = .null_handle,
+        extent: vk.Extent2D = .{ .width = 0, .height = 0 },
+    };
+
+    /// declares what a pass uses, returned by `addPass`
+    pub const PassBuilder = struct {
+        graph: *RenderGraph,
+        pass: u32,
+
+        pub fn readImage(self: PassBuilder, image: ImageHandle, access: Access) !void {
+            std.debug.assert(!usageOf(access).writes);
+            try self.graph.image_uses.append(self.graph.allocator, .{ .pass = self.pass, .image = image.index, .access = access });
+        }
+
+        pub fn writeImage(self: PassBuilder, image: ImageHandle, access: Access) !void {
+            std.debug.assert(usageOf(access).writes);
+            try self.graph.image_uses.append(self.graph.allocator, .{ .pass = self.pass, .image = image.index, .access = access });
+        }
+
+        /// without `clear` the previous contents are loaded, which makes the pass read the image as well
+        pub fn colorAttachment(self: PassBuilder, image: ImageHandle, clear: ?vk.ClearColorValue) !void {
+            try self.graph.image_uses.append(self.graph.allocator, .{
+                .pass = self.pass,
+                .image = image.index,
+                .access = .color_attachment,
+                .clear = if (clear) |c| vk.ClearValue{ .color = c } else null,
+            });
+        }
+
+        pub fn depthAttachment(self: PassBuilder, image: ImageHandle, clear: ?f32) !void {
+            try self.graph.image_uses.append(self.graph.allocator, .{
+                .pass = self.pass,
+                .image = image.index,
+                .access = .depth_attachment,
+                .clear = if (clear) |depth| vk.ClearValue{ .depth_stencil = .{ .depth = depth, .stencil = 0 } } else null,
+            });
+        }
+
+        pub fn readBuffer(self: PassBuilder, buffer: BufferHandle, access: Access) !void {
+            std.debug.assert(!usageOf(access).writes);
+            try self.graph.buffer_uses.append(self.graph.allocator, .{ .pass = self.pass, .buffer = buffer.index, .access = access });
+        }
+
+        pub fn writeBuffer(self: PassBuilder, buffer: BufferHandle, access: Access) !void {
+            std.debug.assert(usageOf(access).writes);
+            try self.graph.buffer_uses.append(self.graph.allocator, .{ .pass = self.pass, .buffer = buffer.index, .access = access });
+        }
+
+        /// keeps the pass even if nothing in the graph reads what it writes
+        pub fn sideEffects(self: PassBuilder) void {
+            self.graph.passes.items[self.pass].side_effects = true;
+        }
+
+        /// the pass records its render pass contents into secondary command buffers
+        pub fn secondaryCommandBuffers(self: PassBuilder) void {
+            self.graph.passes.items[self.pass].contents = .secondary_command_buffers;
+        }
+    };
+
+    const Usage = struct {
+        stages: vk.PipelineStageFlags,
+        access: vk.AccessFlags,
+        /// ignored for buffers
+        layout: vk.ImageLayout,
+        writes: bool,
+    };
+
+    const Pass = struct {
+        name: []const u8,
+        ctx: *anyopaque,
+        func: fn (ctx: *anyopaque, pass: PassContext) anyerror!void,
+        side_effects: bool = false,
+        contents: vk.SubpassContents = .@"inline",
+        // filled in by `plan`
+        live: bool = false,
+        barrier: Barrier = .{},
+        attachments: [OffscreenPass.max_color_attachments + 1]u32 = undefined,
+        attachment_count: u32 = 0,
+        has_depth: bool = false,
+        offscreen: OffscreenKey = undefined,
+    };
+
+    const ImageUse = struct {
+        pass: u32,
+        image: u32,
+        access: Access,
+        clear: ?vk.ClearValue = null,
+    };
+
+    const BufferUse = struct {
+        pass: u32,
+        buffer: u32,
+        access: Access,
+    };
+
+    const Image = struct {
+        format: vk.Format,
+        extent: vk.Extent2D,
+        aspect_mask: vk.ImageAspectFlags,
+        /// null for transient images
+        imported: ?ImportedImage,
+        /// of transient images set by `realize`
+        image: vk.Image = .null_handle,
+        view: vk.ImageView = .null_handle,
+        // filled in by `plan`
+        usage: vk.ImageUsageFlags = .{},
+        first_use: u32 = 0,
+        last_use: u32 = 0,
+        used: bool = false,
+        state: State = .{},
+    };
+
+    const Buffer = struct {
+        buffer: vk.Buffer,
+        initial: ImportState,
+        state: State = .{},
+    };
+
+    /// sync state of one resource while walking the passes
+    const State = struct {
+        layout: vk.ImageLayout = .@"undefined",
+        /// the last write, which the next user has to wait for and make visible
+        write_stages: vk.PipelineStageFlags = .{},
+        write_access: vk.AccessFlags = .{},
+        /// stages that read since the last write, the next write has to wait for them
+        read_stages: vk.PipelineStageFlags = .{},
+        /// where the last write was already made visible, later reads there need no barrier
+        visible_stages: vk.PipelineStageFlags = .{},
+        visible_access: vk.AccessFlags = .{},
+    };
+
+    /// everything recorded before a pass, merged into one vkCmdPipelineBarrier. Buffers share a global memory barrier.
+    const Barrier = struct {
+        src_stages: vk.PipelineStageFlags = .{},
+        dst_stages: vk.PipelineStageFlags = .{},
+        src_access: vk.AccessFlags = .{},
+        dst_access: vk.AccessFlags = .{},
+        /// range in `transitions`
+        first_transition: u32 = 0,
+        transition_count: u32 = 0,
+
+        fn isEmpty(self: Barrier) bool {
+            return self.src_stages.toInt() == 0 and self.dst_stages.toInt() == 0;
+        }
+    };
+
+    const Transition = struct {
+        image: u32,
+        src_access: vk.AccessFlags,
+        dst_access: vk.AccessFlags,
+        old_layout: vk.ImageLayout,
+        new_layout: vk.ImageLayout,
+    };
+
+    const OffscreenKey = struct {
+        /// color attachments then depth, unused entries zeroed so keys compare by value
+        formats: [OffscreenPass.max_color_attachments + 1]vk.Format = [_]vk.Format{.@"undefined"} ** (OffscreenPass.max_color_attachments + 1),
+        load_ops: [OffscreenPass.max_color_attachments + 1]vk.AttachmentLoadOp = [_]vk.AttachmentLoadOp{.dont_care} ** (OffscreenPass.max_color_attachments + 1),
+        store_ops: [OffscreenPass.max_color_attachments + 1]vk.AttachmentStoreOp = [_]vk.AttachmentStoreOp{.dont_care} ** (OffscreenPass.max_color_attachments + 1),
+        layouts: [OffscreenPass.max_color_attachments + 1]vk.ImageLayout = [_]vk.ImageLayout{.@"undefined"} ** (OffscreenPass.max_color_attachments + 1),
+        color_count: u32 = 0,
+        has_depth: bool = false,
+    };
+
+    const FramebufferKey = struct {
+        render_pass: vk.RenderPass,
+        views: [OffscreenPass.max_color_attachments + 1]vk.ImageView,
+        width: u32,
+        height: u32,
+    };
+
+    /// where a transient lives in the shared memory, see `placeAliased`
+    const Lifetime = struct {
+        size: vk.DeviceSize,
+        alignment: vk.DeviceSize,
+        first: u32,
+        last: u32,
+    };
+
+    gc: *const GraphicsContext,
+    allocator: std.mem.Allocator,
+    passes: std.ArrayListUnmanaged(Pass) = .{},
+    images: std.ArrayListUnmanaged(Image) = .{},
+    buffers: std.ArrayListUnmanaged(Buffer) = .{},
+    image_uses: std.ArrayListUnmanaged(ImageUse) = .{},
+    buffer_uses: std.ArrayListUnmanaged(BufferUse) = .{},
+    transitions: std.ArrayListUnmanaged(Transition) = .{},
+    /// barrier into the final layouts of imported images after the last pass
+    final_barrier: Barrier = .{},
+    /// the transient images of the last `realize` and what they were created for
+    transients: std.ArrayListUnmanaged(FrameBufferAttachment) = .{},
+    transients_hash: u64 = 0,
+    transient_memory: ?vma.VmaAllocation = null,
+    /// bytes taken by all transients together, less than their sum when some share memory
+    transient_memory_size: vk.DeviceSize = 0,
+    offscreen_passes: std.AutoHashMapUnmanaged(OffscreenKey, OffscreenPass) = .{},
+    framebuffers: std.AutoHashMapUnmanaged(FramebufferKey, vk.Framebuffer) = .{},
+    /// passes dropped by the last `compile` since nothing used their results
+    culled_count: u32 = 0,
+
+    pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator) RenderGraph {
+        return .{ .gc = gc, .allocator = allocator };
+    }
+
+    /// no frame recorded by the graph may still be in flight
+    pub fn deinit(self: *RenderGraph) void {
+        self.destroyTransients();
+        self.invalidateFramebuffers();
+        self.framebuffers.deinit(self.allocator);
+
+        var iter = self.offscreen_passes.valueIterator();
+        while (iter.next()) |pass| pass.deinit(self.gc);
+        self.offscreen_passes.deinit(self.allocator);
+
+        self.passes.deinit(self.allocator);
+        self.images.deinit(self.allocator);
+        self.buffers.deinit(self.allocator);
+        self.image_uses.deinit(self.allocator);
+        self.buffer_uses.deinit(self.allocator);
+        self.transitions.deinit(self.allocator);
+        self.transients.deinit(self.allocator);
+    }
+
+    /// drops the passes and resources of the last frame, cached Vulkan objects are kept
+    pub fn reset(self: *RenderGraph) void {
+        self.passes.clearRetainingCapacity();
+        self.images.clearRetainingCapacity();
+        self.buffers.clearRetainingCapacity();
+        self.image_uses.clearRetainingCapacity();
+        self.buffer_uses.clearRetainingCapacity();
+        self.transitions.clearRetainingCapacity();
+        self.final_barrier = .{};
+    }
+
+    /// destroys the cached framebuffers. Has to be called once views they reference are destroyed, e.g. when the swapchain
+    /// is recreated, and no frame using them may be in flight.
+    pub fn invalidateFramebuffers(self: *RenderGraph) void {
+        var iter = self.framebuffers.valueIterator();
+        while (iter.next()) |fb| self.gc.destroy(fb.*);
+        self.framebuffers.clearRetainingCapacity();
+    }
+
+    pub fn importImage(self: *RenderGraph, image: ImportedImage) !ImageHandle {
+        try self.images.append(self.allocator, .{
+            .format = image.format,
+            .extent = image.extent,
+            .aspect_mask = image.aspect_mask,
+            .imported = image,
+            .image = image.image,
+            .view = image.view,
+        });
+        return ImageHandle{ .index = @intCast(u32, self.images.items.len - 1) };
+    }
+
+    /// an image only alive during the frame, created by the graph with the usage flags its passes need
+    pub fn createImage(self: *RenderGraph, image: TransientImage) !ImageHandle {
+        try self.images.append(self.allocator, .{
+            .format = image.format,
+            .extent = image.extent,
+            .aspect_mask = image.aspect_mask,
+            .imported = null,
+        });
+        return ImageHandle{ .index = @intCast(u32, self.images.items.len - 1) };
+    }
+
+    pub fn importBuffer(self: *RenderGraph, buffer: vk.Buffer, initial: ImportState) !BufferHandle {
+        try self.buffers.append(self.allocator, .{ .buffer = buffer, .initial = initial });
+        return BufferHandle{ .index = @intCast(u32, self.buffers.items.len - 1) };
+    }
+
+    /// adds a pass that calls `func(context, pass_context)` to record itself. `context` has to be a pointer that stays valid
+    /// until `execute` returned.
+    pub fn addPass(self: *RenderGraph, name: []const u8, context: anytype, comptime func: fn (@TypeOf(context), PassContext) anyerror!void) !PassBuilder {
+        const Context = @TypeOf(context);
+        const Erased = struct {
+            fn call(ptr: *anyopaque, pass: PassContext) anyerror!void {
+                return func(@ptrCast(Context, @alignCast(@alignOf(std.meta.Child(Context)), ptr)), pass);
+            }
+        };
+
+        try self.passes.append(self.allocator, .{
+            .name = name,
+            .ctx = @ptrCast(*anyopaque, context),
+            .func = Erased.call,
+        });
+        return PassBuilder{ .graph = self, .pass = @intCast(u32, self.passes.items.len - 1) };
+    }
+
+    /// culls passes, computes barriers and makes sure the transient images and render passes exist
+    pub fn compile(self: *RenderGraph) !void {
+        try self.plan();
+        try self.realize();
+    }
+
+    /// records the live passes. With a profiler every pass is timed in a scope named after it, render pass included.
+    pub fn execute(self: *RenderGraph, cmd: CommandBuffer, profiler: ?*GpuProfiler) !void {
+        for (self.passes.items) |pass, pass_index| {
+            if (!pass.live) continue;
+            self.recordBarrier(cmd, pass.barrier);
+
+            const scope = if (profiler) |p| try p.begin(cmd, pass.name) else null;
+
+            var context = PassContext{ .cmd = cmd };
+            if (pass.attachment_count > 0) {
+                const first = self.images.items[pass.attachments[0]];
+                context.extent = first.extent;
+                context.render_pass = self.offscreen_passes.get(pass.offscreen).?.render_pass;
+                context.framebuffer = try self.getFramebuffer(context.render_pass, pass, first.extent);
+
+                var clear_values: [OffscreenPass.max_color_attachments + 1]vk.ClearValue = undefined;
+                for (pass.attachments[0..pass.attachment_count]) |image, i| {
+                    clear_values[i] = self.clearValue(pass_index, image) orelse .{ .color = .{ .float_32 = .{ 0, 0, 0, 0 } } };
+                }
+
+                cmd.beginRenderPass(&.{
+                    .render_pass = context.render_pass,
+                    .framebuffer = context.framebuffer,
+                    .render_area = .{ .offset = .{ .x = 0, .y = 0 }, .extent = first.extent },
+                    .clear_value_count = pass.attachment_count,
+                    .p_clear_values = &clear_values,
+                }, pass.contents);
+            }
+
+            try pass.func(pass.ctx, context);
+            if (pass.attachment_count > 0) cmd.endRenderPass();
+
+            if (profiler) |p| p.end(cmd, scope);
+        }
+
+        self.recordBarrier(cmd, self.final_barrier);
+    }
+
+    pub fn usageOf(access: Access) Usage {
+        return switch (access) {
+            .color_attachment => .{
+                .stages = .{ .color_attachment_output_bit = true },
+                .access = .{ .color_attachment_read_bit = true, .color_attachment_write_bit = true },
+                .layout = .color_attachment_optimal,
+                .writes = true,
+            },
+            .depth_attachment => .{
+                .stages = .{ .early_fragment_tests_bit = true, .late_fragment_tests_bit = true },
+                .access = .{ .depth_stencil_attachment_read_bit = true, .depth_stencil_attachment_write_bit = true },
+                .layout = .depth_stencil_attachment_optimal,
+                .writes = true,
+            },
+            .depth_read => .{
+                .stages = .{ .early_fragment_tests_bit = true, .late_fragment_tests_bit = true },
+                .access = .{ .depth_stencil_attachment_read_bit = true },
+                .layout = .depth_stencil_read_only_optimal,
+                .writes = false,
+            },
+            .sampled_fragment => .{
+                .stages = .{ .fragment_shader_bit = true },
+                .access = .{ .shader_read_bit = true },
+                .layout = .shader_read_only_optimal,
+                .writes = false,
+            },
+            .sampled_compute => .{
+                .stages = .{ .compute_shader_bit = true },
+                .access = .{ .shader_read_bit = true },
+                .layout = .shader_read_only_optimal,
+                .writes = false,
+            },
+            .storage_read_vertex => .{
+                .stages = .{ .vertex_shader_bit = true },
+                .access = .{ .shader_read_bit = true },
+                .layout = .general,
+                .writes = false,
+            },
+            .storage_read_compute => .{
+                .stages = .{ .compute_shader_bit = true },
+                .access = .{ .shader_read_bit = true },
+                .layout = .general,
+                .writes = false,
+            },
+            .storage_write_compute => .{
+                .stages = .{ .compute_shader_bit = true },
+                .access = .{ .shader_read_bit = true, .shader_write_bit = true },
+                .layout = .general,
+                .writes = true,
+            },
+            .indirect => .{
+                .stages = .{ .draw_indirect_bit = true },
+                .access = .{ .indirect_command_read_bit = true },
+                .layout = .@"undefined",
+                .writes = false,
+            },
+            .transfer_src => .{
+                .stages = .{ .transfer_bit = true },
+                .access = .{ .transfer_read_bit = true },
+                .layout = .transfer_src_optimal,
+                .writes = false,
+            },
+            .transfer_dst => .{
+                .stages = .{ .transfer_bit = true },
+                .access = .{ .transfer_write_bit = true },
+                .layout = .transfer_dst_optimal,
+                .writes = true,
+            },
+        };
+    }
+
+    fn imageUsageFlags(access: Access) vk.ImageUsageFlags {
+        return switch (access) {
+            .color_attachment => .{ .color_attachment_bit = true },
+            .depth_attachment, .depth_read => .{ .depth_stencil_attachment_bit = true },
+            .sampled_fragment, .sampled_compute => .{ .sampled_bit = true },
+            .storage_read_vertex, .storage_read_compute, .storage_write_compute => .{ .storage_bit = true },
+            .transfer_src => .{ .transfer_src_bit = true },
+            .transfer_dst => .{ .transfer_dst_bit = true },
+            .indirect => .{},
+        };
+    }
+
+    fn writeAccessOf(access: vk.AccessFlags) vk.AccessFlags {
+        return access.intersect(.{
+            .shader_write_bit = true,
+            .color_attachment_write_bit = true,
+            .depth_stencil_attachment_write_bit = true,
+            .transfer_write_bit = true,
+            .host_write_bit = true,
+            .memory_write_bit = true,
+        });
+    }
+
+    /// attachments without a clear value load what is already there
+    fn readsPrevious(use: ImageUse) bool {
+        return switch (use.access) {
+            .color_attachment, .depth_attachment => use.clear == null,
+            else => !usageOf(use.access).writes,
+        };
+    }
+
+    /// everything that only depends on the declarations: which passes run, their barriers and attachments, transient
+    /// lifetimes. Touches no Vulkan objects.
+    fn plan(self: *RenderGraph) !void {
+        self.cull();
+        self.transitions.clearRetainingCapacity();
+
+        for (self.images.items) |*image| {
+            image.used = false;
+            image.usage = .{};
+            image.first_use = 0;
+            image.last_use = 0;
+        }
+
+        // lifetimes and usage flags of the images the live passes touch, in pass order
+        for (self.image_uses.items) |use| {
+            if (!self.passes.items[use.pass].live) continue;
+            const image = &self.images.items[use.image];
+            image.first_use = if (image.used) std.math.min(image.first_use, use.pass) else use.pass;
+            image.used = true;
+            image.last_use = std.math.max(image.last_use, use.pass);
+            image.usage = image.usage.merge(imageUsageFlags(use.access));
+        }
+
+        // a transient may share memory with one used at the end of the previous frame or earlier in this one, so its first
+        // barrier waits for whatever the transients were used for last
+        var transient_reuse = State{};
+        for (self.images.items) |image, image_index| {
+            if (image.imported != null or !image.used) continue;
+            for (self.image_uses.items) |use| {
+                if (use.image != image_index or use.pass != image.last_use) continue;
+                const usage = usageOf(use.access);
+                transient_reuse.write_stages = transient_reuse.write_stages.merge(usage.stages);
+                transient_reuse.write_access = transient_reuse.write_access.merge(writeAccessOf(usage.access));
+            }
+        }
+
+        for (self.images.items) |*image| {
+            image.state = if (image.imported) |imported| .{
+                .layout = imported.initial.layout,
+                .write_stages = imported.initial.stages,
+                .write_access = imported.initial.access,
+            } else transient_reuse;
+        }
+        for (self.buffers.items) |*buffer| {
+            buffer.state = .{ .write_stages = buffer.initial.stages, .write_access = buffer.initial.access };
+        }
+
+        for (self.passes.items) |*pass, pass_index| {
+            if (!pass.live) continue;
+            pass.barrier = .{ .first_transition = @intCast(u32, self.transitions.items.len) };
+            pass.attachment_count = 0;
+            pass.has_depth = false;
+            pass.offscreen = .{};
+
+            var depth: ?u32 = null;
+            for (self.image_uses.items) |use| {
+                if (use.pass != pass_index) continue;
+                const image = &self.images.items[use.image];
+                const usage = usageOf(use.access);
+                const layout_before = image.state.layout;
+                try self.addImageBarrier(&pass.barrier, use.image, usage);
+
+                switch (use.access) {
+                    .color_attachment, .depth_attachment, .depth_read => {
+                        // depth always takes the last slot so keys do not depend on declaration order
+                        const slot = if (use.access == .color_attachment) pass.offscreen.color_count else OffscreenPass.max_color_attachments;
+                        std.debug.assert(use.access != .color_attachment or slot < OffscreenPass.max_color_attachments);
+                        pass.offscreen.formats[slot] = image.format;
+                        pass.offscreen.layouts[slot] = usage.layout;
+                        pass.offscreen.load_ops[slot] = if (use.clear != null) .clear else if (layout_before == .@"undefined") .dont_care else .load;
+                        pass.offscreen.store_ops[slot] = if (image.imported != null or image.last_use > pass_index) .store else .dont_care;
+
+                        if (use.access == .color_attachment) {
+                            pass.attachments[pass.offscreen.color_count] = use.image;
+                            pass.offscreen.color_count += 1;
+                        } else {
+                            depth = use.image;
+                            pass.offscreen.has_depth = true;
+                        }
+                    },
+                    else => {},
+                }
+            }
+            pass.attachment_count = pass.offscreen.color_count;
+            if (depth) |d| {
+                pass.attachments[pass.attachment_count] = d;
+                pass.attachment_count += 1;
+                pass.has_depth = true;
+            }
+
+            for (self.buffer_uses.items) |use| {
+                if (use.pass != pass_index) continue;
+                addBufferBarrier(&pass.barrier, &self.buffers.items[use.buffer].state, usageOf(use.access));
+            }
+        }
+
+        // imported images are handed back in the layout the caller asked for
+        self.final_barrier = .{ .first_transition = @intCast(u32, self.transitions.items.len) };
+        for (self.images.items) |*image, i| {
+            const imported = image.imported orelse continue;
+            const final_layout = imported.final_layout orelse continue;
+            if (image.state.layout == final_layout) continue;
+            try self.addImageBarrier(&self.final_barrier, @intCast(u32, i), .{
+                .stages = .{ .bottom_of_pipe_bit = true },
+                .access = .{},
+                .layout = final_layout,
+                .writes = false,
+            });
+        }
+    }
+
+    /// walks the passes backwards, a pass is kept when it has side effects or writes something a kept pass reads or that
+    /// outlives the graph
+    fn cull(self: *RenderGraph) void {
+        for (self.images.items) |*image| image.used = false;
+
+        self.culled_count = 0;
+        var i = self.passes.items.len;
+        while (i > 0) {
+            i -= 1;
+            const pass = &self.passes.items[i];
+            pass.live = pass.side_effects;
+
+            if (!pass.live) {
+                for (self.image_uses.items) |use| {
+                    if (use.pass != i or !usageOf(use.access).writes) continue;
+                    const image = self.images.items[use.image];
+                    if (image.imported != null or image.used) pass.live = true;
+                }
+                for (self.buffer_uses.items) |use| {
+                    if (use.pass == i and usageOf(use.access).writes) pass.live = true;
+                }
+            }
+
+            if (!pass.live) {
+                self.culled_count += 1;
+                continue;
+            }
+
+            // `used` doubles as "needed by a later live pass" until `plan` recomputes it
+            for (self.image_uses.items) |use| {
+                if (use.pass == i and readsPrevious(use)) self.images.items[use.image].used = true;
+            }
+        }
+    }
+
+    fn addImageBarrier(self: *RenderGraph, barrier: *Barrier, image_index: u32, usage: Usage) !void {
+        const state = &self.images.items[image_index].state;
+        const layout_change = state.layout != usage.layout;
+
+        if (!usage.writes and !layout_change) {
+            // read after read, or after a write that is already visible to this stage
+            defer state.read_stages = state.read_stages.merge(usage.stages);
+            if (state.write_stages.toInt() == 0) return;
+            if (state.visible_stages.contains(usage.stages) and state.visible_access.contains(usage.access)) return;
+
+            barrier.src_stages = barrier.src_stages.merge(state.write_stages);
+            barrier.dst_stages = barrier.dst_stages.merge(usage.stages);
+            barrier.src_access = barrier.src_access.merge(state.write_access);
+            barrier.dst_access = barrier.dst_access.merge(usage.access);
+            state.visible_stages = state.visible_stages.merge(usage.stages);
+            state.visible_access = state.visible_access.merge(usage.access);
+            return;
+        }
+
+        // writes and layout transitions wait for the last write and every read since
+        try self.transitions.append(self.allocator, .{
+            .image = image_index,
+            .src_access = state.write_access,
+            .dst_access = usage.access,
+            .old_layout = state.layout,
+            .new_layout = usage.layout,
+        });
+        barrier.transition_count += 1;
+        barrier.src_stages = barrier.src_stages.merge(state.write_stages.merge(state.read_stages));
+        barrier.dst_stages = barrier.dst_stages.merge(usage.stages);
+
+        state.layout = usage.layout;
+        // a transition counts as a write that is made visible to this usage only
+        state.write_stages = usage.stages;
+        state.write_access = if (usage.writes) writeAccessOf(usage.access) else .{};
+        state.read_stages = .{};
+        state.visible_stages = if (usage.writes) .{} else usage.stages;
+        state.visible_access = if (usage.writes) .{} else usage.access;
+    }
+
+    fn addBufferBarrier(barrier: *Barrier, state: *State, usage: Usage) void {
+        if (!usage.writes) {
+            defer state.read_stages = state.read_stages.merge(usage.stages);
+            if (state.write_stages.toInt() == 0) return;
+            if (state.visible_stages.contains(usage.stages) and state.visible_access.contains(usage.access)) return;
+
+            barrier.src_stages = barrier.src_stages.merge(state.write_stages);
+            barrier.dst_stages = barrier.dst_stages.merge(usage.stages);
+            barrier.src_access = barrier.src_access.merge(state.write_access);
+            barrier.dst_access = barrier.dst_access.merge(usage.access);
+            state.visible_stages = state.visible_stages.merge(usage.stages);
+            state.visible_access = state.visible_access.merge(usage.access);
+            return;
+        }
+
+        const src_stages = state.write_stages.merge(state.read_stages);
+        if (src_stages.toInt() != 0) {
+            barrier.src_stages = barrier.src_stages.merge(src_stages);
+            barrier.dst_stages = barrier.dst_stages.merge(usage.stages);
+            barrier.src_access = barrier.src_access.merge(state.write_access);
+            barrier.dst_access = barrier.dst_access.merge(usage.access);
+        }
+
+        state.* = .{ .write_stages = usage.stages, .write_access = writeAccessOf(usage.access) };
+    }
+
+    /// (re)creates the transient images when they changed since the last frame and the render passes of the live passes
+    fn realize(self: *RenderGraph) !void {
+        var hasher = std.hash.Wyhash.init(0);
+        for (self.images.items) |image| {
+            if (image.imported != null or !image.used) continue;
+            std.hash.autoHash(&hasher, image.format);
+            std.hash.autoHash(&hasher, image.extent.width);
+            std.hash.autoHash(&hasher, image.extent.height);
+            std.hash.autoHash(&hasher, image.usage.toInt());
+            std.hash.autoHash(&hasher, image.first_use);
+            std.hash.autoHash(&hasher, image.last_use);
+        }
+        const hash = hasher.final();
+
+        if (hash != self.transients_hash) {
+            // only happens when the frame setup changes, e.g. on resize, so waiting for frames using the old ones is fine
+            try self.gc.vkd.deviceWaitIdle(self.gc.dev);
+            self.invalidateFramebuffers();
+            self.destroyTransients();
+            try self.createTransients();
+            self.transients_hash = hash;
+        }
+
+        var transient: usize = 0;
+        for (self.images.items) |*image| {
+            if (image.imported != null or !image.used) continue;
+            image.image = self.transients.items[transient].image;
+            image.view = self.transients.items[transient].view;
+            transient += 1;
+        }
+
+        for (self.passes.items) |pass| {
+            if (!pass.live or pass.attachment_count == 0) continue;
+            const result = try self.offscreen_passes.getOrPut(self.allocator, pass.offscreen);
+            if (result.found_existing) continue;
+            errdefer _ = self.offscreen_passes.remove(pass.offscreen);
+
+            var colors: [OffscreenPass.max_color_attachments]OffscreenPass.Attachment = undefined;
+            for (colors[0..pass.offscreen.color_count]) |*color, i| color.* = offscreenAttachment(pass.offscreen, i);
+            const depth = if (pass.has_depth) offscreenAttachment(pass.offscreen, OffscreenPass.max_color_attachments) else null;
+            result.value_ptr.* = try OffscreenPass.init(self.gc, colors[0..pass.offscreen.color_count], depth);
+        }
+    }
+
+    fn offscreenAttachment(key: OffscreenKey, slot: usize) OffscreenPass.Attachment {
+        return .{
+            .format = key.formats[slot],
+            .layout = key.layouts[slot],
+            .load_op = key.load_ops[slot],
+            .store_op = key.store_ops[slot],
+        };
+    }
+
+    fn createTransients(self: *RenderGraph) !void {
+        var lifetimes = std.ArrayList(Lifetime).init(self.allocator);
+        defer lifetimes.deinit();
+
+        var memory_type_bits: u32 = std.math.maxInt(u32);
+        for (self.images.items) |image| {
+            if (image.imported != null or !image.used) continue;
+            const attachment = try FrameBufferAttachment.init(self.gc, image.format, image.extent, image.usage, image.aspect_mask);
+            self.transients.append(self.allocator, attachment) catch |err| {
+                attachment.deinit(self.gc);
+                return err;
+            };
+
+            const requirements = attachment.memoryRequirements(self.gc);
+            memory_type_bits &= requirements.memory_type_bits;
+            try lifetimes.append(.{
+                .size = requirements.size,
+                .alignment = requirements.alignment,
+                .first = image.first_use,
+                .last = image.last_use,
+            });
+        }
+        if (self.transients.items.len == 0) return;
+
+        const offsets = try self.allocator.alloc(vk.DeviceSize, lifetimes.items.len);
+        defer self.allocator.free(offsets);
+        self.transient_memory_size = placeAliased(lifetimes.items, offsets);
+
+        var alignment: vk.DeviceSize = 1;
+        for (lifetimes.items) |lifetime| alignment = std.math.max(alignment, lifetime.alignment);
+
+        self.transient_memory = try self.gc.allocator.allocateMemory(&.{
+            .size = self.transient_memory_size,
+            .alignment = alignment,
+            .memory_type_bits = memory_type_bits,
+        }, &std.mem.zeroInit(vma.VmaAllocationCreateInfo, .{ .usage = .gpu_only }));
+
+        for (self.transients.items) |*attachment, i| try attachment.bind(self.gc, self.transient_memory.?, offsets[i]);
+    }
+
+    fn destroyTransients(self: *RenderGraph) void {
+        for (self.transients.items) |attachment| attachment.deinit(self.gc);
+        self.transients.clearRetainingCapacity();
+        if (self.transient_memory) |memory| self.gc.allocator.freeMemory(memory);
+        self.transient_memory = null;
+        self.transient_memory_size = 0;
+        self.transients_hash = 0;
+    }
+
+    fn getFramebuffer(self: *RenderGraph, render_pass: vk.RenderPass, pass: Pass, extent: vk.Extent2D) !vk.Framebuffer {
+        var key = FramebufferKey{
+            .render_pass = render_pass,
+            .views = [_]vk.ImageView{.null_handle} ** (OffscreenPass.max_color_attachments + 1),
+            .width = extent.width,
+            .height = extent.height,
+        };
+        for (pass.attachments[0..pass.attachment_count]) |image, i| key.views[i] = self.images.items[image].view;
+
+        const result = try self.framebuffers.getOrPut(self.allocator, key);
+        if (result.found_existing) return result.value_ptr.*;
+        errdefer _ = self.framebuffers.remove(key);
+
+        result.value_ptr.* = try self.gc.vkd.createFramebuffer(self.gc.dev, &.{
+            .flags = .{},
+            .render_pass = render_pass,
+            .attachment_count = pass.attachment_count,
+            .p_attachments = &key.views,
+            .width = extent.width,
+            .height = extent.height,
+            .layers = 1,
+        }, null);
+        return result.value_ptr.*;
+    }
+
+    fn clearValue(self: RenderGraph, pass: usize, image: u32) ?vk.ClearValue {
+        for (self.image_uses.items) |use| {
+            if (use.pass == pass and use.image == image) return use.clear;
+        }
+        return null;
+    }
+
+    fn recordBarrier(self: RenderGraph, cmd: CommandBuffer, barrier: Barrier) void {
+        if (barrier.isEmpty()) return;
+
+        var image_barriers: [16]vk.ImageMemoryBarrier = undefined;
+        std.debug.assert(barrier.transition_count <= image_barriers.len);
+        const transitions = self.transitions.items[barrier.first_transition .. barrier.first_transition + barrier.transition_count];
+        for (transitions) |transition, i| {
+            const image = self.images.items[transition.image];
+            image_barriers[i] = .{
+                .src_access_mask = transition.src_access,
+                .dst_access_mask = transition.dst_access,
+                .old_layout = transition.old_layout,
+                .new_layout = transition.new_layout,
+                .src_queue_family_index = vk.QUEUE_FAMILY_IGNORED,
+                .dst_queue_family_index = vk.QUEUE_FAMILY_IGNORED,
+                .image = image.image,
+                .subresource_range = .{
+                    .aspect_mask = image.aspect_mask,
+                    .base_mip_level = 0,
+                    .level_count = vk.REMAINING_MIP_LEVELS,
+                    .base_array_layer = 0,
+                    .layer_count = vk.REMAINING_ARRAY_LAYERS,
+                },
+            };
+        }
+
+        const memory_barrier = vk.MemoryBarrier{ .src_access_mask = barrier.src_access, .dst_access_mask = barrier.dst_access };
+        const has_memory = barrier.src_access.toInt() != 0 or barrier.dst_access.toInt() != 0;
+        cmd.pipelineBarrier(
+            if (barrier.src_stages.toInt() == 0) .{ .top_of_pipe_bit = true } else barrier.src_stages,
+            if (barrier.dst_stages.toInt() == 0) .{ .bottom_of_pipe_bit = true } else barrier.dst_stages,
+            .{},
+            if (has_memory) 1 else 0,
+            @ptrCast([*]const vk.MemoryBarrier, &memory_barrier),
+            0,
+            undefined,
+            barrier.transition_count,
+            &image_barriers,
+        );
+    }
+};
+
+/// offsets that let resources which are never alive during the same passes share memory, first fit in declaration order.
+/// Returns the total size needed.
+fn placeAliased(lifetimes: []const RenderGraph.Lifetime, offsets: []vk.DeviceSize) vk.DeviceSize {
+    var total: vk.DeviceSize = 0;
+    for (lifetimes) |lifetime, i| {
+        // bumped past every placed resource that is alive at the same time and in the way until none is
+        var offset: vk.DeviceSize = 0;
+        var moved = true;
+        while (moved) {
+            moved = false;
+            for (lifetimes[0..i]) |other, j| {
+                if (other.last < lifetime.first or lifetime.last < other.first) continue;
+                if (offset >= offsets[j] + other.size or offsets[j] >= offset + lifetime.size) continue;
+                offset = std.mem.alignForwardGeneric(vk.DeviceSize, offsets[j] + other.size, lifetime.alignment);
+                moved = true;
+            }
+        }
+
+        offsets[i] = offset;
+        total = std.math.max(total, offset + lifetime.size);
+    }
+    return total;
+}
+
+fn noopPass(ctx: *u32, pass: RenderGraph.PassContext) anyerror!void {
+    _ = pass;
+    ctx.* += 1;
+}
+
+test "cull passes, barriers and aliasing" {
+    // planning never touches the device and neither does deinit while nothing was realized
+    var graph = RenderGraph.init(undefined, std.testing.allocator);
+    defer graph.deinit();
+
+    var calls: u32 = 0;
+    const swapchain = try graph.importImage(.{
+        .image = .null_handle,
+        .view = .null_handle,
+        .format = .b8g8r8a8_srgb,
+        .extent = .{ .width = 8, .height = 8 },
+        .initial = .{ .stages = .{ .color_attachment_output_bit = true } },
+        .final_layout = .present_src_khr,
+    });
+    const depth = try graph.createImage(.{ .format = .d32_sfloat, .extent = .{ .width = 8, .height = 8 }, .aspect_mask = .{ .depth_bit = true } });
+    const unused = try graph.createImage(.{ .format = .r8g8b8a8_unorm, .extent = .{ .width = 8, .height = 8 } });
+    const indirect = try graph.importBuffer(.null_handle, .{});
+
+    // writes an image nobody reads, culled
+    const dead = try graph.addPass("dead", &calls, noopPass);
+    try dead.colorAttachment(unused, .{ .float_32 = .{ 0, 0, 0, 0 } });
+
+    const cull = try graph.addPass("cull", &calls, noopPass);
+    try cull.writeBuffer(indirect, .storage_write_compute);
+
+    const forward = try graph.addPass("forward", &calls, noopPass);
+    try forward.colorAttachment(swapchain, .{ .float_32 = .{ 0, 0, 0, 1 } });
+    try forward.depthAttachment(depth, 1);
+    try forward.readBuffer(indirect, .indirect);
+
+    try graph.plan();
+    try std.testing.expectEqual(@as(u32, 1), graph.culled_count);
+    try std.testing.expect(!graph.passes.items[0].live);
+    try std.testing.expect(!graph.images.items[unused.index].used);
+
+    // the cull pass is the first to touch the buffer, nothing to wait for
+    try std.testing.expect(graph.passes.items[1].barrier.isEmpty());
+
+    // compute write -> indirect read plus the swapchain and depth layout transitions
+    const barrier = graph.passes.items[2].barrier;
+    try std.testing.expectEqual(@as(u32, 2), barrier.transition_count);
+    try std.testing.expect(barrier.src_stages.contains(.{ .compute_shader_bit = true, .color_attachment_output_bit = true }));
+    try std.testing.expect(barrier.dst_stages.contains(.{ .draw_indirect_bit = true }));
+    try std.testing.expect(barrier.dst_access.contains(.{ .indirect_command_read_bit = true }));
+
+    const pass = graph.passes.items[2];
+    try std.testing.expectEqual(@as(u32, 2), pass.attachment_count);
+    try std.testing.expectEqual(vk.AttachmentLoadOp.clear, pass.offscreen.load_ops[0]);
+    try std.testing.expectEqual(vk.AttachmentStoreOp.store, pass.offscreen.store_ops[0]);
+    // nothing reads depth after the pass
+    try std.testing.expectEqual(vk.AttachmentStoreOp.dont_care, pass.offscreen.store_ops[OffscreenPass.max_color_attachments]);
+
+    // only the swapchain image goes back to present
+    try std.testing.expectEqual(@as(u32, 1), graph.final_barrier.transition_count);
+    try std.testing.expectEqual(vk.ImageLayout.present_src_khr, graph.transitions.items[graph.final_barrier.first_transition].new_layout);
+
+    // a second read at the same stage needs no barrier
+    var state = RenderGraph.State{};
+    var read_barrier = RenderGraph.Barrier{};
+    RenderGraph.addBufferBarrier(&read_barrier, &state, RenderGraph.usageOf(.storage_write_compute));
+    RenderGraph.addBufferBarrier(&read_barrier, &state, RenderGraph.usageOf(.indirect));
+    read_barrier = .{};
+    RenderGraph.addBufferBarrier(&read_barrier, &state, RenderGraph.usageOf(.indirect));
+    try std.testing.expect(read_barrier.isEmpty());
+
+    // a and c are never alive at once and share memory, b overlaps both
+    const lifetimes = [_]RenderGraph.Lifetime{
+        .{ .size = 256, .alignment = 256, .first = 0, .last = 1 },
+        .{ .size = 256, .alignment = 256, .first = 1, .last = 2 },
+        .{ .size = 256, .alignment = 256, .first = 2, .last = 3 },
+    };
+    var offsets: [3]vk.DeviceSize = undefined;
+    const total = placeAliased(&lifetimes, &offsets);
+    try std.testing.expectEqual(@as(vk.DeviceSize, 512), total);
+    try std.testing.expectEqual(offsets[0], offsets[2]);
+    try std.testing.expect(offsets[0] != offsets[1]);
+}
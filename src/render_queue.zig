@@ -0,0 +1,241 @@
+const std = @import("std");
+
+const object_bits = 20;
+const depth_bits = 12;
+const mesh_bits = 10;
+const set_bits = 10;
+const pipeline_bits = 12;
+
+/// Collects one 64 bit key per draw and radix sorts them so draws come out grouped by pipeline, then descriptor set,
+/// then mesh and finally front to back within identical state. The low bits carry the index of the object the key was
+/// built for. Key layout, high to low bits: | pipeline 12 | set 10 | mesh 10 | depth 12 | object 20 |
+/// State ids only live until the next `clear`, so pipelines replaced by hot reload or new permutations never use them up.
+pub const RenderQueue = struct {
+    pub const max_objects = 1 << object_bits;
+
+    /// a run of sorted keys sharing pipeline, set and mesh that can be drawn as one instanced draw
+    pub const Batch = struct {
+        /// index of the first key. Also the first instance when per-object data is written in key order.
+        first: u32,
+        count: u32,
+    };
+
+    /// bind and draw counts of the last recorded frame
+    pub const Stats = struct {
+        objects: u32 = 0,
+        /// objects rejected before they were pushed, filled in by the caller
+        culled: u32 = 0,
+        draws: u32 = 0,
+        pipeline_binds: u32 = 0,
+        descriptor_binds: u32 = 0,
+        vertex_binds: u32 = 0,
+        push_constants: u32 = 0,
+
+        /// accumulates the bind and draw counts of a separately recorded chunk
+        pub fn add(self: *Stats, other: Stats) void {
+            self.draws += other.draws;
+            self.pipeline_binds += other.pipeline_binds;
+            self.descriptor_binds += other.descriptor_binds;
+            self.vertex_binds += other.vertex_binds;
+            self.push_constants += other.push_constants;
+        }
+    };
+
+    keys: std.ArrayList(u64),
+    scratch: std.ArrayList(u64),
+    batches: std.ArrayList(Batch),
+    pipeline_ids: IdTable,
+    set_ids: IdTable,
+    mesh_ids: IdTable,
+    stats: Stats = .{},
+
+    pub fn init(allocator: std.mem.Allocator) RenderQueue {
+        return .{
+            .keys = std.ArrayList(u64).init(allocator),
+            .scratch = std.ArrayList(u64).init(allocator),
+            .batches = std.ArrayList(Batch).init(allocator),
+            .pipeline_ids = IdTable.init(allocator, pipeline_bits),
+            .set_ids = IdTable.init(allocator, set_bits),
+            .mesh_ids = IdTable.init(allocator, mesh_bits),
+        };
+    }
+
+    pub fn deinit(self: *RenderQueue) void {
+        self.keys.deinit();
+        self.scratch.deinit();
+        self.batches.deinit();
+        self.pipeline_ids.deinit();
+        self.set_ids.deinit();
+        self.mesh_ids.deinit();
+    }
+
+    pub fn clear(self: *RenderQueue) void {
+        self.keys.clearRetainingCapacity();
+        self.batches.clearRetainingCapacity();
+        self.pipeline_ids.clear();
+        self.set_ids.clear();
+        self.mesh_ids.clear();
+        self.stats = .{};
+    }
+
+    /// `pipeline`, `set` and `mesh` are any values that uniquely identify the state, e.g. the raw handle or a pointer.
+    /// `depth` is the normalized distance to the camera, values outside 0..1 are clamped.
+    pub fn push(self: *RenderQueue, pipeline: u64, set: u64, mesh: u64, depth: f32, object_index: usize) !void {
+        std.debug.assert(object_index < max_objects);
+
+        const depth_max = (1 << depth_bits) - 1;
+        const depth_bucket = @floatToInt(u64, std.math.clamp(depth, 0, 1) * depth_max);
+
+        var key: u64 = try self.pipeline_ids.get(pipeline);
+        key = (key << set_bits) | try self.set_ids.get(set);
+        key = (key << mesh_bits) | try self.mesh_ids.get(mesh);
+        key = (key << depth_bits) | depth_bucket;
+        key = (key << object_bits) | object_index;
+        try self.keys.append(key);
+    }
+
+    /// LSD radix sort over 8 bit digits. Digits that are the same for every key, typically most of the state bits, are skipped.
+    pub fn sort(self: *RenderQueue) !void {
+        const len = self.keys.items.len;
+        if (len < 2) return;
+
+        try self.scratch.resize(len);
+        var src = self.keys.items;
+        var dst = self.scratch.items;
+
+        var pass: usize = 0;
+        while (pass < @sizeOf(u64)) : (pass += 1) {
+            const shift = @intCast(u6, pass * 8);
+
+            var counts = [_]usize{0} ** 256;
+            for (src) |key| counts[@truncate(u8, key >> shift)] += 1;
+            if (counts[@truncate(u8, src[0] >> shift)] == len) continue;
+
+            var offset: usize = 0;
+            for (counts) |*count| {
+                const digit_count = count.*;
+                count.* = offset;
+                offset += digit_count;
+            }
+
+            for (src) |key| {
+                const digit = @truncate(u8, key >> shift);
+                dst[counts[digit]] = key;
+                counts[digit] += 1;
+            }
+            std.mem.swap([]u64, &src, &dst);
+        }
+
+        if (src.ptr != self.keys.items.ptr) std.mem.copy(u64, self.keys.items, src);
+    }
+
+    /// collapses runs of sorted keys with identical pipeline, set and mesh into batches. Call after `sort`.
+    pub fn buildBatches(self: *RenderQueue) !void {
+        self.batches.clearRetainingCapacity();
+
+        for (self.keys.items) |key, i| {
+            if (self.batches.items.len > 0) {
+                const last = &self.batches.items[self.batches.items.len - 1];
+                if (stateOf(self.keys.items[last.first]) == stateOf(key)) {
+                    last.count += 1;
+                    continue;
+                }
+            }
+            try self.batches.append(.{ .first = @intCast(u32, i), .count = 1 });
+        }
+    }
+
+    /// the pipeline, set and mesh bits of a key
+    pub fn stateOf(key: u64) u64 {
+        return key >> (depth_bits + object_bits);
+    }
+
+    pub fn objectIndex(key: u64) usize {
+        return @intCast(usize, key & (max_objects - 1));
+    }
+};
+
+/// hands out dense ids so arbitrary handles fit into the few bits a key reserves for them
+const IdTable = struct {
+    ids: std.AutoHashMap(u64, u64),
+    max_ids: u64,
+
+    fn init(allocator: std.mem.Allocator, comptime bits: comptime_int) IdTable {
+        return .{
+            .ids = std.AutoHashMap(u64, u64).init(allocator),
+            .max_ids = 1 << bits,
+        };
+    }
+
+    fn deinit(self: *IdTable) void {
+        self.ids.deinit();
+    }
+
+    fn clear(self: *IdTable) void {
+        self.ids.clearRetainingCapacity();
+    }
+
+    fn get(self: *IdTable, value: u64) !u64 {
+        if (self.ids.get(value)) |id| return id;
+        if (self.ids.count() >= self.max_ids) return error.TooManyStates;
+
+        const id: u64 = self.ids.count();
+        try self.ids.put(value, id);
+        return id;
+    }
+};
+
+test "keys sort by state, then depth" {
+    var queue = RenderQueue.init(std.testing.allocator);
+    defer queue.deinit();
+
+    // pushed out of order. Ids are handed out in push order, so pipeline 7 sorts before pipeline 3.
+    try queue.push(7, 1, 1, 0.9, 0);
+    try queue.push(3, 1, 1, 0.5, 1);
+    try queue.push(7, 1, 1, 0.1, 2);
+    try queue.push(7, 2, 1, 0.0, 3);
+    try queue.push(3, 1, 1, 0.2, 4);
+    try queue.sort();
+
+    var order: [5]usize = undefined;
+    for (queue.keys.items) |key, i| order[i] = RenderQueue.objectIndex(key);
+    try std.testing.expectEqualSlices(usize, &[_]usize{ 2, 0, 3, 4, 1 }, &order);
+
+    try queue.buildBatches();
+    try std.testing.expectEqual(@as(usize, 3), queue.batches.items.len);
+    try std.testing.expectEqual(RenderQueue.Batch{ .first = 0, .count = 2 }, queue.batches.items[0]);
+    try std.testing.expectEqual(RenderQueue.Batch{ .first = 2, .count = 1 }, queue.batches.items[1]);
+    try std.testing.expectEqual(RenderQueue.Batch{ .first = 3, .count = 2 }, queue.batches.items[2]);
+}
+
+test "radix sort matches std.sort" {
+    var queue = RenderQueue.init(std.testing.allocator);
+    defer queue.deinit();
+
+    var prng = std.rand.DefaultPrng.init(0x5eed);
+    const random = prng.random();
+    var i: usize = 0;
+    while (i < 1000) : (i += 1) {
+        try queue.push(random.uintLessThan(u64, 8), random.uintLessThan(u64, 16), random.uintLessThan(u64, 32), random.float(f32), i);
+    }
+
+    const expected = try std.testing.allocator.dupe(u64, queue.keys.items);
+    defer std.testing.allocator.free(expected);
+    std.sort.sort(u64, expected, {}, comptime std.sort.asc(u64));
+
+    try queue.sort();
+    try std.testing.expectEqualSlices(u64, expected, queue.keys.items);
+}
+
+test "state ids are recycled by clear" {
+    var queue = RenderQueue.init(std.testing.allocator);
+    defer queue.deinit();
+
+    // more distinct pipelines over time than a key has bits for, but never more than that in one frame
+    var pipeline: u64 = 0;
+    while (pipeline < (1 << pipeline_bits) + 10) : (pipeline += 1) {
+        queue.clear();
+        try queue.push(pipeline, 0, 0, 0, 0);
+        try std.testing.expectEqual(@as(u64, 0), RenderQueue.stateOf(queue.keys.items[0]));
+    }
+}
@@ -0,0 +1,89 @@
+const std = @import("std");
+const vk = @import("vulkan");
+
+const GraphicsContext = @import("graphics_context.zig").GraphicsContext;
+
+/// Secondary command buffers for one frame in flight. Every worker thread gets its own command pool, since pools must not
+/// be used from two threads at once, and each pool holds one buffer per chunk because a single worker may end up
+/// recording any number of the chunks.
+pub const SecondaryCommands = struct {
+    allocator: std.mem.Allocator,
+    pools: []vk.CommandPool,
+    /// [worker][chunk]
+    buffers: [][]vk.CommandBuffer,
+
+    pub fn init(gc: *const GraphicsContext, allocator: std.mem.Allocator, worker_count: usize, chunk_count: usize) !SecondaryCommands {
+        const pools = try allocator.alloc(vk.CommandPool, worker_count);
+        errdefer allocator.free(pools);
+
+        const buffers = try allocator.alloc([]vk.CommandBuffer, worker_count);
+        errdefer allocator.free(buffers);
+
+        var count: usize = 0;
+        errdefer for (pools[0..count]) |pool, i| {
+            gc.destroy(pool);
+            allocator.free(buffers[i]);
+        };
+
+        for (pools) |*pool, i| {
+            // no reset_command_buffer_bit, the whole pool is reset at once at the start of the frame
+            pool.* = try gc.vkd.createCommandPool(gc.dev, &.{
+                .flags = .{ .transient_bit = true },
+                .queue_family_index = gc.graphics_queue.family,
+            }, null);
+            errdefer gc.destroy(pool.*);
+
+            buffers[i] = try allocator.alloc(vk.CommandBuffer, chunk_count);
+            errdefer allocator.free(buffers[i]);
+
+            try gc.vkd.allocateCommandBuffers(gc.dev, &.{
+                .command_pool = pool.*,
+                .level = .secondary,
+                .command_buffer_count = @intCast(u32, chunk_count),
+            }, buffers[i].ptr);
+            count += 1;
+        }
+
+        return SecondaryCommands{
+            .allocator = allocator,
+            .pools = pools,
+            .buffers = buffers,
+        };
+    }
+
+    pub fn deinit(self: SecondaryCommands, gc: *const GraphicsContext) void {
+        for (self.pools) |pool, i| {
+            // destroying the pool frees its command buffers
+            gc.destroy(pool);
+            self.allocator.free(self.buffers[i]);
+        }
+        self.allocator.free(self.buffers);
+        self.allocator.free(self.pools);
+    }
+
+    /// the frames previous submission must have completed
+    pub fn reset(self: SecondaryCommands, gc: *const GraphicsContext) !void {
+        for (self.pools) |pool| try gc.vkd.resetCommandPool(gc.dev, pool, .{});
+    }
+
+    pub fn get(self: SecondaryCommands, worker: usize, chunk: usize) vk.CommandBuffer {
+        return self.buffers[worker][chunk];
+    }
+
+    /// begins `cmdbuf` for use inside subpass 0 of `render_pass`
+    pub fn begin(gc: *const GraphicsContext, cmdbuf: vk.CommandBuffer, render_pass: vk.RenderPass, framebuffer: vk.Framebuffer) !void {
+        const inheritance = vk.CommandBufferInheritanceInfo{
+            .render_pass = render_pass,
+            .subpass = 0,
+            .framebuffer = framebuffer,
+            .occlusion_query_enable = vk.FALSE,
+            .query_flags = .{},
+            .pipeline_statistics = .{},
+        };
+
+        try gc.vkd.beginCommandBuffer(cmdbuf, &.{
+            .flags = .{ .one_time_submit_bit = true, .render_pass_continue_bit = true },
+            .p_inheritance_info = &inheritance,
+        });
+    }
+};
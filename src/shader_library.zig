@@ -0,0 +1,153 @@
+const std = @import("std");
+const resources = @import("resources");
+
+/// The SPIR-V of every shader compiled by the ResourceGenStep, looked up by its resource name. Built with
+/// `-Dshader_hot_reload=true` `poll` watches the GLSL sources and recompiles the ones that changed on disk so their
+/// pipelines can be rebuilt without restarting. Otherwise it only hands out the embedded code.
+pub const ShaderLibrary = struct {
+    /// sources are only checked this often, a stat per shader every frame is wasted work
+    const poll_interval_ns = 250 * std.time.ns_per_ms;
+    const max_spirv_size = 4 * 1024 * 1024;
+
+    const Entry = struct {
+        code: []const u8,
+        /// of the source when it was last compiled
+        mtime: i128 = 0,
+    };
+
+    allocator: std.mem.Allocator,
+    entries: [resources.shaders.len]Entry = undefined,
+    /// code loaded by `poll` that some shader currently uses
+    reloaded: std.ArrayList([]align(4) u8),
+    /// code replaced by a later compile. Builds submitted before the reload may still read it, see `freeStale`.
+    stale: std.ArrayList([]align(4) u8),
+    /// null when hot reloading is disabled
+    timer: ?std.time.Timer = null,
+
+    pub fn init(allocator: std.mem.Allocator) ShaderLibrary {
+        var self = ShaderLibrary{
+            .allocator = allocator,
+            .reloaded = std.ArrayList([]align(4) u8).init(allocator),
+            .stale = std.ArrayList([]align(4) u8).init(allocator),
+        };
+
+        for (resources.shaders) |shader, i| {
+            self.entries[i] = .{ .code = shader.code };
+            if (resources.hot_reload) {
+                const stat = std.fs.cwd().statFile(shader.source) catch continue;
+                self.entries[i].mtime = stat.mtime;
+            }
+        }
+
+        if (resources.hot_reload) {
+            self.timer = std.time.Timer.start() catch |err| blk: {
+                std.debug.print("shader hot reload disabled, no timer: {}\n", .{err});
+                break :blk null;
+            };
+        }
+
+        return self;
+    }
+
+    pub fn deinit(self: *ShaderLibrary) void {
+        for (self.reloaded.items) |code| self.allocator.free(code);
+        self.reloaded.deinit();
+        self.freeStale();
+        self.stale.deinit();
+    }
+
+    /// frees the code of every reloaded shader that was replaced since. No pipeline build may be running that was
+    /// submitted with it.
+    pub fn freeStale(self: *ShaderLibrary) void {
+        for (self.stale.items) |code| self.allocator.free(code);
+        self.stale.clearRetainingCapacity();
+    }
+
+    pub fn hasStale(self: ShaderLibrary) bool {
+        return self.stale.items.len > 0;
+    }
+
+    /// the current code of the shader `name` from resources.zig, e.g. "default_lit_frag"
+    pub fn get(self: ShaderLibrary, name: []const u8) []const u8 {
+        for (resources.shaders) |shader, i| {
+            if (std.mem.eql(u8, shader.name, name)) return self.entries[i].code;
+        }
+        std.debug.panic("unknown shader {s}", .{name});
+    }
+
+    /// recompiles the shaders whose source changed since the last call and appends their names to `changed`. A shader
+    /// that fails to compile keeps its previous code, glslc's errors are printed.
+    pub fn poll(self: *ShaderLibrary, changed: *std.ArrayList([]const u8)) !void {
+        if (self.timer) |*timer| {
+            if (timer.read() < poll_interval_ns) return;
+            timer.reset();
+        } else return;
+
+        for (resources.shaders) |shader, i| {
+            const entry = &self.entries[i];
+            const stat = std.fs.cwd().statFile(shader.source) catch continue;
+            if (stat.mtime == entry.mtime) continue;
+            entry.mtime = stat.mtime;
+
+            const code = (self.compile(shader.source, shader.defines, shader.spirv) catch |err| {
+                std.debug.print("failed recompiling {s}: {}\n", .{ shader.source, err });
+                continue;
+            }) orelse continue;
+
+            entry.code = code;
+            try changed.append(shader.name);
+
+            // permutations that hashed alike at build time share one output and are all updated by this compile
+            for (resources.shaders[i + 1 ..]) |other, j| {
+                if (!std.mem.eql(u8, other.spirv, shader.spirv)) continue;
+                self.entries[i + 1 + j] = .{ .code = code, .mtime = stat.mtime };
+                try changed.append(other.name);
+            }
+        }
+
+        // earlier reloads no shader points at anymore
+        var i: usize = 0;
+        while (i < self.reloaded.items.len) {
+            const code = self.reloaded.items[i];
+            for (self.entries) |entry| {
+                if (entry.code.ptr == code.ptr) break;
+            } else {
+                try self.stale.ensureUnusedCapacity(1);
+                self.stale.appendAssumeCapacity(self.reloaded.swapRemove(i));
+                continue;
+            }
+            i += 1;
+        }
+    }
+
+    /// null if glslc rejected the source. The output overwrites the build's SPIR-V, whose hash stamp then no longer
+    /// matches so the next build compiles it again.
+    fn compile(self: *ShaderLibrary, source: []const u8, defines: []const []const u8, spirv: []const u8) !?[]const u8 {
+        var arena = std.heap.ArenaAllocator.init(self.allocator);
+        defer arena.deinit();
+
+        var argv = std.ArrayList([]const u8).init(arena.allocator());
+        try argv.appendSlice(&resources.glslc_args);
+        for (defines) |define| try argv.append(try std.fmt.allocPrint(arena.allocator(), "-D{s}", .{define}));
+        try argv.appendSlice(&.{ source, "-o", spirv });
+
+        const result = try std.ChildProcess.exec(.{ .allocator = self.allocator, .argv = argv.items });
+        defer self.allocator.free(result.stdout);
+        defer self.allocator.free(result.stderr);
+
+        const ok = switch (result.term) {
+            .Exited => |code| code == 0,
+            else => false,
+        };
+        if (!ok) {
+            std.debug.print("{s}", .{result.stderr});
+            return null;
+        }
+
+        // SPIR-V is consumed as u32 words
+        const code = try std.fs.cwd().readFileAllocOptions(self.allocator, spirv, max_spirv_size, null, 4, null);
+        errdefer self.allocator.free(code);
+        try self.reloaded.append(code);
+        return code;
+    }
+};
@@ -0,0 +1,526 @@
+const std = @import("std");
+const vk = @import("vulkan");
+
+const magic = 0x07230203;
+
+const Op = struct {
+    const entry_point = 15;
+    const type_int = 21;
+    const type_float = 22;
+    const type_vector = 23;
+    const type_matrix = 24;
+    const type_image = 25;
+    const type_sampler = 26;
+    const type_sampled_image = 27;
+    const type_array = 28;
+    const type_runtime_array = 29;
+    const type_struct = 30;
+    const type_pointer = 32;
+    const constant = 43;
+    const variable = 59;
+    const decorate = 71;
+    const member_decorate = 72;
+};
+
+const Decoration = struct {
+    const buffer_block = 3;
+    const array_stride = 6;
+    const matrix_stride = 7;
+    const built_in = 11;
+    const location = 30;
+    const binding = 33;
+    const descriptor_set = 34;
+    const offset = 35;
+};
+
+const StorageClass = struct {
+    const uniform_constant = 0;
+    const input = 1;
+    const uniform = 2;
+    const push_constant = 9;
+    const storage_buffer = 12;
+};
+
+const image_dim_buffer = 5;
+const image_dim_subpass_data = 6;
+
+pub const Binding = struct {
+    set: u32,
+    binding: u32,
+    descriptor_type: vk.DescriptorType,
+    /// array length, 0 for a runtime sized array
+    count: u32,
+    stages: vk.ShaderStageFlags,
+};
+
+pub const VertexInput = struct {
+    location: u32,
+    /// `.@"undefined"` for types no vertex format maps to
+    format: vk.Format,
+};
+
+/// What a single SPIR-V module expects to be bound: its descriptor bindings, the size of its push constant block and, for
+/// vertex shaders, its input locations. Only the declarations layouts are built from are parsed, everything else in the
+/// module is skipped.
+pub const ShaderReflection = struct {
+    stage: vk.ShaderStageFlags,
+    bindings: []Binding,
+    /// 0 when the module has no push constant block
+    push_constant_size: u32,
+    inputs: []VertexInput,
+
+    pub fn deinit(self: ShaderReflection, allocator: std.mem.Allocator) void {
+        allocator.free(self.bindings);
+        allocator.free(self.inputs);
+    }
+
+    /// true when every input location of the shader is fed by an attribute of the same format
+    pub fn acceptsVertexInput(self: ShaderReflection, attributes: []const vk.VertexInputAttributeDescription) bool {
+        outer: for (self.inputs) |input| {
+            for (attributes) |attribute| {
+                if (attribute.location == input.location) {
+                    if (attribute.format != input.format) return false;
+                    continue :outer;
+                }
+            }
+            return false;
+        }
+        return true;
+    }
+};
+
+/// everything known about a result id. Which fields are meaningful depends on `op`.
+const Id = struct {
+    op: u32 = 0,
+    /// component, column, element or pointee type, or the result type of a constant or variable
+    type_id: u32 = 0,
+    /// component or column count, or the id of an array length constant
+    length: u32 = 0,
+    width: u32 = 0,
+    storage_class: u32 = 0,
+    /// low word of a constant
+    value: u32 = 0,
+    image_dim: u32 = 0,
+    image_sampled: u32 = 0,
+    /// member types of a struct
+    members: []const u32 = &.{},
+    array_stride: u32 = 0,
+    buffer_block: bool = false,
+    built_in: bool = false,
+    set: ?u32 = null,
+    binding: ?u32 = null,
+    location: ?u32 = null,
+};
+
+const Module = struct {
+    ids: []Id,
+    /// Offset and MatrixStride decorations of struct members keyed by `memberKey`
+    member_offsets: std.AutoHashMap(u64, u32),
+    matrix_strides: std.AutoHashMap(u64, u32),
+
+    fn get(self: Module, id: u32) !*Id {
+        if (id >= self.ids.len) return error.InvalidSpirv;
+        return &self.ids[id];
+    }
+
+    fn memberKey(struct_id: u32, member: usize) u64 {
+        return (@as(u64, struct_id) << 32) | @intCast(u32, member);
+    }
+
+    /// size in bytes of a type in an explicitly laid out block
+    fn sizeOf(self: Module, type_id: u32) anyerror!u32 {
+        const t = try self.get(type_id);
+        return switch (t.op) {
+            Op.type_int, Op.type_float => t.width / 8,
+            Op.type_vector, Op.type_matrix => t.length * try self.sizeOf(t.type_id),
+            Op.type_array => blk: {
+                const stride = if (t.array_stride > 0) t.array_stride else try self.sizeOf(t.type_id);
+                break :blk (try self.get(t.length)).value * stride;
+            },
+            Op.type_struct => blk: {
+                var size: u32 = 0;
+                for (t.members) |member_type, m| {
+                    const offset = self.member_offsets.get(memberKey(type_id, m)) orelse return error.MissingMemberOffset;
+                    const member = try self.get(member_type);
+                    // matrices are padded to their stride, which is decorated on the member rather than the type
+                    const member_size = if (member.op == Op.type_matrix and self.matrix_strides.get(memberKey(type_id, m)) != null)
+                        member.length * self.matrix_strides.get(memberKey(type_id, m)).?
+                    else
+                        try self.sizeOf(member_type);
+                    size = std.math.max(size, offset + member_size);
+                }
+                break :blk size;
+            },
+            else => error.UnsupportedType,
+        };
+    }
+
+    fn descriptorType(self: Module, type_id: u32, storage_class: u32) !vk.DescriptorType {
+        const t = try self.get(type_id);
+        return switch (t.op) {
+            Op.type_sampled_image => .combined_image_sampler,
+            Op.type_sampler => .sampler,
+            Op.type_image => switch (t.image_dim) {
+                image_dim_buffer => if (t.image_sampled == 2) vk.DescriptorType.storage_texel_buffer else .uniform_texel_buffer,
+                image_dim_subpass_data => .input_attachment,
+                else => if (t.image_sampled == 2) vk.DescriptorType.storage_image else .sampled_image,
+            },
+            // dynamic offsets are a binding time decision the shader knows nothing about, see PipelineLayoutCache.Options
+            Op.type_struct => if (storage_class == StorageClass.storage_buffer or t.buffer_block) vk.DescriptorType.storage_buffer else .uniform_buffer,
+            else => error.UnsupportedDescriptorType,
+        };
+    }
+
+    fn vertexFormat(self: Module, type_id: u32) !vk.Format {
+        const t = try self.get(type_id);
+        const scalar = if (t.op == Op.type_vector) try self.get(t.type_id) else t;
+        const count = if (t.op == Op.type_vector) t.length else 1;
+        if (scalar.width != 32) return .@"undefined";
+
+        const formats: [4]vk.Format = switch (scalar.op) {
+            Op.type_float => .{ .r32_sfloat, .r32g32_sfloat, .r32g32b32_sfloat, .r32g32b32a32_sfloat },
+            // OpTypeInt carries its signedness in `value`
+            Op.type_int => if (scalar.value == 1)
+                [4]vk.Format{ .r32_sint, .r32g32_sint, .r32g32b32_sint, .r32g32b32a32_sint }
+            else
+                [4]vk.Format{ .r32_uint, .r32g32_uint, .r32g32b32_uint, .r32g32b32a32_uint },
+            else => return .@"undefined",
+        };
+        return if (count >= 1 and count <= 4) formats[count - 1] else .@"undefined";
+    }
+};
+
+/// `code` is the module as compiled, in the native byte order and 4 byte aligned
+pub fn reflect(allocator: std.mem.Allocator, code: []const u8) !ShaderReflection {
+    if (code.len < 20 or code.len % 4 != 0) return error.InvalidSpirv;
+    const words = @ptrCast([*]const u32, @alignCast(@alignOf(u32), code.ptr))[0 .. code.len / 4];
+    if (words[0] != magic) return error.InvalidSpirv;
+
+    var module = Module{
+        .ids = try allocator.alloc(Id, words[3]),
+        .member_offsets = std.AutoHashMap(u64, u32).init(allocator),
+        .matrix_strides = std.AutoHashMap(u64, u32).init(allocator),
+    };
+    defer {
+        allocator.free(module.ids);
+        module.member_offsets.deinit();
+        module.matrix_strides.deinit();
+    }
+    std.mem.set(Id, module.ids, .{});
+
+    var variables = std.ArrayList(u32).init(allocator);
+    defer variables.deinit();
+
+    var stage = vk.ShaderStageFlags{};
+    var i: usize = 5;
+    while (i < words.len) {
+        const word_count = words[i] >> 16;
+        const opcode = words[i] & 0xffff;
+        if (word_count == 0 or i + word_count > words.len) return error.InvalidSpirv;
+        const operands = words[i + 1 .. i + word_count];
+        i += word_count;
+
+        // the fewest operands each handled instruction can have
+        const min_operands: usize = switch (opcode) {
+            Op.entry_point, Op.decorate, Op.type_sampler => 1,
+            Op.type_sampled_image, Op.type_runtime_array, Op.type_struct => 1,
+            Op.type_float => 2,
+            Op.type_int, Op.type_vector, Op.type_matrix, Op.type_array, Op.type_pointer, Op.constant, Op.variable, Op.member_decorate => 3,
+            Op.type_image => 8,
+            else => continue,
+        };
+        if (operands.len < min_operands) return error.InvalidSpirv;
+
+        switch (opcode) {
+            Op.entry_point => stage = stage.merge(try stageOf(operands[0])),
+            Op.decorate => {
+                if (operands.len < 2) return error.InvalidSpirv;
+                const target = try module.get(operands[0]);
+                const decoration = operands[1];
+                if (decoration == Decoration.buffer_block) target.buffer_block = true;
+                if (decoration == Decoration.built_in) target.built_in = true;
+
+                if (operands.len < 3) continue;
+                switch (decoration) {
+                    Decoration.array_stride => target.array_stride = operands[2],
+                    Decoration.location => target.location = operands[2],
+                    Decoration.binding => target.binding = operands[2],
+                    Decoration.descriptor_set => target.set = operands[2],
+                    else => {},
+                }
+            },
+            Op.member_decorate => {
+                const key = Module.memberKey(operands[0], operands[1]);
+                switch (operands[2]) {
+                    Decoration.offset => if (operands.len > 3) try module.member_offsets.put(key, operands[3]),
+                    Decoration.matrix_stride => if (operands.len > 3) try module.matrix_strides.put(key, operands[3]),
+                    else => {},
+                }
+            },
+            Op.type_int => (try module.get(operands[0])).* = .{ .op = opcode, .width = operands[1], .value = operands[2] },
+            Op.type_float => (try module.get(operands[0])).* = .{ .op = opcode, .width = operands[1] },
+            Op.type_vector, Op.type_matrix, Op.type_array => {
+                const t = try module.get(operands[0]);
+                // decorations come before types, keep the ones already recorded
+                t.op = opcode;
+                t.type_id = operands[1];
+                t.length = operands[2];
+            },
+            Op.type_runtime_array, Op.type_sampled_image => {
+                const t = try module.get(operands[0]);
+                t.op = opcode;
+                if (operands.len > 1) t.type_id = operands[1];
+            },
+            Op.type_image => {
+                const t = try module.get(operands[0]);
+                t.op = opcode;
+                t.image_dim = operands[2];
+                t.image_sampled = operands[6];
+            },
+            Op.type_sampler => (try module.get(operands[0])).op = opcode,
+            Op.type_struct => {
+                const t = try module.get(operands[0]);
+                t.op = opcode;
+                t.members = operands[1..];
+            },
+            Op.type_pointer => {
+                const t = try module.get(operands[0]);
+                t.op = opcode;
+                t.storage_class = operands[1];
+                t.type_id = operands[2];
+            },
+            Op.constant => {
+                const c = try module.get(operands[1]);
+                c.op = opcode;
+                c.type_id = operands[0];
+                c.value = operands[2];
+            },
+            Op.variable => {
+                const v = try module.get(operands[1]);
+                v.op = opcode;
+                v.type_id = operands[0];
+                v.storage_class = operands[2];
+                try variables.append(operands[1]);
+            },
+            else => unreachable,
+        }
+    }
+
+    var bindings = std.ArrayList(Binding).init(allocator);
+    errdefer bindings.deinit();
+    var inputs = std.ArrayList(VertexInput).init(allocator);
+    errdefer inputs.deinit();
+    var push_constant_size: u32 = 0;
+
+    for (variables.items) |variable_id| {
+        const variable = try module.get(variable_id);
+        var type_id = (try module.get(variable.type_id)).type_id;
+
+        switch (variable.storage_class) {
+            StorageClass.uniform_constant, StorageClass.uniform, StorageClass.storage_buffer => {
+                const set = variable.set orelse continue;
+                const binding = variable.binding orelse continue;
+
+                // arrays of resources are descriptor arrays
+                var count: u32 = 1;
+                const t = try module.get(type_id);
+                if (t.op == Op.type_array) {
+                    count = (try module.get(t.length)).value;
+                    type_id = t.type_id;
+                } else if (t.op == Op.type_runtime_array) {
+                    count = 0;
+                    type_id = t.type_id;
+                }
+
+                try bindings.append(.{
+                    .set = set,
+                    .binding = binding,
+                    .descriptor_type = try module.descriptorType(type_id, variable.storage_class),
+                    .count = count,
+                    .stages = stage,
+                });
+            },
+            StorageClass.push_constant => push_constant_size = std.math.max(push_constant_size, try module.sizeOf(type_id)),
+            StorageClass.input => {
+                if (!stage.vertex_bit or variable.built_in) continue;
+                const location = variable.location orelse continue;
+                try inputs.append(.{ .location = location, .format = try module.vertexFormat(type_id) });
+            },
+            else => {},
+        }
+    }
+
+    return ShaderReflection{
+        .stage = stage,
+        .bindings = bindings.toOwnedSlice(),
+        .push_constant_size = push_constant_size,
+        .inputs = inputs.toOwnedSlice(),
+    };
+}
+
+fn stageOf(execution_model: u32) !vk.ShaderStageFlags {
+    return switch (execution_model) {
+        0 => .{ .vertex_bit = true },
+        1 => .{ .tessellation_control_bit = true },
+        2 => .{ .tessellation_evaluation_bit = true },
+        3 => .{ .geometry_bit = true },
+        4 => .{ .fragment_bit = true },
+        5 => .{ .compute_bit = true },
+        else => error.UnsupportedExecutionModel,
+    };
+}
+
+/// The layout interface of a whole pipeline: the bindings and push constants of all its stages combined.
+pub const PipelineReflection = struct {
+    /// sorted by set then binding. A binding used by several stages appears once with their stages combined.
+    bindings: []Binding,
+    /// one range covering the largest push constant block, visible to every stage that declares one
+    push_constants: ?vk.PushConstantRange,
+
+    /// `only_set` limits the result to the bindings of one set, the stages may then disagree about the other sets
+    pub fn init(allocator: std.mem.Allocator, stages: []const ShaderReflection, only_set: ?u32) !PipelineReflection {
+        var bindings = std.ArrayList(Binding).init(allocator);
+        errdefer bindings.deinit();
+        var push_constants: ?vk.PushConstantRange = null;
+
+        for (stages) |stage| {
+            outer: for (stage.bindings) |binding| {
+                if (only_set != null and binding.set != only_set.?) continue;
+                for (bindings.items) |*existing| {
+                    if (existing.set != binding.set or existing.binding != binding.binding) continue;
+                    if (existing.descriptor_type != binding.descriptor_type or existing.count != binding.count) return error.BindingMismatch;
+                    existing.stages = existing.stages.merge(binding.stages);
+                    continue :outer;
+                }
+                try bindings.append(binding);
+            }
+
+            if (stage.push_constant_size == 0) continue;
+            if (push_constants) |*range| {
+                range.stage_flags = range.stage_flags.merge(stage.stage);
+                range.size = std.math.max(range.size, stage.push_constant_size);
+            } else {
+                push_constants = .{ .stage_flags = stage.stage, .offset = 0, .size = stage.push_constant_size };
+            }
+        }
+
+        std.sort.sort(Binding, bindings.items, {}, lessThan);
+        return PipelineReflection{
+            .bindings = bindings.toOwnedSlice(),
+            .push_constants = push_constants,
+        };
+    }
+
+    /// reflects every module in `code` and combines them
+    pub fn fromSpirv(allocator: std.mem.Allocator, code: []const []const u8, only_set: ?u32) !PipelineReflection {
+        var stages = std.ArrayList(ShaderReflection).init(allocator);
+        defer {
+            for (stages.items) |stage| stage.deinit(allocator);
+            stages.deinit();
+        }
+
+        for (code) |c| try stages.append(try reflect(allocator, c));
+        return try init(allocator, stages.items, only_set);
+    }
+
+    pub fn deinit(self: PipelineReflection, allocator: std.mem.Allocator) void {
+        allocator.free(self.bindings);
+    }
+
+    /// one more than the highest set used, 0 without any bindings
+    pub fn setCount(self: PipelineReflection) u32 {
+        if (self.bindings.len == 0) return 0;
+        return self.bindings[self.bindings.len - 1].set + 1;
+    }
+
+    pub fn setBindings(self: PipelineReflection, set: u32) []const Binding {
+        var first: usize = 0;
+        while (first < self.bindings.len and self.bindings[first].set < set) first += 1;
+        var last = first;
+        while (last < self.bindings.len and self.bindings[last].set == set) last += 1;
+        return self.bindings[first..last];
+    }
+
+    fn lessThan(_: void, a: Binding, b: Binding) bool {
+        if (a.set != b.set) return a.set < b.set;
+        return a.binding < b.binding;
+    }
+};
+
+/// assembles a module from instructions given as opcode followed by operands, for the tests
+fn testModule(allocator: std.mem.Allocator, instructions: []const []const u32) ![]u32 {
+    var words = std.ArrayList(u32).init(allocator);
+    errdefer words.deinit();
+
+    try words.appendSlice(&.{ magic, 0x00010000, 0, 64, 0 });
+    for (instructions) |inst| {
+        try words.append((@intCast(u32, inst.len) << 16) | inst[0]);
+        try words.appendSlice(inst[1..]);
+    }
+    return words.toOwnedSlice();
+}
+
+test "reflect bindings, push constants and vertex inputs" {
+    // vertex shader with
+    //   layout (location = 0) in vec3 pos;
+    //   layout (set = 1, binding = 2) buffer Objects { vec4 data[]; };
+    //   layout (set = 0, binding = 0) uniform sampler2D textures[4];
+    //   layout (push_constant) uniform Push { vec4 tint; mat4 m; };
+    const code = try testModule(std.testing.allocator, &.{
+        &.{ Op.entry_point, 0, 1, 0 },
+        &.{ Op.decorate, 20, Decoration.location, 0 },
+        &.{ Op.decorate, 21, Decoration.descriptor_set, 1 },
+        &.{ Op.decorate, 21, Decoration.binding, 2 },
+        &.{ Op.decorate, 22, Decoration.descriptor_set, 0 },
+        &.{ Op.decorate, 22, Decoration.binding, 0 },
+        &.{ Op.member_decorate, 14, 0, Decoration.offset, 0 },
+        &.{ Op.member_decorate, 14, 1, Decoration.offset, 16 },
+        &.{ Op.member_decorate, 14, 1, Decoration.matrix_stride, 16 },
+        &.{ Op.decorate, 11, Decoration.array_stride, 16 },
+        &.{ Op.type_float, 2, 32 },
+        &.{ Op.type_vector, 3, 2, 3 },
+        &.{ Op.type_vector, 4, 2, 4 },
+        &.{ Op.type_matrix, 5, 4, 4 },
+        &.{ Op.type_int, 6, 32, 0 },
+        &.{ Op.constant, 6, 7, 4 },
+        &.{ Op.type_image, 8, 2, 1, 0, 0, 0, 1, 0 },
+        &.{ Op.type_sampled_image, 9, 8 },
+        &.{ Op.type_array, 10, 9, 7 },
+        &.{ Op.type_runtime_array, 11, 4 },
+        &.{ Op.type_struct, 12, 11 },
+        &.{ Op.type_struct, 14, 4, 5 },
+        &.{ Op.type_pointer, 15, StorageClass.input, 3 },
+        &.{ Op.type_pointer, 16, StorageClass.storage_buffer, 12 },
+        &.{ Op.type_pointer, 17, StorageClass.uniform_constant, 10 },
+        &.{ Op.type_pointer, 18, StorageClass.push_constant, 14 },
+        &.{ Op.variable, 15, 20, StorageClass.input },
+        &.{ Op.variable, 16, 21, StorageClass.storage_buffer },
+        &.{ Op.variable, 17, 22, StorageClass.uniform_constant },
+        &.{ Op.variable, 18, 23, StorageClass.push_constant },
+    });
+    defer std.testing.allocator.free(code);
+
+    const shader = try reflect(std.testing.allocator, std.mem.sliceAsBytes(code));
+    defer shader.deinit(std.testing.allocator);
+
+    try std.testing.expect(shader.stage.vertex_bit);
+    try std.testing.expectEqual(@as(u32, 80), shader.push_constant_size);
+
+    try std.testing.expectEqual(@as(usize, 1), shader.inputs.len);
+    try std.testing.expectEqual(vk.Format.r32g32b32_sfloat, shader.inputs[0].format);
+
+    const pipeline = try PipelineReflection.init(std.testing.allocator, &.{shader}, null);
+    defer pipeline.deinit(std.testing.allocator);
+
+    try std.testing.expectEqual(@as(u32, 2), pipeline.setCount());
+    const set0 = pipeline.setBindings(0);
+    try std.testing.expectEqual(@as(usize, 1), set0.len);
+    try std.testing.expectEqual(vk.DescriptorType.combined_image_sampler, set0[0].descriptor_type);
+    try std.testing.expectEqual(@as(u32, 4), set0[0].count);
+
+    const set1 = pipeline.setBindings(1);
+    try std.testing.expectEqual(@as(usize, 1), set1.len);
+    try std.testing.expectEqual(@as(u32, 2), set1[0].binding);
+    try std.testing.expectEqual(vk.DescriptorType.storage_buffer, set1[0].descriptor_type);
+    try std.testing.expectEqual(@as(u32, 1), set1[0].count);
+}
@@ -14,19 +14,25 @@ pub const Swapchain = struct {
 
     surface_format: vk.SurfaceFormatKHR,
     present_mode: vk.PresentModeKHR,
+    /// the mode asked for at init, kept so `recreate` asks again rather than sticking with a fallback
+    requested_present_mode: vk.PresentModeKHR,
     extent: vk.Extent2D,
     handle: vk.SwapchainKHR,
 
     swap_images: []SwapImage,
+    /// one per frame in flight, independent of the number of swap images
     sync_structures: []FrameSyncStructure,
     image_index: u32 = 0,
     frame_index: usize = 0,
 
-    pub fn init(gc: *const GraphicsContext, allocator: Allocator, extent: vk.Extent2D, desired_image_count: u32) !Swapchain {
-        return try initRecycle(gc, allocator, extent, .null_handle, desired_image_count);
+    /// `frames_in_flight` is how many frames the CPU may record ahead of the GPU. The fences that bound it belong to the
+    /// caller, which passes the current frames fence to `present`. `present_mode` is used if the surface supports it,
+    /// otherwise fifo.
+    pub fn init(gc: *const GraphicsContext, allocator: Allocator, extent: vk.Extent2D, desired_image_count: u32, frames_in_flight: usize, present_mode: vk.PresentModeKHR) !Swapchain {
+        return try initRecycle(gc, allocator, extent, .null_handle, desired_image_count, frames_in_flight, present_mode);
     }
 
-    pub fn initRecycle(gc: *const GraphicsContext, allocator: Allocator, extent: vk.Extent2D, old_handle: vk.SwapchainKHR, desired_image_count: u32) !Swapchain {
+    pub fn initRecycle(gc: *const GraphicsContext, allocator: Allocator, extent: vk.Extent2D, old_handle: vk.SwapchainKHR, desired_image_count: u32, frames_in_flight: usize, requested_present_mode: vk.PresentModeKHR) !Swapchain {
         const caps = try gc.vki.getPhysicalDeviceSurfaceCapabilitiesKHR(gc.pdev, gc.surface);
         const actual_extent = findActualExtent(caps, extent);
         if (actual_extent.width == 0 or actual_extent.height == 0) {
@@ -34,7 +40,7 @@ pub const Swapchain = struct {
         }
 
         const surface_format = try findSurfaceFormat(gc, allocator);
-        const present_mode = try findPresentMode(gc, allocator);
+        const present_mode = try findPresentMode(gc, allocator, requested_present_mode);
 
         var image_count = desired_image_count;
         if (image_count > caps.max_image_count) image_count = caps.max_image_count;
@@ -74,13 +80,14 @@ pub const Swapchain = struct {
         const swap_images = try initSwapchainImages(gc, handle, surface_format.format, allocator);
         errdefer for (swap_images) |si| si.deinit(gc);
 
-        const sync_structures = try initSyncStructures(gc, allocator, swap_images.len);
+        const sync_structures = try initSyncStructures(gc, allocator, frames_in_flight);
 
         return Swapchain{
             .gc = gc,
             .allocator = allocator,
             .surface_format = surface_format,
             .present_mode = present_mode,
+            .requested_present_mode = requested_present_mode,
             .extent = actual_extent,
             .handle = handle,
             .swap_images = swap_images,
@@ -101,16 +108,15 @@ pub const Swapchain = struct {
         self.gc.destroy(self.handle);
     }
 
-    pub fn waitForAllFences(self: Swapchain) !void {
-        for (self.sync_structures) |ss| try ss.waitForFence(self.gc);
+    /// slot of the current frame in the frames in flight ring, use it to index per-frame resources
+    pub fn frameSlot(self: Swapchain) usize {
+        return self.frame_index % self.sync_structures.len;
     }
 
-    /// waits for the current SwapImage's fence and acquires the next. Call this before filling CommandBuffers. A suboptimal return value
+    /// acquires the next SwapImage. The fence of the current frame must have been waited on before. A suboptimal return value
     /// indidates that framebuffers and the SwapChain need to be recreated.
-    pub fn waitForFrame(self: *Swapchain) !PresentState {
+    pub fn acquireNextImage(self: *Swapchain) !PresentState {
         const sync_struct = self.currentFrameSyncStructure();
-        try sync_struct.waitForFence(self.gc);
-        try self.gc.vkd.resetFences(self.gc.dev, 1, @ptrCast([*]const vk.Fence, &sync_struct.render_fence));
 
         // Step 4: Acquire next frame
         const result = try self.gc.vkd.acquireNextImageKHR(
@@ -134,9 +140,11 @@ pub const Swapchain = struct {
         const allocator = self.allocator;
         const old_handle = self.handle;
         const desired_image_count = @intCast(u32, self.swap_images.len);
+        const frames_in_flight = self.sync_structures.len;
+        const requested_present_mode = self.requested_present_mode;
         const frame_index = self.frame_index;
         self.deinitExceptSwapchain();
-        self.* = try initRecycle(gc, allocator, new_extent, old_handle, desired_image_count);
+        self.* = try initRecycle(gc, allocator, new_extent, old_handle, desired_image_count, frames_in_flight, requested_present_mode);
         self.frame_index = frame_index;
     }
 
@@ -149,10 +157,11 @@ pub const Swapchain = struct {
     }
 
     fn currentFrameSyncStructure(self: Swapchain) *const FrameSyncStructure {
-        return &self.sync_structures[self.frame_index % self.sync_structures.len];
+        return &self.sync_structures[self.frameSlot()];
     }
 
-    pub fn present(self: *Swapchain, cmdbuf: vk.CommandBuffer) !void {
+    /// submits `cmdbuf`, signalling `fence` once the GPU is done with it, and presents the acquired image
+    pub fn present(self: *Swapchain, cmdbuf: vk.CommandBuffer, fence: vk.Fence) !void {
         // ---- Simple method:
         // 1) Acquire next image
         // 2) Wait for and reset fence of the acquired image
@@ -184,7 +193,7 @@ pub const Swapchain = struct {
             .p_command_buffers = @ptrCast([*]const vk.CommandBuffer, &cmdbuf),
             .signal_semaphore_count = 1,
             .p_signal_semaphores = @ptrCast([*]const vk.Semaphore, &sync_structs.render_semaphore),
-        }}, sync_structs.render_fence);
+        }}, fence);
 
         // Step 3: Present the current frame
         _ = try self.gc.vkd.queuePresentKHR(self.gc.present_queue.handle, &.{
@@ -200,37 +209,27 @@ pub const Swapchain = struct {
     }
 };
 
+/// the semaphores ordering acquire, submit and present of one frame in flight. Callers wait for the frames fence before
+/// reusing them or destroying the swapchain.
 const FrameSyncStructure = struct {
     present_semaphore: vk.Semaphore,
     render_semaphore: vk.Semaphore,
-    render_fence: vk.Fence,
 
     fn init(gc: *const GraphicsContext) !FrameSyncStructure {
         const present_semaphore = try gc.vkd.createSemaphore(gc.dev, &.{ .flags = .{} }, null);
         errdefer gc.destroy(present_semaphore);
 
         const render_semaphore = try gc.vkd.createSemaphore(gc.dev, &.{ .flags = .{} }, null);
-        errdefer gc.destroy(render_semaphore);
-
-        const render_fence = try gc.vkd.createFence(gc.dev, &.{ .flags = .{ .signaled_bit = true } }, null);
-        errdefer gc.destroy(frame_fence);
 
         return FrameSyncStructure{
             .present_semaphore = present_semaphore,
             .render_semaphore = render_semaphore,
-            .render_fence = render_fence,
         };
     }
 
     fn deinit(self: FrameSyncStructure, gc: *const GraphicsContext) void {
-        self.waitForFence(gc) catch return;
         gc.destroy(self.present_semaphore);
         gc.destroy(self.render_semaphore);
-        gc.destroy(self.render_fence);
-    }
-
-    fn waitForFence(self: FrameSyncStructure, gc: *const GraphicsContext) !void {
-        _ = try gc.vkd.waitForFences(gc.dev, 1, @ptrCast([*]const vk.Fence, &self.render_fence), vk.TRUE, std.math.maxInt(u64));
     }
 };
 
@@ -297,6 +296,7 @@ fn initSyncStructures(gc: *const GraphicsContext, allocator: Allocator, count: u
 
     for (sync_structures) |*structure| {
         structure.* = try FrameSyncStructure.init(gc);
+        i += 1;
     }
 
     return sync_structures;
@@ -323,24 +323,20 @@ fn findSurfaceFormat(gc: *const GraphicsContext, allocator: Allocator) !vk.Surfa
     return surface_formats[0]; // There must always be at least one supported surface format
 }
 
-fn findPresentMode(gc: *const GraphicsContext, allocator: Allocator) !vk.PresentModeKHR {
+/// mailbox and immediate cut latency since a finished frame does not queue behind older ones, at the cost of rendering
+/// frames that are never shown (mailbox) or tearing (immediate). fifo is the only mode that is always supported.
+fn findPresentMode(gc: *const GraphicsContext, allocator: Allocator, preferred: vk.PresentModeKHR) !vk.PresentModeKHR {
     var count: u32 = undefined;
     _ = try gc.vki.getPhysicalDeviceSurfacePresentModesKHR(gc.pdev, gc.surface, &count, null);
     const present_modes = try allocator.alloc(vk.PresentModeKHR, count);
     defer allocator.free(present_modes);
     _ = try gc.vki.getPhysicalDeviceSurfacePresentModesKHR(gc.pdev, gc.surface, &count, present_modes.ptr);
 
-    const preferred = [_]vk.PresentModeKHR{
-        .fifo_khr,
-        .mailbox_khr,
-    };
-
-    for (preferred) |mode| {
-        if (std.mem.indexOfScalar(vk.PresentModeKHR, present_modes, mode) != null) {
-            return mode;
-        }
+    if (std.mem.indexOfScalar(vk.PresentModeKHR, present_modes, preferred) != null) {
+        return preferred;
     }
 
+    std.log.warn("present mode {} is not supported, falling back to fifo", .{preferred});
     return .fifo_khr;
 }
 
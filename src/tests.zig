@@ -3,5 +3,10 @@ const std = @import("std");
 
 // include all files with tests
 comptime {
-    _ = @import("deletion_queue.zig");
+    _ = @import("cpu_profiler.zig");
+    _ = @import("frustum.zig");
+    _ = @import("gpu_profiler.zig");
+    _ = @import("render_graph.zig");
+    _ = @import("render_queue.zig");
+    _ = @import("spirv_reflect.zig");
 }
\ No newline at end of file
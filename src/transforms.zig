@@ -0,0 +1,144 @@
+const std = @import("std");
+const JobPool = @import("job_pool.zig").JobPool;
+
+/// placement of one object. The world matrix is translation * rotation * spin * scale where spin is a rotation around +y
+/// by `spin` plus a global angle, turning the same way as Mat4.createAngleAxis.
+pub const Transform = struct {
+    x: f32,
+    y: f32,
+    z: f32,
+    /// rotation quaternion
+    qx: f32 = 0,
+    qy: f32 = 0,
+    qz: f32 = 0,
+    qw: f32 = 1,
+    sx: f32 = 1,
+    sy: f32 = 1,
+    sz: f32 = 1,
+    spin: f32 = 0,
+};
+
+/// transforms in SoA layout so `lanes` objects can be loaded into one vector per component
+pub const TransformList = std.MultiArrayList(Transform);
+
+/// column major, the layout of a GLSL mat4
+pub const Matrix = [4][4]f32;
+
+const lanes = 8;
+const V = @Vector(lanes, f32);
+
+/// objects per job, a multiple of `lanes`. Big enough that scheduling is noise next to the math.
+const chunk_size = 4096;
+
+/// writes the world matrix of object `order[i]` to `out[i]`, or of object `i` when `order` is null. `out` is a slice of
+/// either Matrix or a struct with a `model: Matrix` field, whose other fields are left alone. It may point straight into
+/// mapped GPU memory, it is only ever written sequentially.
+pub fn computeWorldMatrices(transforms: TransformList.Slice, order: ?[]const u32, angle: f32, out: anytype) void {
+    computeRange(transforms, order, angle, out, 0, out.len);
+}
+
+/// `computeWorldMatrices` split into chunks across the pool
+pub fn computeWorldMatricesParallel(jobs: *JobPool, transforms: TransformList.Slice, order: ?[]const u32, angle: f32, out: anytype) void {
+    const Context = struct {
+        transforms: TransformList.Slice,
+        order: ?[]const u32,
+        angle: f32,
+        out: @TypeOf(out),
+
+        fn run(ctx: *@This(), chunk: usize, worker: usize) void {
+            _ = worker;
+            const start = chunk * chunk_size;
+            computeRange(ctx.transforms, ctx.order, ctx.angle, ctx.out, start, std.math.min(start + chunk_size, ctx.out.len));
+        }
+    };
+
+    var ctx = Context{ .transforms = transforms, .order = order, .angle = angle, .out = out };
+    jobs.parallelFor((out.len + chunk_size - 1) / chunk_size, &ctx, Context.run);
+}
+
+fn computeRange(transforms: TransformList.Slice, order: ?[]const u32, angle: f32, out: anytype, start: usize, end: usize) void {
+    var i = start;
+    while (i < end) : (i += lanes) computeBlock(transforms, order, angle, out, i, std.math.min(lanes, end - i));
+}
+
+/// computes up to `lanes` matrices starting at `out[start]`. Unused lanes repeat the last object and are not written.
+fn computeBlock(transforms: TransformList.Slice, order: ?[]const u32, angle: f32, out: anytype, start: usize, count: usize) void {
+    var indices: [lanes]usize = undefined;
+    for (indices) |*index, lane| {
+        const slot = start + std.math.min(lane, count - 1);
+        index.* = if (order) |o| o[slot] else slot;
+    }
+
+    const px = gather(transforms.items(.x), indices);
+    const py = gather(transforms.items(.y), indices);
+    const pz = gather(transforms.items(.z), indices);
+    const ax = gather(transforms.items(.qx), indices);
+    const ay = gather(transforms.items(.qy), indices);
+    const az = gather(transforms.items(.qz), indices);
+    const aw = gather(transforms.items(.qw), indices);
+    const sx = gather(transforms.items(.sx), indices);
+    const sy = gather(transforms.items(.sy), indices);
+    const sz = gather(transforms.items(.sz), indices);
+    const spin = gather(transforms.items(.spin), indices);
+
+    // spin quaternion around +y. Negated so it turns like Mat4.createAngleAxis, whose first column is (cos, 0, sin).
+    const half = (spin + @splat(lanes, angle)) * @splat(lanes, @as(f32, 0.5));
+    const by = -@sin(half);
+    const bw = @cos(half);
+
+    // rotation * spin, with the spin quaternion only having y and w
+    const x = ax * bw - az * by;
+    const y = aw * by + ay * bw;
+    const z = ax * by + az * bw;
+    const w = aw * bw - ay * by;
+
+    const one = @splat(lanes, @as(f32, 1));
+    const two = @splat(lanes, @as(f32, 2));
+    const xx = x * x;
+    const yy = y * y;
+    const zz = z * z;
+    const xy = x * y;
+    const xz = x * z;
+    const yz = y * z;
+    const wx = w * x;
+    const wy = w * y;
+    const wz = w * z;
+
+    const cols = [3][3]V{
+        .{ (one - two * (yy + zz)) * sx, two * (xy + wz) * sx, two * (xz - wy) * sx },
+        .{ two * (xy - wz) * sy, (one - two * (xx + zz)) * sy, two * (yz + wx) * sy },
+        .{ two * (xz + wy) * sz, two * (yz - wx) * sz, (one - two * (xx + yy)) * sz },
+    };
+
+    var c: [3][3][lanes]f32 = undefined;
+    for (cols) |col, ci| {
+        for (col) |v, ri| c[ci][ri] = v;
+    }
+    const tx: [lanes]f32 = px;
+    const ty: [lanes]f32 = py;
+    const tz: [lanes]f32 = pz;
+
+    var lane: usize = 0;
+    while (lane < count) : (lane += 1) {
+        store(&out[start + lane], .{
+            .{ c[0][0][lane], c[0][1][lane], c[0][2][lane], 0 },
+            .{ c[1][0][lane], c[1][1][lane], c[1][2][lane], 0 },
+            .{ c[2][0][lane], c[2][1][lane], c[2][2][lane], 0 },
+            .{ tx[lane], ty[lane], tz[lane], 1 },
+        });
+    }
+}
+
+fn store(dst: anytype, matrix: Matrix) void {
+    if (@TypeOf(dst.*) == Matrix) {
+        dst.* = matrix;
+    } else {
+        dst.model = matrix;
+    }
+}
+
+fn gather(values: []const f32, indices: [lanes]usize) V {
+    var result: [lanes]f32 = undefined;
+    for (indices) |index, lane| result[lane] = values[index];
+    return result;
+}
@@ -31,7 +31,7 @@ pub const CommandBuffer = struct {
         pipeline_bind_point: vk.PipelineBindPoint,
         pipeline: vk.Pipeline,
     ) void {
-        self.gc.vkd.vkCmdBindPipeline(
+        self.gc.vkd.cmdBindPipeline(
             self.cmdbuf,
             pipeline_bind_point,
             pipeline,
@@ -44,7 +44,7 @@ pub const CommandBuffer = struct {
         viewport_count: u32,
         p_viewports: [*]const vk.Viewport,
     ) void {
-        self.gc.vkd.vkCmdSetViewport(
+        self.gc.vkd.cmdSetViewport(
             self.cmdbuf,
             first_viewport,
             viewport_count,
@@ -58,7 +58,7 @@ pub const CommandBuffer = struct {
         scissor_count: u32,
         p_scissors: [*]const vk.Rect2D,
     ) void {
-        self.gc.vkd.vkCmdSetScissor(
+        self.gc.vkd.cmdSetScissor(
             self.cmdbuf,
             first_scissor,
             scissor_count,
@@ -70,7 +70,7 @@ pub const CommandBuffer = struct {
         self: CommandBuffer,
         line_width: f32,
     ) void {
-        self.gc.vkd.vkCmdSetLineWidth(
+        self.gc.vkd.cmdSetLineWidth(
             self.cmdbuf,
             line_width,
         );
@@ -82,7 +82,7 @@ pub const CommandBuffer = struct {
         depth_bias_clamp: f32,
         depth_bias_slope_factor: f32,
     ) void {
-        self.gc.vkd.vkCmdSetDepthBias(
+        self.gc.vkd.cmdSetDepthBias(
             self.cmdbuf,
             depth_bias_constant_factor,
             depth_bias_clamp,
@@ -94,7 +94,7 @@ pub const CommandBuffer = struct {
         self: CommandBuffer,
         blend_constants: [4]f32,
     ) void {
-        self.gc.vkd.vkCmdSetBlendConstants(
+        self.gc.vkd.cmdSetBlendConstants(
             self.cmdbuf,
             blend_constants,
         );
@@ -105,7 +105,7 @@ pub const CommandBuffer = struct {
         min_depth_bounds: f32,
         max_depth_bounds: f32,
     ) void {
-        self.gc.vkd.vkCmdSetDepthBounds(
+        self.gc.vkd.cmdSetDepthBounds(
             self.cmdbuf,
             min_depth_bounds,
             max_depth_bounds,
@@ -117,9 +117,9 @@ pub const CommandBuffer = struct {
         face_mask: vk.StencilFaceFlags,
         compare_mask: u32,
     ) void {
-        self.gc.vkd.vkCmdSetStencilCompareMask(
+        self.gc.vkd.cmdSetStencilCompareMask(
             self.cmdbuf,
-            face_mask.toInt(),
+            face_mask,
             compare_mask,
         );
     }
@@ -129,9 +129,9 @@ pub const CommandBuffer = struct {
         face_mask: vk.StencilFaceFlags,
         write_mask: u32,
     ) void {
-        self.gc.vkd.vkCmdSetStencilWriteMask(
+        self.gc.vkd.cmdSetStencilWriteMask(
             self.cmdbuf,
-            face_mask.toInt(),
+            face_mask,
             write_mask,
         );
     }
@@ -141,9 +141,9 @@ pub const CommandBuffer = struct {
         face_mask: vk.StencilFaceFlags,
         reference: u32,
     ) void {
-        self.gc.vkd.vkCmdSetStencilReference(
+        self.gc.vkd.cmdSetStencilReference(
             self.cmdbuf,
-            face_mask.toInt(),
+            face_mask,
             reference,
         );
     }
@@ -158,7 +158,7 @@ pub const CommandBuffer = struct {
         dynamic_offset_count: u32,
         p_dynamic_offsets: [*]const u32,
     ) void {
-        self.gc.vkd.vkCmdBindDescriptorSets(
+        self.gc.vkd.cmdBindDescriptorSets(
             self.cmdbuf,
             pipeline_bind_point,
             layout,
@@ -176,7 +176,7 @@ pub const CommandBuffer = struct {
         offset: vk.DeviceSize,
         index_type: vk.IndexType,
     ) void {
-        self.gc.vkd.vkCmdBindIndexBuffer(
+        self.gc.vkd.cmdBindIndexBuffer(
             self.cmdbuf,
             buffer,
             offset,
@@ -191,7 +191,7 @@ pub const CommandBuffer = struct {
         p_buffers: [*]const vk.Buffer,
         p_offsets: [*]const vk.DeviceSize,
     ) void {
-        self.gc.vkd.vkCmdBindVertexBuffers(
+        self.gc.vkd.cmdBindVertexBuffers(
             self.cmdbuf,
             first_binding,
             binding_count,
@@ -207,7 +207,7 @@ pub const CommandBuffer = struct {
         first_vertex: u32,
         first_instance: u32,
     ) void {
-        self.gc.vkd.vkCmdDraw(
+        self.gc.vkd.cmdDraw(
             self.cmdbuf,
             vertex_count,
             instance_count,
@@ -224,7 +224,7 @@ pub const CommandBuffer = struct {
         vertex_offset: i32,
         first_instance: u32,
     ) void {
-        self.gc.vkd.vkCmdDrawIndexed(
+        self.gc.vkd.cmdDrawIndexed(
             self.cmdbuf,
             index_count,
             instance_count,
@@ -242,7 +242,7 @@ pub const CommandBuffer = struct {
         first_instance: u32,
         stride: u32,
     ) void {
-        self.gc.vkd.vkCmdDrawMultiEXT(
+        self.gc.vkd.cmdDrawMultiEXT(
             self.cmdbuf,
             draw_count,
             p_vertex_info,
@@ -261,7 +261,7 @@ pub const CommandBuffer = struct {
         stride: u32,
         p_vertex_offset: ?*const i32,
     ) void {
-        self.gc.vkd.vkCmdDrawMultiIndexedEXT(
+        self.gc.vkd.cmdDrawMultiIndexedEXT(
             self.cmdbuf,
             draw_count,
             p_index_info,
@@ -279,7 +279,7 @@ pub const CommandBuffer = struct {
         draw_count: u32,
         stride: u32,
     ) void {
-        self.gc.vkd.vkCmdDrawIndirect(
+        self.gc.vkd.cmdDrawIndirect(
             self.cmdbuf,
             buffer,
             offset,
@@ -295,7 +295,7 @@ pub const CommandBuffer = struct {
         draw_count: u32,
         stride: u32,
     ) void {
-        self.gc.vkd.vkCmdDrawIndexedIndirect(
+        self.gc.vkd.cmdDrawIndexedIndirect(
             self.cmdbuf,
             buffer,
             offset,
@@ -310,7 +310,7 @@ pub const CommandBuffer = struct {
         group_count_y: u32,
         group_count_z: u32,
     ) void {
-        self.gc.vkd.vkCmdDispatch(
+        self.gc.vkd.cmdDispatch(
             self.cmdbuf,
             group_count_x,
             group_count_y,
@@ -323,7 +323,7 @@ pub const CommandBuffer = struct {
         buffer: vk.Buffer,
         offset: vk.DeviceSize,
     ) void {
-        self.gc.vkd.vkCmdDispatchIndirect(
+        self.gc.vkd.cmdDispatchIndirect(
             self.cmdbuf,
             buffer,
             offset,
@@ -333,7 +333,7 @@ pub const CommandBuffer = struct {
     pub fn subpassShadingHUAWEI(
         self: CommandBuffer,
     ) void {
-        self.gc.vkd.vkCmdSubpassShadingHUAWEI(
+        self.gc.vkd.cmdSubpassShadingHUAWEI(
             self.cmdbuf,
         );
     }
@@ -345,7 +345,7 @@ pub const CommandBuffer = struct {
         region_count: u32,
         p_regions: [*]const vk.BufferCopy,
     ) void {
-        self.gc.vkd.vkCmdCopyBuffer(
+        self.gc.vkd.cmdCopyBuffer(
             self.cmdbuf,
             src_buffer,
             dst_buffer,
@@ -363,7 +363,7 @@ pub const CommandBuffer = struct {
         region_count: u32,
         p_regions: [*]const vk.ImageCopy,
     ) void {
-        self.gc.vkd.vkCmdCopyImage(
+        self.gc.vkd.cmdCopyImage(
             self.cmdbuf,
             src_image,
             src_image_layout,
@@ -384,7 +384,7 @@ pub const CommandBuffer = struct {
         p_regions: [*]const vk.ImageBlit,
         filter: vk.Filter,
     ) void {
-        self.gc.vkd.vkCmdBlitImage(
+        self.gc.vkd.cmdBlitImage(
             self.cmdbuf,
             src_image,
             src_image_layout,
@@ -404,7 +404,7 @@ pub const CommandBuffer = struct {
         region_count: u32,
         p_regions: [*]const vk.BufferImageCopy,
     ) void {
-        self.gc.vkd.vkCmdCopyBufferToImage(
+        self.gc.vkd.cmdCopyBufferToImage(
             self.cmdbuf,
             src_buffer,
             dst_image,
@@ -422,7 +422,7 @@ pub const CommandBuffer = struct {
         region_count: u32,
         p_regions: [*]const vk.BufferImageCopy,
     ) void {
-        self.gc.vkd.vkCmdCopyImageToBuffer(
+        self.gc.vkd.cmdCopyImageToBuffer(
             self.cmdbuf,
             src_image,
             src_image_layout,
@@ -439,7 +439,7 @@ pub const CommandBuffer = struct {
         data_size: vk.DeviceSize,
         p_data: *const anyopaque,
     ) void {
-        self.gc.vkd.vkCmdUpdateBuffer(
+        self.gc.vkd.cmdUpdateBuffer(
             self.cmdbuf,
             dst_buffer,
             dst_offset,
@@ -455,7 +455,7 @@ pub const CommandBuffer = struct {
         size: vk.DeviceSize,
         data: u32,
     ) void {
-        self.gc.vkd.vkCmdFillBuffer(
+        self.gc.vkd.cmdFillBuffer(
             self.cmdbuf,
             dst_buffer,
             dst_offset,
@@ -472,7 +472,7 @@ pub const CommandBuffer = struct {
         range_count: u32,
         p_ranges: [*]const vk.ImageSubresourceRange,
     ) void {
-        self.gc.vkd.vkCmdClearColorImage(
+        self.gc.vkd.cmdClearColorImage(
             self.cmdbuf,
             image,
             image_layout,
@@ -490,7 +490,7 @@ pub const CommandBuffer = struct {
         range_count: u32,
         p_ranges: [*]const vk.ImageSubresourceRange,
     ) void {
-        self.gc.vkd.vkCmdClearDepthStencilImage(
+        self.gc.vkd.cmdClearDepthStencilImage(
             self.cmdbuf,
             image,
             image_layout,
@@ -507,7 +507,7 @@ pub const CommandBuffer = struct {
         rect_count: u32,
         p_rects: [*]const vk.ClearRect,
     ) void {
-        self.gc.vkd.vkCmdClearAttachments(
+        self.gc.vkd.cmdClearAttachments(
             self.cmdbuf,
             attachment_count,
             p_attachments,
@@ -525,7 +525,7 @@ pub const CommandBuffer = struct {
         region_count: u32,
         p_regions: [*]const vk.ImageResolve,
     ) void {
-        self.gc.vkd.vkCmdResolveImage(
+        self.gc.vkd.cmdResolveImage(
             self.cmdbuf,
             src_image,
             src_image_layout,
@@ -541,10 +541,10 @@ pub const CommandBuffer = struct {
         event: vk.Event,
         stage_mask: vk.PipelineStageFlags,
     ) void {
-        self.gc.vkd.vkCmdSetEvent(
+        self.gc.vkd.cmdSetEvent(
             self.cmdbuf,
             event,
-            stage_mask.toInt(),
+            stage_mask,
         );
     }
 
@@ -553,10 +553,10 @@ pub const CommandBuffer = struct {
         event: vk.Event,
         stage_mask: vk.PipelineStageFlags,
     ) void {
-        self.gc.vkd.vkCmdResetEvent(
+        self.gc.vkd.cmdResetEvent(
             self.cmdbuf,
             event,
-            stage_mask.toInt(),
+            stage_mask,
         );
     }
 
@@ -573,12 +573,12 @@ pub const CommandBuffer = struct {
         image_memory_barrier_count: u32,
         p_image_memory_barriers: [*]const vk.ImageMemoryBarrier,
     ) void {
-        self.gc.vkd.vkCmdWaitEvents(
+        self.gc.vkd.cmdWaitEvents(
             self.cmdbuf,
             event_count,
             p_events,
-            src_stage_mask.toInt(),
-            dst_stage_mask.toInt(),
+            src_stage_mask,
+            dst_stage_mask,
             memory_barrier_count,
             p_memory_barriers,
             buffer_memory_barrier_count,
@@ -600,11 +600,11 @@ pub const CommandBuffer = struct {
         image_memory_barrier_count: u32,
         p_image_memory_barriers: [*]const vk.ImageMemoryBarrier,
     ) void {
-        self.gc.vkd.vkCmdPipelineBarrier(
+        self.gc.vkd.cmdPipelineBarrier(
             self.cmdbuf,
-            src_stage_mask.toInt(),
-            dst_stage_mask.toInt(),
-            dependency_flags.toInt(),
+            src_stage_mask,
+            dst_stage_mask,
+            dependency_flags,
             memory_barrier_count,
             p_memory_barriers,
             buffer_memory_barrier_count,
@@ -620,11 +620,11 @@ pub const CommandBuffer = struct {
         query: u32,
         flags: vk.QueryControlFlags,
     ) void {
-        self.gc.vkd.vkCmdBeginQuery(
+        self.gc.vkd.cmdBeginQuery(
             self.cmdbuf,
             query_pool,
             query,
-            flags.toInt(),
+            flags,
         );
     }
 
@@ -633,7 +633,7 @@ pub const CommandBuffer = struct {
         query_pool: vk.QueryPool,
         query: u32,
     ) void {
-        self.gc.vkd.vkCmdEndQuery(
+        self.gc.vkd.cmdEndQuery(
             self.cmdbuf,
             query_pool,
             query,
@@ -644,7 +644,7 @@ pub const CommandBuffer = struct {
         self: CommandBuffer,
         p_conditional_rendering_begin: *const vk.ConditionalRenderingBeginInfoEXT,
     ) void {
-        self.gc.vkd.vkCmdBeginConditionalRenderingEXT(
+        self.gc.vkd.cmdBeginConditionalRenderingEXT(
             self.cmdbuf,
             p_conditional_rendering_begin,
         );
@@ -653,7 +653,7 @@ pub const CommandBuffer = struct {
     pub fn endConditionalRenderingEXT(
         self: CommandBuffer,
     ) void {
-        self.gc.vkd.vkCmdEndConditionalRenderingEXT(
+        self.gc.vkd.cmdEndConditionalRenderingEXT(
             self.cmdbuf,
         );
     }
@@ -664,7 +664,7 @@ pub const CommandBuffer = struct {
         first_query: u32,
         query_count: u32,
     ) void {
-        self.gc.vkd.vkCmdResetQueryPool(
+        self.gc.vkd.cmdResetQueryPool(
             self.cmdbuf,
             query_pool,
             first_query,
@@ -678,9 +678,9 @@ pub const CommandBuffer = struct {
         query_pool: vk.QueryPool,
         query: u32,
     ) void {
-        self.gc.vkd.vkCmdWriteTimestamp(
+        self.gc.vkd.cmdWriteTimestamp(
             self.cmdbuf,
-            pipeline_stage.toInt(),
+            pipeline_stage,
             query_pool,
             query,
         );
@@ -696,7 +696,7 @@ pub const CommandBuffer = struct {
         stride: vk.DeviceSize,
         flags: vk.QueryResultFlags,
     ) void {
-        self.gc.vkd.vkCmdCopyQueryPoolResults(
+        self.gc.vkd.cmdCopyQueryPoolResults(
             self.cmdbuf,
             query_pool,
             first_query,
@@ -704,7 +704,7 @@ pub const CommandBuffer = struct {
             dst_buffer,
             dst_offset,
             stride,
-            flags.toInt(),
+            flags,
         );
     }
 
@@ -716,10 +716,10 @@ pub const CommandBuffer = struct {
         size: u32,
         p_values: *const anyopaque,
     ) void {
-        self.gc.vkd.vkCmdPushConstants(
+        self.gc.vkd.cmdPushConstants(
             self.cmdbuf,
             layout,
-            stage_flags.toInt(),
+            stage_flags,
             offset,
             size,
             p_values,
@@ -731,7 +731,7 @@ pub const CommandBuffer = struct {
         p_render_pass_begin: *const vk.RenderPassBeginInfo,
         contents: vk.SubpassContents,
     ) void {
-        self.gc.vkd.vkCmdBeginRenderPass(
+        self.gc.vkd.cmdBeginRenderPass(
             self.cmdbuf,
             p_render_pass_begin,
             contents,
@@ -742,7 +742,7 @@ pub const CommandBuffer = struct {
         self: CommandBuffer,
         contents: vk.SubpassContents,
     ) void {
-        self.gc.vkd.vkCmdNextSubpass(
+        self.gc.vkd.cmdNextSubpass(
             self.cmdbuf,
             contents,
         );
@@ -751,7 +751,7 @@ pub const CommandBuffer = struct {
     pub fn endRenderPass(
         self: CommandBuffer,
     ) void {
-        self.gc.vkd.vkCmdEndRenderPass(
+        self.gc.vkd.cmdEndRenderPass(
             self.cmdbuf,
         );
     }
@@ -761,7 +761,7 @@ pub const CommandBuffer = struct {
         command_buffer_count: u32,
         p_command_buffers: [*]const vk.CommandBuffer,
     ) void {
-        self.gc.vkd.vkCmdExecuteCommands(
+        self.gc.vkd.cmdExecuteCommands(
             self.cmdbuf,
             command_buffer_count,
             p_command_buffers,
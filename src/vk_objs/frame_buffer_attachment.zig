@@ -1,17 +1,41 @@
 const std = @import("std");
 const vk = @import("vulkan");
+const vma = @import("vma");
+const vkinit = @import("../vkinit.zig");
 
-// not sure if this is a good abstraction
+const GraphicsContext = @import("../graphics_context.zig").GraphicsContext;
+
+/// An image the RenderGraph creates for its passes. It does not own its memory: transient attachments whose lifetimes do
+/// not overlap are bound to the same allocation at different or equal offsets, so the image is created unbound and `bind`
+/// places it once the graph has decided where.
 pub const FrameBufferAttachment = struct {
     image: vk.Image,
-    view: vk.ImageView,
-    mem: vk.DeviceMemory,
+    view: vk.ImageView = .null_handle,
+    format: vk.Format,
+    aspect_mask: vk.ImageAspectFlags,
 
-    pub fn init() FrameBufferAttachment {
-        return .{
-            .image = undefined,
-            .view = undefined,
-            .mem = undefined,
+    pub fn init(gc: *const GraphicsContext, format: vk.Format, extent: vk.Extent2D, usage: vk.ImageUsageFlags, aspect_mask: vk.ImageAspectFlags) !FrameBufferAttachment {
+        const info = vkinit.imageCreateInfo(format, .{ .width = extent.width, .height = extent.height, .depth = 1 }, usage);
+        return FrameBufferAttachment{
+            .image = try gc.vkd.createImage(gc.dev, &info, null),
+            .format = format,
+            .aspect_mask = aspect_mask,
         };
     }
+
+    pub fn deinit(self: FrameBufferAttachment, gc: *const GraphicsContext) void {
+        if (self.view != .null_handle) gc.destroy(self.view);
+        gc.destroy(self.image);
+    }
+
+    pub fn memoryRequirements(self: FrameBufferAttachment, gc: *const GraphicsContext) vk.MemoryRequirements {
+        return gc.vkd.getImageMemoryRequirements(gc.dev, self.image);
+    }
+
+    /// binds the image at `offset` into `allocation` and creates its view
+    pub fn bind(self: *FrameBufferAttachment, gc: *const GraphicsContext, allocation: vma.VmaAllocation, offset: vk.DeviceSize) !void {
+        try gc.allocator.bindImageMemoryAtOffset(allocation, offset, self.image);
+        const view_info = vkinit.imageViewCreateInfo(self.format, self.image, self.aspect_mask);
+        self.view = try gc.vkd.createImageView(gc.dev, &view_info, null);
+    }
 };
@@ -1,27 +1,84 @@
 const std = @import("std");
 const vk = @import("vulkan");
 
-const FrameBufferAttachment = @import("frame_buffer_attachment.zig");
+const GraphicsContext = @import("../graphics_context.zig").GraphicsContext;
 
-// not sure if this is a good abstraction
+/// A single subpass render pass built by the RenderGraph for one of its passes. Attachments keep their layout for the whole
+/// pass, the graph moves them into it with barriers beforehand, so the render pass only decides what is loaded and stored.
+/// It stays compatible with any other render pass using the same formats, pipelines do not need to be built against it.
 pub const OffscreenPass = struct {
-    width: i32,
-    height: i32,
-    color: FrameBufferAttachment,
-    depth: FrameBufferAttachment,
+    pub const max_color_attachments = 4;
+
+    pub const Attachment = struct {
+        format: vk.Format,
+        layout: vk.ImageLayout,
+        load_op: vk.AttachmentLoadOp,
+        store_op: vk.AttachmentStoreOp,
+    };
+
     render_pass: vk.RenderPass,
-    sampler: vk.Sampler,
-    descriptor: vk.DescriptorImageInfo,
+    /// color attachments come first, the depth attachment last
+    attachment_count: u32,
+
+    pub fn init(gc: *const GraphicsContext, colors: []const Attachment, depth: ?Attachment) !OffscreenPass {
+        std.debug.assert(colors.len <= max_color_attachments);
+
+        var descriptions: [max_color_attachments + 1]vk.AttachmentDescription = undefined;
+        var color_refs: [max_color_attachments]vk.AttachmentReference = undefined;
+        for (colors) |color, i| {
+            descriptions[i] = describe(color);
+            color_refs[i] = .{ .attachment = @intCast(u32, i), .layout = color.layout };
+        }
+
+        var depth_ref: vk.AttachmentReference = undefined;
+        var count = @intCast(u32, colors.len);
+        if (depth) |d| {
+            descriptions[count] = describe(d);
+            depth_ref = .{ .attachment = count, .layout = d.layout };
+            count += 1;
+        }
+
+        const subpass = vk.SubpassDescription{
+            .flags = .{},
+            .pipeline_bind_point = .graphics,
+            .input_attachment_count = 0,
+            .p_input_attachments = undefined,
+            .color_attachment_count = @intCast(u32, colors.len),
+            .p_color_attachments = &color_refs,
+            .p_resolve_attachments = null,
+            .p_depth_stencil_attachment = if (depth != null) &depth_ref else null,
+            .preserve_attachment_count = 0,
+            .p_preserve_attachments = undefined,
+        };
+
+        const render_pass = try gc.vkd.createRenderPass(gc.dev, &.{
+            .flags = .{},
+            .attachment_count = count,
+            .p_attachments = &descriptions,
+            .subpass_count = 1,
+            .p_subpasses = @ptrCast([*]const vk.SubpassDescription, &subpass),
+            .dependency_count = 0,
+            .p_dependencies = undefined,
+        }, null);
+
+        return OffscreenPass{ .render_pass = render_pass, .attachment_count = count };
+    }
+
+    pub fn deinit(self: OffscreenPass, gc: *const GraphicsContext) void {
+        gc.destroy(self.render_pass);
+    }
 
-    pub fn init() OffscreenPass {
+    fn describe(attachment: Attachment) vk.AttachmentDescription {
         return .{
-            .width = undefined,
-            .height = undefined,
-            .color = undefined,
-            .depth = undefined,
-            .render_pass = undefined,
-            .sampler = undefined,
-            .descriptor = undefined,
+            .flags = .{},
+            .format = attachment.format,
+            .samples = .{ .@"1_bit" = true },
+            .load_op = attachment.load_op,
+            .store_op = attachment.store_op,
+            .stencil_load_op = .dont_care,
+            .stencil_store_op = .dont_care,
+            .initial_layout = attachment.layout,
+            .final_layout = attachment.layout,
         };
     }
 };
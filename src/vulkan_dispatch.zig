@@ -24,6 +24,7 @@ pub const InstanceDispatch = vk.InstanceWrapper(.{
     .destroySurfaceKHR = true,
     .enumeratePhysicalDevices = true,
     .getPhysicalDeviceProperties = true,
+    .getPhysicalDeviceFeatures = true,
     .getPhysicalDeviceFeatures2 = true,
     .enumerateDeviceExtensionProperties = true,
     .getPhysicalDeviceSurfaceFormatsKHR = true,
@@ -86,9 +87,13 @@ pub const DeviceDispatch = vk.DeviceWrapper(.{
     .destroyShaderModule = true,
     .createPipelineLayout = true,
     .destroyPipelineLayout = true,
+    .createPipelineCache = true,
+    .destroyPipelineCache = true,
+    .getPipelineCacheData = true,
     .createRenderPass = true,
     .destroyRenderPass = true,
     .createGraphicsPipelines = true,
+    .createComputePipelines = true,
     .destroyPipeline = true,
     .createFramebuffer = true,
     .destroyFramebuffer = true,
@@ -101,17 +106,31 @@ pub const DeviceDispatch = vk.DeviceWrapper(.{
     .cmdPipelineBarrier = true,
     .cmdBindPipeline = true,
     .cmdDraw = true,
+    .cmdDrawIndexed = true,
+    .cmdDrawIndexedIndirect = true,
+    .cmdDispatch = true,
     .cmdBindDescriptorSets = true,
     .cmdCopyBufferToImage = true,
+    .cmdCopyImage = true,
+    .cmdCopyImageToBuffer = true,
+    .cmdUpdateBuffer = true,
     .cmdSetViewport = true,
     .cmdSetScissor = true,
     .cmdClearColorImage = true,
     .cmdBindVertexBuffers = true,
+    .cmdBindIndexBuffer = true,
+    .cmdExecuteCommands = true,
+    .cmdResetQueryPool = true,
+    .cmdWriteTimestamp = true,
+    .createQueryPool = true,
+    .destroyQueryPool = true,
+    .getQueryPoolResults = true,
     .resetCommandBuffer = true,
     .createDescriptorSetLayout = true,
     .destroyDescriptorSetLayout = true,
     .createDescriptorPool = true,
     .destroyDescriptorPool = true,
+    .resetDescriptorPool = true,
     .allocateDescriptorSets = true,
     .freeDescriptorSets = true,
     .updateDescriptorSets = true,
@@ -168,6 +187,7 @@ const DestroyLookupTable = struct {
     const ShaderModule = DeviceDispatch.destroyShaderModule;
     const SwapchainKHR = DeviceDispatch.destroySwapchainKHR;
     const PipelineCache = DeviceDispatch.destroyPipelineCache;
+    const QueryPool = DeviceDispatch.destroyQueryPool;
     const PipelineLayout = DeviceDispatch.destroyPipelineLayout;
     const DescriptorPool = DeviceDispatch.destroyDescriptorPool;
     const DescriptorSetLayout = DeviceDispatch.destroyDescriptorSetLayout;